@@ -0,0 +1,237 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "shmBcast.h"
+
+/*
+* fan-out benchmark: 1 writer --> N reader processes, every reader must see every message
+*   pipe: the writer copies each message into one pipe per reader (IPC_pipe.c with a pipe for every reader)
+*   block: shmBcast.c, the writer waits for the slowest reader
+*   overwrite: shmBcast.c, the writer never waits and lapped readers skip ahead
+* every message carries its sequence number, readers check that it only grows (and has no gap unless overwrite)
+* with -w one reader sleeps usec every 1024 messages to play the slow consumer
+* build: gcc -O2 IPC_bcastBench.c shmBcast.c -o IPC_bcastBench
+* usage: ./IPC_bcastBench [-n msgNumber] [-s msgSize] [-w slowUsec] [-e evictMs]
+*/
+
+#define SLOT_NUM 4096
+#define PIPE_LEN (1024 * 1024)
+
+enum
+{
+	M_PIPE = 0,
+	M_BLOCK,
+	M_OVERWRITE,
+	M_NUM
+};
+
+static const char *m_names[M_NUM] = { "pipe", "block", "overwrite" };
+static const int readers_list[] = { 1, 4, 16 };
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int read_full(int fd, char *buf, unsigned long len)
+{
+	ssize_t n;
+	while (len > 0)
+	{
+		if ((n = read(fd, buf, len)) <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+* exit status: 0 ok, 1 reordered or duplicated message, 2 evicted
+*/
+static void reader_do(int mode, struct shm_bcast *b, int id, int fd, unsigned long size, int slow_us)
+{
+	char buf[size];
+	unsigned long seq, next = 0, got = 0;
+	long len;
+	for (;;)
+	{
+		if (b != NULL)
+		{
+			if ((len = shm_bcast_recv(b, id, buf, size)) == SHM_BCAST_GONE)
+				exit(2);
+			if (len < 0)
+				break;
+		}
+		else if (read_full(fd, buf, size) < 0)
+			break;
+		memcpy(&seq, buf, sizeof(seq));
+		if (seq < next || (mode != M_OVERWRITE && seq != next))
+			exit(1);
+		next = seq + 1;
+		if (slow_us > 0 && ++got % 1024 == 0)
+			usleep(slow_us);
+	}
+	exit(0);
+}
+
+static void bench(int mode, int readers, long n, unsigned long size, int slow_us, unsigned int evict_ms)
+{
+	struct shm_bcast *b = NULL;
+	char buf[size];
+	int i, ids[readers], fds[readers], pid[readers], fd[2], status, bad = 0, evicted = 0;
+	unsigned long lost = 0, delivered = 0;
+	long k;
+	double start, send_cost, cost;
+	memset(buf, 'a', size);
+	if (mode != M_PIPE && (b = shm_bcast_create(NULL, SLOT_NUM, size, mode == M_BLOCK ? SHM_BCAST_BLOCK : SHM_BCAST_OVERWRITE, evict_ms)) == NULL)
+	{
+		printf("create broadcast ring error\n");
+		exit(1);
+	}
+	fflush(stdout);
+	for (i = 0; i < readers; i++)
+	{
+		// join before fork so that no reader misses the first message
+		if (b != NULL && (ids[i] = shm_bcast_join(b)) < 0)
+		{
+			printf("join error\n");
+			exit(1);
+		}
+		if (b == NULL)
+		{
+			if (pipe(fd) < 0)
+			{
+				printf("pipe error\n");
+				exit(1);
+			}
+			fcntl(fd[1], F_SETPIPE_SZ, PIPE_LEN);
+			fds[i] = fd[1];
+		}
+		switch (pid[i] = fork())
+		{
+			case -1:
+				printf("fork error\n");
+				exit(1);
+			case 0:
+				if (b == NULL)
+				{
+					close(fd[1]);
+					while (--i >= 0)
+						close(fds[i]);
+				}
+				reader_do(mode, b, b != NULL ? ids[i] : 0, fd[0], size, i == 0 ? slow_us : 0);
+			default:
+				if (b == NULL)
+					close(fd[0]);
+				break;
+		}
+	}
+
+	start = now_sec();
+	for (k = 0; k < n; k++)
+	{
+		memcpy(buf, &k, sizeof(k));
+		if (b != NULL)
+		{
+			if (shm_bcast_send(b, buf, size) < 0)
+			{
+				printf("send error\n");
+				exit(1);
+			}
+			continue;
+		}
+		for (i = 0; i < readers; i++)
+		{
+			if (write(fds[i], buf, size) != size)
+			{
+				printf("write error\n");
+				exit(1);
+			}
+		}
+	}
+	send_cost = now_sec() - start;
+	if (b != NULL)
+		shm_bcast_shutdown(b);
+	else
+	{
+		for (i = 0; i < readers; i++)
+			close(fds[i]);
+	}
+	for (i = 0; i < readers; i++)
+	{
+		waitpid(pid[i], &status, 0);
+		if (WEXITSTATUS(status) == 2)
+			evicted++;
+		else if (WEXITSTATUS(status) != 0)
+			bad++;
+		// the cursor of a reader counts the messages it went past, read or lost
+		if (b != NULL)
+		{
+			lost += shm_bcast_lost(b, ids[i]);
+			delivered += atomic_load(&b->hdr->readers[ids[i]].cursor) - shm_bcast_lost(b, ids[i]);
+		}
+		else
+			delivered += n;
+	}
+	cost = now_sec() - start;
+	if (bad > 0)
+	{
+		printf("%s: %d readers got reordered messages\n", m_names[mode], bad);
+		exit(1);
+	}
+	printf("%-9s %7d %12.0f %12.1f %10lu %7d\n", m_names[mode], readers, n / send_cost,
+		(double)delivered * size / 1048576.0 / cost, lost, evicted);
+	fflush(stdout);
+	if (b != NULL)
+		shm_bcast_close(b);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, m, r, slow_us = 0;
+	unsigned int evict_ms = 0;
+	long n = 1000000;
+	unsigned long size = 64;
+	while ((opt = getopt(argc, argv, "n:s:w:e:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n':
+				n = atol(optarg);
+				break;
+			case 's':
+				size = strtoul(optarg, NULL, 0);
+				break;
+			case 'w':
+				slow_us = atoi(optarg);
+				break;
+			case 'e':
+				evict_ms = atoi(optarg);
+				break;
+			default:
+				printf("usage: %s [-n msgNumber] [-s msgSize] [-w slowUsec] [-e evictMs]\n", argv[0]);
+				exit(1);
+		}
+	}
+	if (size < sizeof(long) || size > 65536)
+	{
+		printf("msgSize must between %lu and 65536\n", sizeof(long));
+		exit(1);
+	}
+	printf("%-9s %7s %12s %12s %10s %7s\n", "mode", "readers", "send msgs/s", "deliv MB/s", "lost", "evicted");
+	for (r = 0; r < sizeof(readers_list) / sizeof(readers_list[0]); r++)
+	{
+		for (m = 0; m < M_NUM; m++)
+			bench(m, readers_list[r], n, size, slow_us, evict_ms);
+	}
+	return 0;
+}
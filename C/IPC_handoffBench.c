@@ -0,0 +1,236 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include "shmHandoff.h"
+
+/*
+* large payload handoff 1 --> 2, the pipe path of IPC_pipe.c against memfd + SCM_RIGHTS (shmHandoff.c)
+*   pipe: 1 fills its buffer and writes it into a pipe, 2 reads it into its own buffer, every byte copied twice
+*   oneshot: 1 fills a new sealed memfd per message and passes the fd, 2 maps it
+*   pool: 1 fills one of -b recycled memfds, only the first use of each passes the fd, 2 gives it back after use
+* 1 writes the whole payload in every mode, 2 checks one word per page, report messages/s and MB/s
+* build: gcc -O2 IPC_handoffBench.c shmHandoff.c -o IPC_handoffBench
+* usage: ./IPC_handoffBench [-s msgSize] [-n msgNumber] [-b poolBuffers]
+*/
+
+#define PIPE_LEN (1024 * 1024)
+// bytes moved by one run, the message number is derived from it
+#define RUN_BYTES (2UL * 1024 * 1024 * 1024)
+#define MAX_MSGS 20000
+#define MIN_MSGS 50
+#define PAGE_LEN 4096
+
+enum
+{
+	M_PIPE = 0,
+	M_ONESHOT,
+	M_POOL,
+	M_NUM
+};
+
+static const char *m_names[M_NUM] = { "pipe", "oneshot", "pool" };
+static const unsigned long sizes[] = { 65536, 1048576, 4194304, 16777216 };
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int write_full(int fd, const char *buf, unsigned long len)
+{
+	ssize_t n;
+	while (len > 0)
+	{
+		if ((n = write(fd, buf, len)) <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int read_full(int fd, char *buf, unsigned long len)
+{
+	ssize_t n;
+	while (len > 0)
+	{
+		if ((n = read(fd, buf, len)) <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+* 0 if every page of the payload of message i has its mark
+*/
+static int check_payload(const char *p, unsigned long size, long i)
+{
+	unsigned long off;
+	for (off = 0; off < size; off += PAGE_LEN)
+	{
+		if (p[off] != (char)i)
+			return -1;
+	}
+	return 0;
+}
+
+static void receiver_do(int mode, int fd, unsigned long size, long n)
+{
+	struct shm_handoff *h = NULL;
+	const char *p;
+	char *buf = NULL;
+	unsigned long len;
+	long i;
+	int id;
+	if (mode == M_PIPE)
+		buf = (char *)malloc(size);
+	else
+		h = shm_handoff_receiver(fd);
+	for (i = 0; i < n; i++)
+	{
+		if (mode == M_PIPE)
+		{
+			if (read_full(fd, buf, size) < 0)
+				exit(1);
+			p = buf;
+		}
+		else if ((p = (const char *)shm_handoff_recv(h, &id, &len)) == NULL || len != size)
+			exit(1);
+		if (check_payload(p, size, i) < 0)
+			exit(2);
+		if (h != NULL && shm_handoff_release(h, id) < 0)
+			exit(1);
+	}
+	exit(0);
+}
+
+static void bench(int mode, unsigned long size, long n, int buf_num)
+{
+	struct shm_handoff *h = NULL;
+	char *buf = NULL, *p;
+	int fd[2], pid, status, id;
+	long i;
+	double start, cost;
+	if (n <= 0)
+	{
+		n = RUN_BYTES / size;
+		n = n > MAX_MSGS ? MAX_MSGS : (n < MIN_MSGS ? MIN_MSGS : n);
+	}
+	if (mode == M_PIPE)
+	{
+		if (pipe(fd) < 0)
+		{
+			printf("pipe error\n");
+			exit(1);
+		}
+		fcntl(fd[1], F_SETPIPE_SZ, PIPE_LEN);
+		buf = (char *)malloc(size);
+	}
+	else if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd) < 0)
+	{
+		printf("socketpair error\n");
+		exit(1);
+	}
+	fflush(stdout);
+	switch (pid = fork())
+	{
+		case -1:
+			printf("fork error\n");
+			exit(1);
+		case 0:
+			close(fd[1]);
+			receiver_do(mode, fd[0], size, n);
+		default:
+			close(fd[0]);
+			break;
+	}
+	// the pool is made before the clock starts, that is what pooling is for
+	if (mode != M_PIPE && (h = shm_handoff_sender(fd[1], mode == M_POOL ? buf_num : 0, size)) == NULL)
+	{
+		printf("create %s sender error\n", m_names[mode]);
+		exit(1);
+	}
+
+	start = now_sec();
+	for (i = 0; i < n; i++)
+	{
+		p = mode == M_PIPE ? buf : (char *)shm_handoff_get(h, size, &id);
+		if (p == NULL)
+		{
+			printf("%s get buffer error\n", m_names[mode]);
+			exit(1);
+		}
+		memset(p, (char)i, size);
+		if (mode == M_PIPE ? write_full(fd[1], buf, size) < 0 : shm_handoff_send(h, id, size) < 0)
+		{
+			printf("%s send error\n", m_names[mode]);
+			exit(1);
+		}
+	}
+	waitpid(pid, &status, 0);
+	cost = now_sec() - start;
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		printf("%s receiver failed, status %d\n", m_names[mode], status);
+		exit(1);
+	}
+	printf("%-8s %9lu %10.0f %10.1f\n", m_names[mode], size, n / cost, n * size / 1048576.0 / cost);
+	fflush(stdout);
+	if (h != NULL)
+		shm_handoff_close(h);
+	else
+	{
+		close(fd[1]);
+		free(buf);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, m, buf_num = 8;
+	unsigned long s, size = 0;
+	long n = 0;
+	while ((opt = getopt(argc, argv, "s:n:b:")) != -1)
+	{
+		switch (opt)
+		{
+			case 's':
+				size = strtoul(optarg, NULL, 0);
+				break;
+			case 'n':
+				n = atol(optarg);
+				break;
+			case 'b':
+				buf_num = atoi(optarg);
+				break;
+			default:
+				printf("usage: %s [-s msgSize] [-n msgNumber] [-b poolBuffers]\n", argv[0]);
+				exit(1);
+		}
+	}
+	if (buf_num <= 0 || buf_num > SHM_HANDOFF_MAX_BUFS)
+	{
+		printf("poolBuffers must between 1 and %d\n", SHM_HANDOFF_MAX_BUFS);
+		exit(1);
+	}
+	printf("%-8s %9s %10s %10s\n", "mode", "size", "msgs/s", "MB/s");
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		if (size != 0 && s > 0)
+			break;
+		for (m = 0; m < M_NUM; m++)
+			bench(m, size != 0 ? size : sizes[s], n, buf_num);
+	}
+	return 0;
+}
@@ -0,0 +1,206 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include "shmMpsc.h"
+
+/*
+* fan-in benchmark: N producer processes --> 1 consumer, the IPC_fifo.c pattern against shmMpsc.c
+*   fifo: every producer writes fixed size messages (<= PIPE_BUF, so each write is atomic) into one fifo
+*   mpsc: every producer sends into the shared memory queue, the consumer takes up to -b messages per batch
+* every message carries its producer and sequence number, the consumer checks that none is lost or reordered
+* producers are released together by closing a pipe they block on
+* build: gcc -O2 IPC_mpscBench.c shmMpsc.c -o IPC_mpscBench
+* usage: ./IPC_mpscBench [-p maxProducers] [-n msgNumber] [-s msgSize] [-b batch]
+*/
+
+#define SLOT_NUM 4096
+#define FIFO_READ_LEN 65536
+
+struct msg_hdr
+{
+	unsigned int producer;
+	unsigned int seq;
+};
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void producer_do(int id, long n, unsigned long size, int go_fd, struct shm_mpsc *q, int fifo_fd)
+{
+	char buf[size], c;
+	struct msg_hdr *m = (struct msg_hdr *)buf;
+	long i;
+	memset(buf, 'a', size);
+	m->producer = id;
+	read(go_fd, &c, 1);
+	for (i = 0; i < n; i++)
+	{
+		m->seq = i;
+		if (q != NULL ? shm_mpsc_send(q, buf, size) < 0 : write(fifo_fd, buf, size) != size)
+		{
+			printf("%d send error\n", id);
+			exit(1);
+		}
+	}
+	exit(0);
+}
+
+/*
+* returns 0 if message m is the next one of its producer
+*/
+static int check_msg(const struct msg_hdr *m, unsigned int *next, int producers)
+{
+	if (m->producer >= producers || m->seq != next[m->producer])
+		return -1;
+	next[m->producer]++;
+	return 0;
+}
+
+static void bench(int fifo, int producers, long total, unsigned long size, int batch)
+{
+	struct shm_mpsc *q = NULL;
+	struct shm_mpsc_msg msgs[batch];
+	char path[64], *buf = NULL;
+	unsigned int next[producers];
+	long per = total / producers, got = 0, batches = 0;
+	int i, n, go[2], fd = -1, pid[producers], status;
+	ssize_t len;
+	double start, cost;
+	memset(next, 0x0, sizeof(next));
+	if (fifo)
+	{
+		snprintf(path, sizeof(path), "/tmp/ipc_mpsc_bench_%d", getpid());
+		if (mkfifo(path, 0600) < 0 || (fd = open(path, O_RDWR)) < 0)
+		{
+			printf("mkfifo error\n");
+			exit(1);
+		}
+		unlink(path);
+		buf = (char *)malloc(FIFO_READ_LEN);
+	}
+	else if ((q = shm_mpsc_create(NULL, SLOT_NUM, size)) == NULL)
+	{
+		printf("create queue error\n");
+		exit(1);
+	}
+	if (pipe(go) < 0)
+	{
+		printf("pipe error\n");
+		exit(1);
+	}
+	fflush(stdout);
+	for (i = 0; i < producers; i++)
+	{
+		switch (pid[i] = fork())
+		{
+			case -1:
+				printf("fork error\n");
+				exit(1);
+			case 0:
+				close(go[1]);
+				producer_do(i, per, size, go[0], q, fd);
+			default:
+				break;
+		}
+	}
+	close(go[0]);
+
+	start = now_sec();
+	close(go[1]);
+	while (got < per * producers)
+	{
+		if (fifo)
+		{
+			// a multiple of size, and the fifo only ever holds whole messages
+			if ((len = read(fd, buf, FIFO_READ_LEN / size * size)) <= 0)
+				break;
+			for (n = 0; n < len / size; n++)
+			{
+				if (check_msg((struct msg_hdr *)(buf + n * size), next, producers) < 0)
+					break;
+			}
+		}
+		else
+		{
+			if ((len = shm_mpsc_recv_batch(q, msgs, batch)) <= 0)
+				break;
+			for (n = 0; n < len; n++)
+			{
+				if (check_msg((struct msg_hdr *)msgs[n].data, next, producers) < 0)
+					break;
+			}
+			shm_mpsc_release(q);
+		}
+		if (n < (fifo ? len / size : len))
+		{
+			printf("lost or reordered message\n");
+			exit(1);
+		}
+		got += n;
+		batches++;
+	}
+	cost = now_sec() - start;
+	for (i = 0; i < producers; i++)
+		waitpid(pid[i], &status, 0);
+	printf("%-5s %9d %12.0f %10.1f %10.1f\n", fifo ? "fifo" : "mpsc", producers, got / cost, got * size / 1048576.0 / cost, (double)got / batches);
+	fflush(stdout);
+	if (fifo)
+	{
+		close(fd);
+		free(buf);
+	}
+	else
+		shm_mpsc_close(q);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, p, max_producers = 32, batch = 64;
+	long total = 4000000;
+	unsigned long size = 64;
+	while ((opt = getopt(argc, argv, "p:n:s:b:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'p':
+				max_producers = atoi(optarg);
+				break;
+			case 'n':
+				total = atol(optarg);
+				break;
+			case 's':
+				size = strtoul(optarg, NULL, 0);
+				break;
+			case 'b':
+				batch = atoi(optarg);
+				break;
+			default:
+				printf("usage: %s [-p maxProducers] [-n msgNumber] [-s msgSize] [-b batch]\n", argv[0]);
+				exit(1);
+		}
+	}
+	if (size < sizeof(struct msg_hdr) || size > PIPE_BUF || batch <= 0 || max_producers <= 0)
+	{
+		printf("msgSize must between %lu and %d, batch and maxProducers must greater than 0\n", sizeof(struct msg_hdr), PIPE_BUF);
+		exit(1);
+	}
+	printf("%-5s %9s %12s %10s %10s\n", "mode", "producers", "msgs/s", "MB/s", "avg batch");
+	for (p = 1; p <= max_producers; p *= 2)
+	{
+		bench(1, p, total, size, batch);
+		bench(0, p, total, size, batch);
+	}
+	return 0;
+}
@@ -0,0 +1,131 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "notify.h"
+
+/*
+* ping pong latency of the process notifications in notify.c
+* 1 posts ping and waits for pong, 2 waits for ping and posts pong, report the round trip p50/p99/p99.9 and mean
+* "signal" is the IPC_signal.c approach (real time signal and a handler), the others avoid signal handlers
+* build: gcc -O2 IPC_notifyBench.c notify.c -o IPC_notifyBench
+* usage: ./IPC_notifyBench [-k eventfd|futex|signalfd|signal] [-n roundTrips]
+*/
+
+static double now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : (x > y);
+}
+
+static void child_do(struct notify *ping, struct notify *pong, long n)
+{
+	long i;
+	// pong is bound by 1 already, tell it that ping is bound too
+	if (notify_bind(ping) < 0 || notify_post(pong) < 0)
+		exit(1);
+	for (i = 0; i < n; i++)
+	{
+		if (notify_wait(ping) < 0 || notify_post(pong) < 0)
+			exit(1);
+	}
+	exit(0);
+}
+
+static void bench(int kind, long n)
+{
+	struct notify *ping = notify_create(kind), *pong = notify_create(kind);
+	double *lat = (double *)malloc(n * sizeof(double)), start, sum = 0;
+	long i;
+	int pid, status;
+	if (ping == NULL || pong == NULL || lat == NULL || notify_bind(pong) < 0)
+	{
+		printf("create %s error\n", notify_name(kind));
+		exit(1);
+	}
+	fflush(stdout);
+	switch (pid = fork())
+	{
+		case -1:
+			printf("fork error\n");
+			exit(1);
+		case 0:
+			child_do(ping, pong, n);
+		default:
+			break;
+	}
+	if (notify_wait(pong) < 0)
+	{
+		printf("%s wait error\n", notify_name(kind));
+		exit(1);
+	}
+	for (i = 0; i < n; i++)
+	{
+		start = now_ns();
+		if (notify_post(ping) < 0 || notify_wait(pong) < 0)
+		{
+			printf("%s ping pong error\n", notify_name(kind));
+			exit(1);
+		}
+		lat[i] = (now_ns() - start) / 1000;
+		sum += lat[i];
+	}
+	waitpid(pid, &status, 0);
+	qsort(lat, n, sizeof(double), cmp_double);
+	printf("%-9s %10.2f %10.2f %10.2f %10.2f\n", notify_name(kind), lat[n / 2], lat[n * 99 / 100], lat[n * 999 / 1000], sum / n);
+	fflush(stdout);
+	notify_close(ping);
+	notify_close(pong);
+	free(lat);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, k, k_only = -1;
+	long n = 100000;
+	while ((opt = getopt(argc, argv, "k:n:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'k':
+				for (k = 0; k < NOTIFY_KIND_NUM; k++)
+					if (strcmp(optarg, notify_name(k)) == 0)
+						k_only = k;
+				if (k_only < 0)
+				{
+					printf("unknown kind %s\n", optarg);
+					exit(1);
+				}
+				break;
+			case 'n':
+				n = atol(optarg);
+				break;
+			default:
+				printf("usage: %s [-k eventfd|futex|signalfd|signal] [-n roundTrips]\n", argv[0]);
+				exit(1);
+		}
+	}
+	if (n <= 0)
+	{
+		printf("roundTrips must greater than 0\n");
+		exit(1);
+	}
+	printf("%-9s %10s %10s %10s %10s\n", "kind", "p50(us)", "p99(us)", "p99.9(us)", "mean(us)");
+	for (k = 0; k < NOTIFY_KIND_NUM; k++)
+	{
+		if (k_only < 0 || k == k_only)
+			bench(k, n);
+	}
+	return 0;
+}
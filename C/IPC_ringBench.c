@@ -0,0 +1,300 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include "shmRing.h"
+
+/*
+* benchmark of the shared memory ring (shmRing.c) against pipe, fifo and unix socket
+* for every transport and message size, 1 forks 2 and then
+*   throughput: 1 sends n messages, 2 receives them all and answers 1 byte, report messages/s and MB/s
+*   latency: 1 sends a message, 2 echoes it back, half of the round trip, report p50/p99/p99.9
+* pipes and fifos get F_SETPIPE_SZ as large as the ring so that all transports have the same buffer
+* build: gcc -O2 IPC_ringBench.c shmRing.c -o IPC_ringBench
+* usage: ./IPC_ringBench [-t ring|pipe|fifo|unix] [-s msgSize] [-n msgNumber]
+*/
+
+#define RING_CAP (4UL * 1024 * 1024)
+// bytes sent by one throughput run, the message number is derived from it
+#define THROUGHPUT_BYTES (512UL * 1024 * 1024)
+#define MAX_MSGS 2000000
+#define MIN_MSGS 1000
+
+enum
+{
+	T_RING = 0,
+	T_PIPE,
+	T_FIFO,
+	T_UNIX,
+	T_NUM
+};
+
+static const char *t_names[T_NUM] = { "ring", "pipe", "fifo", "unix" };
+static const unsigned long sizes[] = { 8, 64, 512, 4096, 65536, 1048576 };
+
+/*
+* one direction of a transport, ring or fd
+*/
+struct chan
+{
+	struct shm_ring *ring;
+	int rfd;
+	int wfd;
+};
+
+static double now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int write_full(int fd, const char *buf, unsigned long len)
+{
+	ssize_t n;
+	while (len > 0)
+	{
+		if ((n = write(fd, buf, len)) <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int read_full(int fd, char *buf, unsigned long len)
+{
+	ssize_t n;
+	while (len > 0)
+	{
+		if ((n = read(fd, buf, len)) <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int chan_send(struct chan *c, const char *buf, unsigned long len)
+{
+	if (c->ring != NULL)
+		return shm_ring_send(c->ring, buf, len);
+	return write_full(c->wfd, buf, len);
+}
+
+static int chan_recv(struct chan *c, char *buf, unsigned long len)
+{
+	if (c->ring != NULL)
+		return shm_ring_recv(c->ring, buf, len) == len ? 0 : -1;
+	return read_full(c->rfd, buf, len);
+}
+
+/*
+* make the two directions, 1 sends on c[0] and receives on c[1]
+*/
+static int chan_open(int t, struct chan c[2])
+{
+	char path[64];
+	int i, fd[2], bufsz = RING_CAP;
+	memset(c, 0x0, 2 * sizeof(struct chan));
+	for (i = 0; i < 2; i++)
+	{
+		switch (t)
+		{
+			case T_RING:
+				if ((c[i].ring = shm_ring_create(NULL, RING_CAP)) == NULL)
+					return -1;
+				break;
+			case T_PIPE:
+				if (pipe(fd) < 0)
+					return -1;
+				fcntl(fd[1], F_SETPIPE_SZ, RING_CAP);
+				c[i].rfd = fd[0];
+				c[i].wfd = fd[1];
+				break;
+			case T_FIFO:
+				// open both ends with O_RDWR so that neither side blocks in open, then the name is not needed any more
+				snprintf(path, sizeof(path), "/tmp/ipc_ring_bench_%d_%d", getpid(), i);
+				if (mkfifo(path, 0600) < 0 || (c[i].rfd = open(path, O_RDWR)) < 0 || (c[i].wfd = open(path, O_RDWR)) < 0)
+					return -1;
+				unlink(path);
+				fcntl(c[i].wfd, F_SETPIPE_SZ, RING_CAP);
+				break;
+			case T_UNIX:
+				if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd) < 0)
+					return -1;
+				setsockopt(fd[0], SOL_SOCKET, SO_SNDBUF, &bufsz, sizeof(bufsz));
+				setsockopt(fd[1], SOL_SOCKET, SO_RCVBUF, &bufsz, sizeof(bufsz));
+				c[i].rfd = fd[1];
+				c[i].wfd = fd[0];
+				break;
+		}
+	}
+	return 0;
+}
+
+static void chan_close(struct chan c[2])
+{
+	int i;
+	for (i = 0; i < 2; i++)
+	{
+		if (c[i].ring != NULL)
+			shm_ring_close(c[i].ring);
+		if (c[i].rfd > 0)
+			close(c[i].rfd);
+		if (c[i].wfd > 0 && c[i].wfd != c[i].rfd)
+			close(c[i].wfd);
+	}
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : (x > y);
+}
+
+/*
+* 2: sink n messages then ack, and echo m messages back
+*/
+static void child_do(struct chan c[2], unsigned long size, long n, long m)
+{
+	char *buf = (char *)malloc(size);
+	long i;
+	for (i = 0; i < n; i++)
+	{
+		if (chan_recv(&c[0], buf, size) < 0)
+			exit(1);
+	}
+	if (chan_send(&c[1], buf, 1) < 0)
+		exit(1);
+	for (i = 0; i < m; i++)
+	{
+		if (chan_recv(&c[0], buf, size) < 0 || chan_send(&c[1], buf, size) < 0)
+			exit(1);
+	}
+	free(buf);
+	exit(0);
+}
+
+static int bench(int t, unsigned long size, long n)
+{
+	struct chan c[2];
+	char *buf = (char *)malloc(size);
+	long i, m = size >= 65536 ? 2000 : 20000;
+	double start, cost, *lat = (double *)malloc(m * sizeof(double));
+	int pid, status;
+	if (n <= 0)
+	{
+		n = THROUGHPUT_BYTES / size;
+		n = n > MAX_MSGS ? MAX_MSGS : (n < MIN_MSGS ? MIN_MSGS : n);
+	}
+	memset(buf, 'a', size);
+	if (chan_open(t, c) < 0)
+	{
+		printf("open %s error\n", t_names[t]);
+		exit(1);
+	}
+	fflush(stdout);
+	switch (pid = fork())
+	{
+		case -1:
+			printf("fork error\n");
+			exit(1);
+		case 0:
+			child_do(c, size, n, m);
+		default:
+			break;
+	}
+
+	start = now_ns();
+	for (i = 0; i < n; i++)
+	{
+		if (chan_send(&c[0], buf, size) < 0)
+		{
+			printf("%s send error\n", t_names[t]);
+			exit(1);
+		}
+	}
+	if (chan_recv(&c[1], buf, 1) < 0)
+	{
+		printf("%s recv error\n", t_names[t]);
+		exit(1);
+	}
+	cost = (now_ns() - start) / 1e9;
+
+	for (i = 0; i < m; i++)
+	{
+		start = now_ns();
+		if (chan_send(&c[0], buf, size) < 0 || chan_recv(&c[1], buf, size) < 0)
+		{
+			printf("%s ping pong error\n", t_names[t]);
+			exit(1);
+		}
+		lat[i] = (now_ns() - start) / 2 / 1000;
+	}
+	waitpid(pid, &status, 0);
+	qsort(lat, m, sizeof(double), cmp_double);
+	printf("%-6s %8lu %12.0f %10.1f %10.2f %10.2f %10.2f\n", t_names[t], size, n / cost, n * size / 1048576.0 / cost,
+		lat[m / 2], lat[m * 99 / 100], lat[m * 999 / 1000]);
+	fflush(stdout);
+	chan_close(c);
+	free(buf);
+	free(lat);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, t, t_only = -1;
+	unsigned long s, size = 0;
+	long n = 0;
+	while ((opt = getopt(argc, argv, "t:s:n:")) != -1)
+	{
+		switch (opt)
+		{
+			case 't':
+				for (t = 0; t < T_NUM; t++)
+					if (strcmp(optarg, t_names[t]) == 0)
+						t_only = t;
+				if (t_only < 0)
+				{
+					printf("unknown transport %s\n", optarg);
+					exit(1);
+				}
+				break;
+			case 's':
+				size = strtoul(optarg, NULL, 0);
+				break;
+			case 'n':
+				n = atol(optarg);
+				break;
+			default:
+				printf("usage: %s [-t ring|pipe|fifo|unix] [-s msgSize] [-n msgNumber]\n", argv[0]);
+				exit(1);
+		}
+	}
+	if (size > RING_CAP / 2 - 8)
+	{
+		printf("msgSize must not greater than %lu\n", RING_CAP / 2 - 8);
+		exit(1);
+	}
+	printf("%-6s %8s %12s %10s %10s %10s %10s\n", "trans", "size", "msgs/s", "MB/s", "p50(us)", "p99(us)", "p99.9(us)");
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		if (size != 0 && s > 0)
+			break;
+		for (t = 0; t < T_NUM; t++)
+		{
+			if (t_only < 0 || t == t_only)
+				bench(t, size != 0 ? size : sizes[s], n);
+		}
+	}
+	return 0;
+}
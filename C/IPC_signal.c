@@ -6,8 +6,9 @@
 #include <signal.h>
 
 /*
-* this is a demo to show multi processes IPC with pipe
-* 1 --> 2, 1 --> 3, 1 write 20 bytes, 2 read 10 bytes, then 3 read 10 bytes
+* this is a demo to show multi processes IPC with signal
+* 1 --> 2, 2 waits in pause(), 1 sends signal MYSIG to 2 after 3 seconds
+* a signal sent before 2 reaches pause() is lost, for wakeups between processes use notify.c
 */
 
 #define MYSIG 62
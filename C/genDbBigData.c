@@ -1,18 +1,168 @@
 /*
 快速创建指定格式的txt文件，用于导入数据库，比如hive、oracle等。
 数据格式：id,列1,列2,...
+每一行的长度只取决于digit(id)，所以文件总长度以及任意一行的偏移都可以直接算出来。
+文件按字节切成若干对齐的大块(block)，多个线程各自把落在块内的行(首尾可能是半行)格式化到块缓冲区，
+写线程按顺序把块写到预先算好的偏移，可选O_DIRECT。缓冲区个数是线程数的两倍，格式化和IO互相重叠。
+行的格式化不走sprintf：id查表转字符串，位数相同的一段行先成倍复制铺满，再逐行原地递增id，见emit_rows。
+指定-s schema文件时按schema生成带类型的列(见genDbSchema.c)，此时行长不固定，块按行数切分，写线程顺序追加。
+schema模式下可以用-f选择输出格式，csv或者parquet(见genDbWriter.c、genDbParquet.c)。
+-z压缩时每块在工作线程里格式化完直接压缩成独立的gzip member/zstd frame，写线程照样按顺序拼接(见genDbCompress.c)。
+-k把输出分成K个文件，供K个导入进程(比如sqlldr)同时加载：默认按行区间均分，各分片的块轮流生成，所有文件同时增长；
+-H按某一列的hash分片，每块的行在工作线程里按分片重排成K段。结束时写outputFile.manifest列出各分片。
+outputFile是FIFO或者-(标准输出)时直接流式喂给导入程序，不落盘：只能顺序write，不截断不fsync，进度信息改打到标准错误。
+写不动时写线程阻塞在write上，工作线程拿不到空闲缓冲区也跟着停下，内存始终只有2*线程数个块。
+-m时不经过缓冲区和写线程：先fallocate出整个文件，按窗口mmap，工作线程把行直接格式化进映射；
+一个窗口的块都写完就msync、munmap并丢掉这段page cache，同时映射的窗口不超过MMAP_WIN_MAX个。
+每隔-c秒写一次outputFile.ckpt(已写完的块号、各文件偏移和末尾的hash)，进程中途退出后用--resume校验文件末尾并从断点接着写。
+列生成器按(seed, 列号, 向量号)播种，所以seed就是断点需要的全部随机数状态。
+例如PostgreSQL：genDbBigData -f pgbinary -s user.schema 100000000 - | psql -c "copy u from stdin with (format binary)"
+    MySQL：mkfifo /tmp/u.fifo; genDbBigData -s user.schema 100000000 /tmp/u.fifo &
+           mysql --local-infile -e "load data local infile '/tmp/u.fifo' into table u fields terminated by ','"
+编译：gcc -O2 genDbBigData.c genDbSchema.c genDbWriter.c genDbParquet.c genDbCompress.c -o genDbBigData -lpthread -lm -lz
+      支持zstd、lz4时再加 -DHAVE_ZSTD -lzstd -DHAVE_LZ4 -llz4
 */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <signal.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include "genDbBigData.h"
 
 #define STR_UNIT "1"
-#define SEPARATOR ","
+// 默认块大小，单位MB
+#define BLOCK_MB 4
+// O_DIRECT要求的缓冲区地址、长度、偏移对齐
+#define IO_ALIGN 4096
+#define PATH_LEN 4096
+#define MAX_SHARD 1000
+#define PIPE_BUF_LEN (1024 * 1024)
+// -m时同时映射的窗口数上限，决定脏页和page cache的上限
+#define MMAP_WIN_MAX 4
+// 默认断点间隔，单位秒
+#define CKPT_SEC 10
+// 断点里记录每个文件末尾这么多字节的hash，续写前用来校验
+#define TAIL_LEN 4096
+
+struct block_buf
+{
+  long seq;
+  char *buf;
+  // 压缩时的输出缓冲区，压缩完和buf交换
+  char *zbuf;
+  // 按hash分片时先把整块格式化到这里，再按分片重排到buf
+  char *sbuf;
+  // 每个分片在buf中的一段：偏移、长度、压缩前长度、行数
+  unsigned long *seg_off;
+  unsigned long *seg_len;
+  unsigned long *seg_raw;
+  long *seg_rows;
+  // 输出格式的块元数据，交给所属分片的out_format.block_written
+  void *meta;
+  int shard;
+};
+
+/*
+-m模式下映射的一段文件，所有块写完后解除映射
+*/
+struct mmap_win
+{
+  long id;
+  char *addr;
+  unsigned long offset;
+  unsigned long len;
+  long done;
+  int retired;
+};
+
+/*
+一个输出文件，不分片时只有一个
+*/
+struct out_stream
+{
+  char path[PATH_LEN];
+  int fd;
+  // 按行区间分片时本分片的行区间和块数
+  long first_row;
+  long last_row;
+  long block_num;
+  long rows;
+  unsigned long raw;
+  // 逻辑偏移；O_DIRECT时不对齐的部分先攒在stage里
+  unsigned long offset;
+  char *stage;
+  unsigned long stage_len;
+  unsigned long stage_offset;
+  // 管道、FIFO、标准输出等不能pwrite的输出，顺序write
+  int pipe;
+  // 最后写出的tail_len字节的hash
+  int tail_len;
+  unsigned long tail_hash;
+  // 输出格式的状态，比如parquet已写出的row group
+  void *state;
+};
+
+static long loop = 0;
+static unsigned long all_unit_len = 0;
+static char *p_all_unit = NULL;
+static unsigned long total_len = 0;
+static unsigned long block_len = 0;
+static long block_num = 0;
+static long next_block = 0;
+// 断点：间隔、文件名、决定输出内容的参数，续写时从start_block开始
+static int ckpt_sec = CKPT_SEC;
+static char ckpt_path[PATH_LEN];
+static char params[PATH_LEN];
+static long start_block = 0;
+// -m模式：窗口长度(块长的整数倍)、每窗口块数、窗口总数，wins按id % MMAP_WIN_MAX循环使用
+static unsigned long win_len = 0;
+static long win_blocks = 0;
+static long win_num = 0;
+static long win_oldest = 0;
+static struct mmap_win wins[MMAP_WIN_MAX];
+static pthread_cond_t win_cond = PTHREAD_COND_INITIALIZER;
+static int direct = 0;
+static struct schema sc;
+static const struct out_format *fmt = &csv_format;
+// 整块压缩，格式自己压缩时为NULL
+static const struct compressor *zip = NULL;
+static int zip_level = 0;
+static unsigned long zbuf_len = 0;
+static int use_schema = 0;
+static unsigned long seed = 1;
+// 按行切块时每块的行数，是VEC_ROWS的整数倍
+static long block_rows = 0;
+
+// 分片。hash_col>=0时按该列hash分片，否则按行区间；定长格式只能按id(第0列)分
+static int shard_num = 1;
+static int hash_col = -1;
+static struct out_stream *streams = NULL;
+// outputFile为-时数据写到这里(原来的标准输出)，标准输出本身改指向标准错误
+static int stdout_fd = -1;
+// 按行区间分片时，第seq块属于哪个分片、是分片内的第几块
+static int *block_shard = NULL;
+static long *block_local = NULL;
+static long rows_done = 0;
+
+// 缓冲区池：free_list存空闲缓冲区，ready按seq%pool_num存已格式化、等待写出的缓冲区
+static int pool_num = 0;
+static struct block_buf *pool = NULL;
+static struct block_buf **free_list = NULL;
+static int free_num = 0;
+static struct block_buf **ready = NULL;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t free_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
 
 int digit(long number)
 {
@@ -26,83 +176,1347 @@ int digit(long number)
   return count;
 }
 
-int main(int argc, char *argv[])
+/*
+1..n所有数字的位数之和
+*/
+unsigned long sum_digit(long n)
 {
-  if (argc != 5)
+  unsigned long sum = 0;
+  long low = 1;
+  int d = 1;
+  while (low <= n)
   {
-    printf("Params Error! Usage: %s loopNumber unitLength unitNumber outputFile\n", argv[0]);
-    printf("Example: %s 100000000 100 100 /home/aaa/out.txt\n", argv[0]);
-    return 1;
+    long high = low * 10 - 1;
+    if (high > n)
+      high = n;
+    sum += (unsigned long)(high - low + 1) * d;
+    low *= 10;
+    d++;
   }
-  
-  long loop = atol(argv[1]);
-  if (loop <= 0)
+  return sum;
+}
+
+/*
+第row行(从1开始)在文件中的偏移，row_offset(loop+1)即文件总长度
+*/
+unsigned long row_offset(long row)
+{
+  return sum_digit(row - 1) + (unsigned long)(row - 1) * (all_unit_len + 1);
+}
+
+/*
+包含文件偏移offset的那一行
+*/
+long offset_row(unsigned long offset)
+{
+  long lo = 1, hi = loop, mid;
+  while (lo < hi)
   {
-    printf("loopNumber must greater than 0\n");
-    return 1;
+    mid = lo + (hi - lo + 1) / 2;
+    if (row_offset(mid) <= offset)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+static double now_sec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static const char digits_lut[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+/*
+查表法整数转字符串，每次处理两位，返回写入的长度，不写结尾的'\0'
+*/
+int ltoa_lut(long number, char *p_dst)
+{
+  unsigned long n = number;
+  int len = number == 0 ? 1 : digit(number), pos = len;
+  while (n >= 100)
+  {
+    pos -= 2;
+    memcpy(p_dst + pos, digits_lut + (n % 100) * 2, 2);
+    n /= 100;
+  }
+  if (n >= 10)
+    memcpy(p_dst + pos - 2, digits_lut + n * 2, 2);
+  else
+    p_dst[pos - 1] = '0' + n;
+  return len;
+}
+
+/*
+第row行完整写到p_dst，返回行长度
+*/
+unsigned long emit_row(long row, char *p_dst)
+{
+  int len = ltoa_lut(row, p_dst);
+  memcpy(p_dst + len, p_all_unit, all_unit_len);
+  p_dst[len + all_unit_len] = '\n';
+  return len + all_unit_len + 1;
+}
+
+/*
+从first开始连续count行写到p_dst，这些行的id位数必须相同。
+先写第一行，再成倍memcpy铺满整段，常量部分每段只铺一次，最后逐行把id原地加1后覆盖到行首。
+*/
+void emit_rows(long first, long count, char *p_dst)
+{
+  int d = digit(first), k;
+  unsigned long row_len = emit_row(first, p_dst);
+  unsigned long done = row_len, all = row_len * count, n;
+  char id[24];
+  long i;
+  while (done < all)
+  {
+    n = done < all - done ? done : all - done;
+    memcpy(p_dst + done, p_dst, n);
+    done += n;
   }
+  memcpy(id, p_dst, d);
+  for (i = 1; i < count; i++)
+  {
+    for (k = d - 1; id[k] == '9'; k--)
+      id[k] = '0';
+    id[k]++;
+    memcpy(p_dst + row_len * i, id, d);
+  }
+}
+
+/*
+把文件中[offset, offset+len)的内容格式化到p_buf，首尾的行可能只有一部分落在区间内
+*/
+void fill_block(char *p_buf, unsigned long offset, unsigned long len)
+{
+  long i = offset_row(offset), count;
+  unsigned long skip = offset - row_offset(i);
+  unsigned long pos = 0, row_len, n;
+  char *p_row = (char *)malloc(all_unit_len + 32);
+  long next_pow = 10;
+  while (pos < len)
+  {
+    row_len = digit(i) + all_unit_len + 1;
+    if (skip != 0 || pos + row_len > len)
+    {
+      emit_row(i, p_row);
+      n = row_len - skip;
+      if (n > len - pos)
+        n = len - pos;
+      memcpy(p_buf + pos, p_row + skip, n);
+      pos += n;
+      skip = 0;
+      i++;
+      continue;
+    }
+    // 位数相同、且能完整放进缓冲区的一段行
+    while (next_pow <= i)
+      next_pow *= 10;
+    count = (len - pos) / row_len;
+    if (count > next_pow - i)
+      count = next_pow - i;
+    if (count > loop - i + 1)
+      count = loop - i + 1;
+    emit_rows(i, count, p_buf + pos);
+    pos += row_len * count;
+    i += count;
+  }
+  free(p_row);
+}
+
+/*
+原来的sprintf逐行格式化，只用于-B基准测试的对照和校验
+*/
+void fill_block_sprintf(char *p_buf, unsigned long offset, unsigned long len)
+{
+  long i = offset_row(offset);
+  unsigned long skip = offset - row_offset(i);
+  unsigned long pos = 0, row_len;
+  char *p_row = (char *)malloc(all_unit_len + 32);
+  for (; pos < len; i++)
+  {
+    row_len = digit(i) + all_unit_len + 1;
+    if (skip == 0 && pos + row_len <= len)
+    {
+      sprintf(p_buf + pos, "%ld%s\n", i, p_all_unit);
+      pos += row_len;
+      continue;
+    }
+    sprintf(p_row, "%ld%s\n", i, p_all_unit);
+    row_len -= skip;
+    if (row_len > len - pos)
+      row_len = len - pos;
+    memcpy(p_buf + pos, p_row + skip, row_len);
+    pos += row_len;
+    skip = 0;
+  }
+  free(p_row);
+}
+
+/*
+单线程、不落盘，对比sprintf和查表+成倍铺行两种格式化方式的吞吐，并逐块校验结果一致
+*/
+int bench_fill()
+{
+  char *p_old = (char *)malloc(block_len + 1);
+  char *p_new = (char *)malloc(block_len + 1);
+  unsigned long offset, len;
+  double t_old = 0, t_new = 0, t;
+  for (offset = 0; offset < total_len; offset += len)
+  {
+    len = total_len - offset < block_len ? total_len - offset : block_len;
+    t = now_sec();
+    fill_block_sprintf(p_old, offset, len);
+    t_old += now_sec() - t;
+    t = now_sec();
+    fill_block(p_new, offset, len);
+    t_new += now_sec() - t;
+    if (memcmp(p_old, p_new, len) != 0)
+    {
+      printf("mismatch in block at offset %lu\n", offset);
+      return 1;
+    }
+  }
+  printf("sprintf: %.3fs, %.2f Mrows/s, %.2f MB/s\n", t_old, loop / 1e6 / t_old, total_len / 1048576.0 / t_old);
+  printf("lut:     %.3fs, %.2f Mrows/s, %.2f MB/s\n", t_new, loop / 1e6 / t_new, total_len / 1048576.0 / t_new);
+  free(p_old);
+  free(p_new);
+  return 0;
+}
+
+static int pwrite_all(int fd, const char *buf, size_t len, off_t offset)
+{
+  ssize_t ret;
+  while (len > 0)
+  {
+    if ((ret = pwrite(fd, buf, len, offset)) < 0)
+      return -1;
+    buf += ret;
+    len -= ret;
+    offset += ret;
+  }
+  return 0;
+}
+
+static int write_all(int fd, const char *buf, size_t len)
+{
+  ssize_t ret;
+  while (len > 0)
+  {
+    if ((ret = write(fd, buf, len)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += ret;
+    len -= ret;
+  }
+  return 0;
+}
+
+
+/*
+结束在offset之前的行数，offset是定长格式下的文件偏移
+*/
+long rows_before(unsigned long offset)
+{
+  return offset >= total_len ? loop : offset_row(offset) - 1;
+}
+
+static int shard_of(unsigned long h)
+{
+  return (int)(((unsigned __int128)h * shard_num) >> 64);
+}
+
+static void set_seg(struct block_buf *b, int shard, unsigned long len, long rows)
+{
+  memset(b->seg_len, 0x0, shard_num * sizeof(unsigned long));
+  memset(b->seg_rows, 0x0, shard_num * sizeof(long));
+  b->shard = shard;
+  b->seg_off[shard] = 0;
+  b->seg_len[shard] = len;
+  b->seg_rows[shard] = rows;
+}
+
+/*
+按行区间分片(包括不分片)：定长格式在分片内按字节切块，schema模式按行数切块并按输出格式编码
+*/
+void fill_range(struct block_buf *b)
+{
+  struct out_stream *st = &streams[block_shard[b->seq]];
+  long local = block_local[b->seq], first, last;
+  unsigned long offset, end, len;
+  if (use_schema)
+  {
+    first = st->first_row + local * block_rows;
+    last = first + block_rows - 1;
+    if (last > st->last_row)
+      last = st->last_row;
+    len = fmt->encode(&sc, seed, first, last - first + 1, b->buf, &b->meta);
+    set_seg(b, st - streams, len, last - first + 1);
+    return;
+  }
+  offset = row_offset(st->first_row) + local * block_len;
+  end = row_offset(st->last_row + 1);
+  len = end - offset < block_len ? end - offset : block_len;
+  fill_block(b->buf, offset, len);
+  set_seg(b, st - streams, len, rows_before(offset + len) - rows_before(offset));
+}
+
+/*
+按hash分片：先把整块的行格式化到sbuf并算出每行的分片，再按分片计数排序到buf，每个分片一段
+*/
+void fill_hash(struct block_buf *b)
+{
+  long first = b->seq * block_rows + 1, last = first + block_rows - 1, rows, i, r, count;
+  unsigned long len = 0, row_len, pos[shard_num];
+  long next_pow = 10;
+  int n, k, s;
+  char *p, *p_end;
+  if (last > loop)
+    last = loop;
+  rows = last - first + 1;
+  unsigned long *row_start = (unsigned long *)malloc((rows + 1) * sizeof(unsigned long));
+  int *row_shard = (int *)malloc(rows * sizeof(int));
+  if (use_schema)
+  {
+    struct col_vec vecs[sc.col_num];
+    if (schema_alloc_vec(&sc, vecs) < 0)
+    {
+      printf("malloc column vector error\n");
+      exit(1);
+    }
+    for (i = first, r = 0; i <= last; i += VEC_ROWS)
+    {
+      n = last - i + 1 < VEC_ROWS ? last - i + 1 : VEC_ROWS;
+      schema_gen(&sc, seed, i, n, vecs);
+      p = b->sbuf + len;
+      len += schema_format(&sc, vecs, n, p);
+      for (k = 0; k < n; k++, r++)
+      {
+        row_shard[r] = shard_of(schema_key_hash(&sc.cols[hash_col], &vecs[hash_col], k));
+        row_start[r] = p - b->sbuf;
+        p_end = memchr(p, '\n', b->sbuf + len - p);
+        p = p_end + 1;
+      }
+    }
+    schema_free_vec(&sc, vecs);
+  }
+  else
+  {
+    for (i = first, r = 0; i <= last; i += count)
+    {
+      while (next_pow <= i)
+        next_pow *= 10;
+      count = last - i + 1 < next_pow - i ? last - i + 1 : next_pow - i;
+      emit_rows(i, count, b->sbuf + len);
+      row_len = digit(i) + all_unit_len + 1;
+      for (k = 0; k < count; k++, r++)
+      {
+        row_shard[r] = shard_of(hash64(i + k));
+        row_start[r] = len + row_len * k;
+      }
+      len += row_len * count;
+    }
+  }
+  row_start[rows] = len;
+  memset(b->seg_len, 0x0, shard_num * sizeof(unsigned long));
+  memset(b->seg_rows, 0x0, shard_num * sizeof(long));
+  for (r = 0; r < rows; r++)
+  {
+    b->seg_len[row_shard[r]] += row_start[r + 1] - row_start[r];
+    b->seg_rows[row_shard[r]]++;
+  }
+  for (s = 0, len = 0; s < shard_num; s++)
+  {
+    b->seg_off[s] = pos[s] = len;
+    len += b->seg_len[s];
+  }
+  for (r = 0; r < rows; r++)
+  {
+    row_len = row_start[r + 1] - row_start[r];
+    memcpy(b->buf + pos[row_shard[r]], b->sbuf + row_start[r], row_len);
+    pos[row_shard[r]] += row_len;
+  }
+  b->shard = -1;
+  b->meta = NULL;
+  free(row_start);
+  free(row_shard);
+}
+
+void *work(void *arg)
+{
+  struct block_buf *b;
+  unsigned long zlen;
+  char *p_tmp;
+  int s;
+  for (;;)
+  {
+    // 先拿到缓冲区再领seq，保证持有缓冲区的seq都已领出，最小的那个一定能被写出，不会死锁
+    pthread_mutex_lock(&pool_lock);
+    while (free_num == 0)
+      pthread_cond_wait(&free_cond, &pool_lock);
+    b = free_list[--free_num];
+    if (next_block >= block_num)
+    {
+      free_list[free_num++] = b;
+      pthread_cond_signal(&free_cond);
+      pthread_mutex_unlock(&pool_lock);
+      break;
+    }
+    b->seq = next_block++;
+    pthread_mutex_unlock(&pool_lock);
+
+    if (hash_col >= 0)
+      fill_hash(b);
+    else
+      fill_range(b);
+    memcpy(b->seg_raw, b->seg_len, shard_num * sizeof(unsigned long));
+    // 每个分片的一段各自压缩成独立的member/frame
+    if (zip != NULL)
+    {
+      for (s = 0, zlen = 0; s < shard_num; s++)
+      {
+        if (b->seg_len[s] == 0)
+          continue;
+        b->seg_len[s] = zip->compress(b->buf + b->seg_off[s], b->seg_len[s], b->zbuf + zlen, zbuf_len - zlen, zip_level);
+        b->seg_off[s] = zlen;
+        zlen += b->seg_len[s];
+      }
+      p_tmp = b->buf;
+      b->buf = b->zbuf;
+      b->zbuf = p_tmp;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    ready[b->seq % pool_num] = b;
+    pthread_cond_broadcast(&ready_cond);
+    pthread_mutex_unlock(&pool_lock);
+  }
+  return NULL;
+}
+
+/*
+-m模式的工作线程。领到的块所在窗口比最老的未完成窗口超前MMAP_WIN_MAX个时先等，
+最老窗口剩下的块都已被没在等待的线程领走，不会死锁
+*/
+void *work_mmap(void *arg)
+{
+  struct mmap_win *w;
+  unsigned long offset, len;
+  long seq, id;
+  for (;;)
+  {
+    pthread_mutex_lock(&pool_lock);
+    if (next_block >= block_num)
+    {
+      pthread_mutex_unlock(&pool_lock);
+      break;
+    }
+    seq = next_block++;
+    id = seq / win_blocks;
+    while (id >= win_oldest + MMAP_WIN_MAX)
+      pthread_cond_wait(&win_cond, &pool_lock);
+    w = &wins[id % MMAP_WIN_MAX];
+    if (w->addr == NULL || w->id != id)
+    {
+      w->id = id;
+      w->offset = id * win_len;
+      w->len = total_len - w->offset < win_len ? total_len - w->offset : win_len;
+      w->done = 0;
+      w->retired = 0;
+      if (MAP_FAILED == (w->addr = (char *)mmap(NULL, w->len, PROT_READ | PROT_WRITE, MAP_SHARED, streams[0].fd, w->offset)))
+      {
+        printf("mmap %s error: %s, pls check!\n", streams[0].path, strerror(errno));
+        exit(1);
+      }
+      madvise(w->addr, w->len, MADV_SEQUENTIAL);
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    offset = seq * block_len;
+    len = total_len - offset < block_len ? total_len - offset : block_len;
+    fill_block(w->addr + (offset - w->offset), offset, len);
+
+    pthread_mutex_lock(&pool_lock);
+    if (++w->done < (w->len + block_len - 1) / block_len)
+    {
+      pthread_mutex_unlock(&pool_lock);
+      continue;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    // 窗口写满：刷盘后解除映射，再丢掉已经干净的page cache
+    if (msync(w->addr, w->len, MS_SYNC) < 0)
+    {
+      printf("msync %s error: %s, pls check!\n", streams[0].path, strerror(errno));
+      exit(1);
+    }
+    munmap(w->addr, w->len);
+    posix_fadvise(streams[0].fd, w->offset, w->len, POSIX_FADV_DONTNEED);
+    pthread_mutex_lock(&pool_lock);
+    w->retired = 1;
+    while (win_oldest < win_num && wins[win_oldest % MMAP_WIN_MAX].id == win_oldest && wins[win_oldest % MMAP_WIN_MAX].retired)
+    {
+      win_oldest++;
+      if (win_oldest * 10 / win_num != (win_oldest - 1) * 10 / win_num)
+        printf("finished %ld\n", win_oldest == win_num ? loop : offset_row(win_oldest * win_len) - 1);
+    }
+    pthread_cond_broadcast(&win_cond);
+    pthread_mutex_unlock(&pool_lock);
+  }
+  return NULL;
+}
+
+/*
+-m模式：一次性分配好整个文件，空间不够直接报错而不是写到一半
+*/
+int init_mmap(int win_mb)
+{
+  struct out_stream *st = &streams[0];
+  win_len = ((unsigned long)win_mb * 1024 * 1024 + block_len - 1) / block_len * block_len;
+  win_blocks = win_len / block_len;
+  win_num = (total_len + win_len - 1) / win_len;
+  if (st->pipe)
+  {
+    printf("-m needs a regular file\n");
+    return -1;
+  }
+  // 共享可写映射要求以读写方式打开
+  close(st->fd);
+  if ((st->fd = open(st->path, O_RDWR)) < 0)
+  {
+    printf("Can not open file: %s\n", st->path);
+    return -1;
+  }
+  if (ftruncate(st->fd, total_len) < 0)
+  {
+    printf("ftruncate %s error: %s, pls check!\n", st->path, strerror(errno));
+    return -1;
+  }
+  // 有的文件系统不支持fallocate，ftruncate出来的稀疏文件也能映射
+  if ((errno = posix_fallocate(st->fd, 0, total_len)) != 0 && errno != EOPNOTSUPP && errno != EINVAL)
+  {
+    printf("fallocate %lu bytes for %s error: %s\n", total_len, st->path, strerror(errno));
+    return -1;
+  }
+  st->offset = total_len;
+  st->rows = loop;
+  st->raw = total_len;
+  return 0;
+}
+
+unsigned long fnv_hash(const char *p, unsigned long len)
+{
+  unsigned long h = 0xcbf29ce484222325UL;
+  while (len-- > 0)
+    h = (h ^ (unsigned char)*p++) * 0x100000001b3UL;
+  return h;
+}
+
+/*
+顺序追加写出。O_DIRECT要求偏移和长度都对齐：对齐的块直接写，否则先拷进stage，凑满对齐的部分再写
+*/
+void write_out(struct out_stream *st, char *p_buf, unsigned long len)
+{
+  unsigned long n;
+  if (len > 0)
+  {
+    st->tail_len = len < TAIL_LEN ? len : TAIL_LEN;
+    st->tail_hash = fnv_hash(p_buf + len - st->tail_len, st->tail_len);
+  }
+  if (!direct || (st->stage_len == 0 && len % IO_ALIGN == 0))
+  {
+    if ((st->pipe ? write_all(st->fd, p_buf, len) : pwrite_all(st->fd, p_buf, len, st->offset)) < 0)
+    {
+      printf("write %s error: %s, pls check!\n", st->path, strerror(errno));
+      exit(1);
+    }
+    st->offset += len;
+    st->stage_offset = st->offset;
+    return;
+  }
+  while (len > 0)
+  {
+    n = block_len - st->stage_len < len ? block_len - st->stage_len : len;
+    memcpy(st->stage + st->stage_len, p_buf, n);
+    st->stage_len += n;
+    p_buf += n;
+    len -= n;
+    st->offset += n;
+    n = st->stage_len / IO_ALIGN * IO_ALIGN;
+    if (st->stage_len == block_len || len == 0)
+    {
+      if (n > 0 && pwrite_all(st->fd, st->stage, n, st->stage_offset) < 0)
+      {
+        printf("pwrite %s error: %s, pls check!\n", st->path, strerror(errno));
+        exit(1);
+      }
+      st->stage_offset += n;
+      st->stage_len -= n;
+      memmove(st->stage, st->stage + n, st->stage_len);
+    }
+  }
+}
+
+/*
+O_DIRECT下把stage里剩下的不足对齐长度的尾巴补零写出，之后由ftruncate截掉补的部分
+*/
+void flush_stage(struct out_stream *st)
+{
+  if (st->stage_len == 0)
+    return;
+  memset(st->stage + st->stage_len, 0x0, IO_ALIGN - st->stage_len);
+  if (pwrite_all(st->fd, st->stage, IO_ALIGN, st->stage_offset) < 0)
+  {
+    printf("pwrite %s error: %s, pls check!\n", st->path, strerror(errno));
+    exit(1);
+  }
+  st->stage_len = 0;
+}
+
+/*
+写断点：先把数据落盘(O_DIRECT下stage里的尾巴补零写出但不清掉，后面会被覆盖)，再写临时文件rename过去，
+所以断点里的位置一定已经在盘上
+*/
+int write_checkpoint(long next_seq)
+{
+  char tmp[PATH_LEN + 8];
+  struct out_stream *st;
+  unsigned long n;
+  FILE *fp;
+  int s;
+  for (s = 0; s < shard_num; s++)
+  {
+    st = &streams[s];
+    if (direct && st->stage_len > 0)
+    {
+      n = (st->stage_len + IO_ALIGN - 1) / IO_ALIGN * IO_ALIGN;
+      memset(st->stage + st->stage_len, 0x0, n - st->stage_len);
+      if (pwrite_all(st->fd, st->stage, n, st->stage_offset) < 0)
+        return -1;
+    }
+    if (fdatasync(st->fd) < 0)
+      return -1;
+  }
+  snprintf(tmp, sizeof(tmp), "%s.tmp", ckpt_path);
+  if ((fp = fopen(tmp, "w")) == NULL)
+    return -1;
+  fprintf(fp, "# genDbBigData checkpoint, continue with --resume\n");
+  fprintf(fp, "params %s\n", params);
+  fprintf(fp, "block %ld %ld\n", next_seq, rows_done);
+  for (s = 0; s < shard_num; s++)
+  {
+    st = &streams[s];
+    fprintf(fp, "shard %d %lu %ld %lu %d %lx\n", s, st->offset, st->rows, st->raw, st->tail_len, st->tail_hash);
+  }
+  if (fflush(fp) != 0 || fsync(fileno(fp)) < 0)
+  {
+    fclose(fp);
+    return -1;
+  }
+  fclose(fp);
+  return rename(tmp, ckpt_path);
+}
+
+/*
+读断点，参数必须和本次运行一致
+*/
+int read_checkpoint()
+{
+  char line[PATH_LEN + 64];
+  struct out_stream *st;
+  int s, found = 0;
+  FILE *fp;
+  start_block = -1;
+  if ((fp = fopen(ckpt_path, "r")) == NULL)
+  {
+    printf("no checkpoint %s to resume from\n", ckpt_path);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    line[strcspn(line, "\n")] = '\0';
+    if (strncmp(line, "params ", 7) == 0 && strcmp(line + 7, params) != 0)
+    {
+      printf("checkpoint was written with different params:\n  %s\nnow:\n  %s\n", line + 7, params);
+      fclose(fp);
+      return -1;
+    }
+    if (sscanf(line, "block %ld %ld", &start_block, &rows_done) == 2)
+      continue;
+    if (sscanf(line, "shard %d", &s) == 1 && s >= 0 && s < shard_num)
+    {
+      st = &streams[s];
+      if (sscanf(line, "shard %d %lu %ld %lu %d %lx", &s, &st->offset, &st->rows, &st->raw, &st->tail_len, &st->tail_hash) == 6)
+        found++;
+    }
+  }
+  fclose(fp);
+  if (start_block <= 0 || start_block > block_num || found != shard_num)
+  {
+    printf("broken checkpoint %s\n", ckpt_path);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+校验文件末尾和断点一致，O_DIRECT时把最后不足对齐长度的部分读回stage
+*/
+int resume_stream(struct out_stream *st)
+{
+  char tail[TAIL_LEN];
+  struct stat sb;
+  int fd;
+  if ((fd = open(st->path, O_RDONLY)) < 0 || fstat(fd, &sb) < 0)
+  {
+    printf("Can not open file: %s\n", st->path);
+    return -1;
+  }
+  if (sb.st_size < st->offset
+      || pread(fd, tail, st->tail_len, st->offset - st->tail_len) != st->tail_len
+      || fnv_hash(tail, st->tail_len) != st->tail_hash)
+  {
+    printf("%s does not match checkpoint, can not resume\n", st->path);
+    close(fd);
+    return -1;
+  }
+  st->stage_len = direct ? st->offset % IO_ALIGN : 0;
+  st->stage_offset = st->offset - st->stage_len;
+  if (st->stage_len > 0 && pread(fd, st->stage, st->stage_len, st->stage_offset) != st->stage_len)
+  {
+    printf("read %s error, can not resume\n", st->path);
+    close(fd);
+    return -1;
+  }
+  close(fd);
+  return 0;
+}
+
+/*
+写出格式的文件头/尾。有-z时和块一样压成独立的member/frame，否则拼接后的输出不是合法的压缩流
+*/
+void write_extra(struct out_stream *st, char *p_extra, unsigned long len)
+{
+  char *p_zip;
+  unsigned long zlen;
+  if (zip == NULL || len == 0)
+  {
+    write_out(st, p_extra, len);
+    return;
+  }
+  if ((p_zip = malloc(zip->bound(len) + 1024)) == NULL)
+  {
+    printf("malloc error\n");
+    exit(1);
+  }
+  zlen = zip->compress(p_extra, len, p_zip, zip->bound(len) + 1024, zip_level);
+  write_out(st, p_zip, zlen);
+  st->raw += len;
+  free(p_zip);
+}
+
+/*
+写线程，按seq顺序把每块的各段写到对应分片，写完归还缓冲区
+*/
+void write_blocks()
+{
+  long seq;
+  struct block_buf *b;
+  struct out_stream *st;
+  char *p_extra = NULL;
+  unsigned long len;
+  double last_ckpt = now_sec();
+  int s;
+  for (s = 0; s < shard_num && fmt->header != NULL && start_block == 0; s++)
+  {
+    len = fmt->header(&sc, &p_extra);
+    write_extra(&streams[s], p_extra, len);
+    free(p_extra);
+  }
+  for (seq = start_block; seq < block_num; seq++)
+  {
+    pthread_mutex_lock(&pool_lock);
+    while (NULL == (b = ready[seq % pool_num]) || b->seq != seq)
+      pthread_cond_wait(&ready_cond, &pool_lock);
+    ready[seq % pool_num] = NULL;
+    pthread_mutex_unlock(&pool_lock);
+
+    for (s = 0; s < shard_num; s++)
+    {
+      if (b->seg_len[s] == 0)
+        continue;
+      st = &streams[s];
+      len = st->offset;
+      write_out(st, b->buf + b->seg_off[s], b->seg_len[s]);
+      st->raw += b->seg_raw[s];
+      st->rows += b->seg_rows[s];
+      rows_done += b->seg_rows[s];
+      if (s == b->shard && fmt->block_written != NULL)
+        fmt->block_written(&st->state, b->meta, len);
+      else if (s == b->shard)
+        free(b->meta);
+    }
+    b->meta = NULL;
+    // 每跨过10%打印一次进度
+    if ((seq + 1) * 10 / block_num != seq * 10 / block_num)
+      printf("finished %ld\n", rows_done);
+
+    pthread_mutex_lock(&pool_lock);
+    free_list[free_num++] = b;
+    pthread_cond_signal(&free_cond);
+    pthread_mutex_unlock(&pool_lock);
+
+    if (ckpt_sec > 0 && seq + 1 < block_num && now_sec() - last_ckpt >= ckpt_sec)
+    {
+      if (write_checkpoint(seq + 1) < 0)
+        printf("write checkpoint %s error: %s\n", ckpt_path, strerror(errno));
+      last_ckpt = now_sec();
+    }
+  }
+  for (s = 0; s < shard_num; s++)
+  {
+    st = &streams[s];
+    if (fmt->footer != NULL)
+    {
+      len = fmt->footer(&st->state, &sc, st->rows, &p_extra);
+      write_extra(st, p_extra, len);
+      free(p_extra);
+    }
+    if (direct)
+      flush_stage(st);
+  }
+}
+
+/*
+分片文件名：在outputFile的扩展名前插入_分片号，例如out.txt -> out_03.txt
+*/
+void shard_path(const char *file, int shard, char *p_path)
+{
+  const char *base = strrchr(file, '/') == NULL ? file : strrchr(file, '/') + 1;
+  const char *dot = strchr(base + 1, '.');
+  int width = digit(shard_num - 1) < 2 ? 2 : digit(shard_num - 1);
+  if (shard_num == 1)
+    snprintf(p_path, PATH_LEN, "%s", file);
+  else if (*base == '\0' || dot == NULL)
+    snprintf(p_path, PATH_LEN, "%s_%0*d", file, width, shard);
+  else
+    snprintf(p_path, PATH_LEN, "%.*s_%0*d%s", (int)(dot - file), file, width, shard, dot);
+}
+
+int open_stream(struct out_stream *st)
+{
+  struct stat sb;
+  if (strcmp(st->path, "-") == 0)
+    st->fd = stdout_fd;
+  else if (stat(st->path, &sb) == 0 && S_ISFIFO(sb.st_mode))
+  {
+    // 没有读端时open会一直等，导入程序可以后启动
+    printf("waiting for reader on %s\n", st->path);
+    if ((st->fd = open(st->path, O_WRONLY)) < 0)
+    {
+      printf("Can not open fifo: %s\n", st->path);
+      return -1;
+    }
+  }
+  else if ((st->fd = open(st->path, O_WRONLY | O_CREAT | (direct ? O_DIRECT : 0), S_IRUSR | S_IWUSR)) < 0)
+  {
+    // tmpfs等文件系统不支持O_DIRECT
+    if (direct && errno == EINVAL && (st->fd = open(st->path, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR)) >= 0)
+    {
+      printf("O_DIRECT not supported on %s, fall back to buffered io\n", st->path);
+      direct = 0;
+    }
+    else
+    {
+      printf("Can not open file: %s\n", st->path);
+      return -1;
+    }
+  }
+  if (fstat(st->fd, &sb) == 0 && !S_ISREG(sb.st_mode) && !S_ISBLK(sb.st_mode))
+  {
+    st->pipe = 1;
+    if (direct)
+      printf("%s is not a regular file, O_DIRECT ignored\n", st->path);
+    direct = 0;
+    // 加大管道缓冲，减少写线程和导入程序之间的来回唤醒，失败不影响
+    if (S_ISFIFO(sb.st_mode))
+      fcntl(st->fd, F_SETPIPE_SZ, PIPE_BUF_LEN);
+  }
+  if (direct && 0 != posix_memalign((void **)&st->stage, IO_ALIGN, block_len))
+  {
+    printf("malloc stage buffer error\n");
+    return -1;
+  }
+  return 0;
+}
+
+/*
+划分分片并建立块到分片的映射。按行区间时分片边界对齐到VEC_ROWS，保证schema列向量的播种不受分片影响
+*/
+int init_shards(const char *file)
+{
+  long units = (loop + VEC_ROWS - 1) / VEC_ROWS, u0, u1, seq, next[shard_num];
+  int s;
+  streams = (struct out_stream *)calloc(shard_num, sizeof(struct out_stream));
+  for (s = 0; s < shard_num; s++)
+  {
+    struct out_stream *st = &streams[s];
+    shard_path(file, s, st->path);
+    if (hash_col >= 0)
+      continue;
+    u0 = units * s / shard_num;
+    u1 = units * (s + 1) / shard_num;
+    if (u0 == u1)
+    {
+      printf("too many shards for %ld rows\n", loop);
+      return -1;
+    }
+    st->first_row = u0 * VEC_ROWS + 1;
+    st->last_row = u1 * VEC_ROWS < loop ? u1 * VEC_ROWS : loop;
+    if (use_schema)
+      st->block_num = (st->last_row - st->first_row + block_rows) / block_rows;
+    else
+      st->block_num = (row_offset(st->last_row + 1) - row_offset(st->first_row) + block_len - 1) / block_len;
+  }
+  if (hash_col >= 0)
+  {
+    block_num = (loop + block_rows - 1) / block_rows;
+    return 0;
+  }
+  // 各分片轮流出块
+  for (block_num = 0, s = 0; s < shard_num; s++)
+    block_num += streams[s].block_num;
+  block_shard = (int *)malloc(block_num * sizeof(int));
+  block_local = (long *)malloc(block_num * sizeof(long));
+  memset(next, 0x0, sizeof(next));
+  for (seq = 0; seq < block_num;)
+  {
+    for (s = 0; s < shard_num; s++)
+    {
+      if (next[s] == streams[s].block_num)
+        continue;
+      block_shard[seq] = s;
+      block_local[seq++] = next[s]++;
+    }
+  }
+  return 0;
+}
+
+/*
+分片清单，每行一个分片：分片号、文件、行数、字节数、起止行(按hash分片时为-)
+*/
+int write_manifest(const char *file)
+{
+  char path[PATH_LEN];
+  int s;
+  FILE *fp;
+  snprintf(path, PATH_LEN, "%s.manifest", file);
+  if ((fp = fopen(path, "w")) == NULL)
+  {
+    printf("Can not open file: %s\n", path);
+    return -1;
+  }
+  fprintf(fp, "# shard\tfile\trows\tbytes\tfirst_row\tlast_row\n");
+  for (s = 0; s < shard_num; s++)
+  {
+    if (hash_col >= 0)
+      fprintf(fp, "%d\t%s\t%ld\t%lu\t-\t-\n", s, streams[s].path, streams[s].rows, streams[s].offset);
+    else
+      fprintf(fp, "%d\t%s\t%ld\t%lu\t%ld\t%ld\n", s, streams[s].path, streams[s].rows, streams[s].offset, streams[s].first_row, streams[s].last_row);
+  }
+  fclose(fp);
+  printf("manifest: %s\n", path);
+  return 0;
+}
+
+/*
+loopNumber之外的两个参数：每列长度unitLength、列数unitNumber，构造每行id之后的固定部分
+*/
+int init_fixed(char *argv[])
+{
+  unsigned long i;
   long u_len = atol(argv[2]);
   if (u_len <= 0)
   {
     printf("unitLength must greater than 0\n");
-    return 1;
+    return -1;
   }
   long u_num = atol(argv[3]);
   if (u_num <= 0)
   {
     printf("unitNumber must greater than 0\n");
-    return 1;
-  }
-  unsigned long all_unit_len = (u_len + 1) * u_num;
-  char *file = argv[4];
-  unsigned long i;
-  unsigned int index_len;
-  unsigned long row_len;
-  unsigned int fd = -1, ret = -1;
-  unsigned long offset = 0L;
-  
-  if ((fd = open(file, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR)) < 0)
-  {
-    printf("Can not open file: %s\n", file);
-    return 1;
+    return -1;
   }
+  all_unit_len = (u_len + 1) * u_num;
   
   char *p_unit = (char *)malloc((u_len + 2) * sizeof(char));
   memset(p_unit, 0x0, u_len + 2);
   memcpy(p_unit, SEPARATOR, 1);
   for (i=1; i<u_len+1; i++)
-    memcpy(p_unit + i, STR_UNIT + 1);
+    memcpy(p_unit + i, STR_UNIT, 1);
   
-  char *p_all_unit = (char *)malloc((all_unit_len + 1) * sizeof(char));
+  p_all_unit = (char *)malloc((all_unit_len + 1) * sizeof(char));
   memset(p_all_unit, 0x0, all_unit_len + 1);
   
   for (i=0; i<u_num; i++)
     memcpy(p_all_unit + (u_len + 1) * i, p_unit, u_len + 1);
+  free(p_unit);
+  p_unit = NULL;
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int opt;
+  int thread_num = sysconf(_SC_NPROCESSORS_ONLN);
+  int block_mb = BLOCK_MB;
+  int bench = 0;
+  char *schema_file = NULL;
+  char *zip_name = NULL;
+  char *hash_name = NULL;
+  int resume = 0;
+  int win_mb = 0;
+  static const struct option long_opts[] = { { "resume", no_argument, NULL, 'R' }, { NULL, 0, NULL, 0 } };
+  while ((opt = getopt_long(argc, argv, "t:b:dBs:S:f:z:l:k:H:c:Rm:", long_opts, NULL)) != -1)
+  {
+    switch (opt)
+    {
+      case 't':
+        thread_num = atoi(optarg);
+        break;
+      case 'b':
+        block_mb = atoi(optarg);
+        break;
+      case 'd':
+        direct = 1;
+        break;
+      case 'B':
+        bench = 1;
+        break;
+      case 's':
+        schema_file = optarg;
+        use_schema = 1;
+        break;
+      case 'S':
+        seed = strtoul(optarg, NULL, 0);
+        break;
+      case 'f':
+        if ((fmt = find_format(optarg)) == NULL)
+        {
+          printf("unknown output format: %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'z':
+        zip_name = optarg;
+        break;
+      case 'l':
+        zip_level = atoi(optarg);
+        break;
+      case 'k':
+        shard_num = atoi(optarg);
+        break;
+      case 'H':
+        hash_name = optarg;
+        break;
+      case 'c':
+        ckpt_sec = atoi(optarg);
+        break;
+      case 'R':
+        resume = 1;
+        break;
+      case 'm':
+        win_mb = atoi(optarg);
+        break;
+      default:
+        argc = 0;
+        break;
+    }
+  }
+  if (argc - optind != (use_schema ? 2 : 4) && !(bench && !use_schema && argc - optind == 3))
+  {
+    printf("Params Error! Usage: %s [-t threadNum] [-b blockMB] [-d] [-z gzip|zstd|lz4] [-l level] [-k shardNum] [-H id] [-m windowMB] [-c sec] [--resume] [-B] loopNumber unitLength unitNumber outputFile\n", argv[0]);
+    printf("       %s [-t threadNum] [-b blockMB] [-d] [-z gzip|zstd|lz4] [-l level] [-k shardNum] [-H column] [-c sec] [--resume] [-S seed] [-f format] -s schemaFile loopNumber outputFile\n", argv[0]);
+    printf("  -t  format and compress threads, default online cpus\n");
+    printf("  -b  write block size in MB, default %d\n", BLOCK_MB);
+    printf("  -d  write with O_DIRECT\n");
+    printf("  -z  compress every block, output is concatenated gzip members/zstd or lz4 frames; parquet compresses pages\n");
+    printf("  -l  compression level, default depends on -z\n");
+    printf("  -k  split output into shardNum files by row range, a manifest is written to outputFile.manifest\n");
+    printf("  -H  with -k, shard by hash of this column instead of row range (csv only, id without -s)\n");
+    printf("  -m  without -s, fallocate the whole file and format rows straight into windowMB mmap windows\n");
+    printf("  -c  write a checkpoint to outputFile.ckpt every sec seconds, 0 to disable, default %d\n", CKPT_SEC);
+    printf("  -R, --resume  verify outputFile against its checkpoint and continue from there\n");
+    printf("  -B  benchmark row formatting against sprintf in memory, outputFile not needed\n");
+    printf("  -s  generate typed columns described by schemaFile, see genDbSchema.c\n");
+    printf("  -S  random seed for schema columns, default 1\n");
+    printf("  -f  output format with -s: csv, parquet or pgbinary, default csv; each block is a parquet row group\n");
+    printf("  outputFile can be a fifo or - for stdout to stream into a loader, e.g. psql copy from stdin\n");
+    printf("Example: %s -t 8 -d 100000000 100 100 /home/aaa/out.txt\n", argv[0]);
+    printf("Example: %s -t 8 -k 4 -s user.schema 100000000 /home/aaa/user.txt\n", argv[0]);
+    return 1;
+  }
+  argv += optind - 1;
   
-  char *p_row = (char *)malloc((all_unit_len + 256) * sizeof(char));
+  loop = atol(argv[1]);
+  if (loop <= 0)
+  {
+    printf("loopNumber must greater than 0\n");
+    return 1;
+  }
+  if (thread_num <= 0)
+    thread_num = 1;
+  if (block_mb <= 0)
+    block_mb = BLOCK_MB;
+  if (shard_num <= 0 || shard_num > MAX_SHARD)
+  {
+    printf("shardNum must between 1 and %d\n", MAX_SHARD);
+    return 1;
+  }
+  block_len = (unsigned long)block_mb * 1024 * 1024;
+  if (zip_name != NULL)
+  {
+    if ((zip = find_compressor(zip_name)) == NULL)
+    {
+      printf("unknown or not compiled in compressor: %s\n", zip_name);
+      return 1;
+    }
+    if (zip_level == 0)
+      zip_level = zip->default_level;
+    if (fmt->set_compressor != NULL)
+    {
+      fmt->set_compressor(zip, zip_level);
+      zip = NULL;
+    }
+    else
+      zbuf_len = zip->bound(block_len) + shard_num * 1024;
+  }
+  // -B只在内存中格式化，没有outputFile
+  if (bench && !use_schema)
+  {
+    if (fmt != &csv_format)
+    {
+      printf("output format %s needs -s schemaFile\n", fmt->name);
+      return 1;
+    }
+    if (init_fixed(argv) < 0)
+      return 1;
+    total_len = row_offset(loop + 1);
+    block_num = (total_len + block_len - 1) / block_len;
+    return bench_fill();
+  }
+  char *file = argv[use_schema ? 2 : 4];
+  unsigned long i;
+  if (strcmp(file, "-") == 0)
+  {
+    if (shard_num > 1)
+    {
+      printf("can not shard to stdout\n");
+      return 1;
+    }
+    fflush(stdout);
+    stdout_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+  }
+  // 导入程序提前退出时让write返回EPIPE报错，而不是被信号直接杀掉
+  signal(SIGPIPE, SIG_IGN);
   
-  for (i=1; i<=loop; i++)
+  if (use_schema)
   {
-    index_len = digit(i);
-    memset(p_row, 0x0, all_unit_len + 256);
-    sprintf(p_row, "%ld%s\n", i, p_all_unit);
-    row_len - index + all_unit_len + 1;
-    if ((ret = pwrite(fd, p_row, row_len, offset)) < 0)
+    if (schema_load(schema_file, &sc) < 0)
+      return 1;
+    schema_set_rows(&sc, loop);
+    unsigned long extra, bound = fmt->row_bound(&sc, &extra);
+    block_rows = block_len > extra ? (block_len - extra) / bound / VEC_ROWS * VEC_ROWS : 0;
+    if (block_rows == 0)
     {
-      prinntf("pwrite error, pls check!\n");
+      printf("blockMB too small for a row of %lu bytes\n", bound);
       return 1;
     }
-    offset += row_len;
-    if (i % (loop / 10) == 0)
-      printf("finished %ld\n", i);
+    for (i = 0; hash_name != NULL && i < sc.col_num; i++)
+    {
+      if (strcmp(sc.cols[i].name, hash_name) == 0)
+        hash_col = i;
+    }
   }
-  close(fd);
-  free(p_unit);
+  else
+  {
+    if (fmt != &csv_format)
+    {
+      printf("output format %s needs -s schemaFile\n", fmt->name);
+      return 1;
+    }
+    if (init_fixed(argv) < 0)
+      return 1;
+    total_len = row_offset(loop + 1);
+    if (hash_name != NULL && strcmp(hash_name, "id") == 0)
+      hash_col = 0;
+    block_rows = block_len / (all_unit_len + 21);
+    if (block_rows == 0)
+    {
+      printf("blockMB too small for a row of %lu bytes\n", all_unit_len + 21);
+      return 1;
+    }
+  }
+  if (hash_name != NULL && hash_col < 0)
+  {
+    printf("no column named %s to shard by\n", hash_name);
+    return 1;
+  }
+  if (hash_col >= 0 && fmt != &csv_format)
+  {
+    printf("hash sharding only supports csv output\n");
+    return 1;
+  }
+  if (win_mb > 0 && (use_schema || zip != NULL || shard_num > 1 || direct || resume))
+  {
+    printf("-m can not be used with -s, -z, -k, -d or --resume\n");
+    return 1;
+  }
+  if (init_shards(file) < 0)
+    return 1;
+  for (i = 0; i < shard_num; i++)
+  {
+    if (open_stream(&streams[i]) < 0)
+      return 1;
+    // 管道没法回头续写
+    if (streams[i].pipe)
+      ckpt_sec = 0;
+  }
+  // 输出内容只取决于这些参数，和线程数、O_DIRECT无关
+  snprintf(ckpt_path, PATH_LEN, "%s.ckpt", file);
+  if (use_schema)
+    snprintf(params, PATH_LEN, "rows=%ld schema=%s seed=%lu format=%s", loop, schema_file, seed, fmt->name);
+  else
+    snprintf(params, PATH_LEN, "rows=%ld unit=%s*%s", loop, argv[2], argv[3]);
+  snprintf(params + strlen(params), PATH_LEN - strlen(params), " block=%d zip=%s level=%d shards=%d hash=%d",
+           block_mb, zip != NULL ? zip->name : "none", zip_level, shard_num, hash_col);
+  if (resume)
+  {
+    // parquet的文件尾需要之前每个row group的元数据，断点里没有
+    if (fmt->block_written != NULL || ckpt_sec == 0)
+    {
+      printf("can not resume %s output\n", ckpt_sec == 0 ? "pipe or checkpoint disabled" : fmt->name);
+      return 1;
+    }
+    if (read_checkpoint() < 0)
+      return 1;
+    for (i = 0; i < shard_num; i++)
+    {
+      if (resume_stream(&streams[i]) < 0)
+        return 1;
+    }
+    next_block = start_block;
+    printf("resume from block %ld, %ld rows already written\n", start_block, rows_done);
+  }
+  else
+    unlink(ckpt_path);
+  if (win_mb > 0 && init_mmap(win_mb) < 0)
+    return 1;
+  
+  if (thread_num > block_num)
+    thread_num = block_num;
+  
+  pool_num = win_mb > 0 ? 0 : thread_num * 2;
+  pool = (struct block_buf *)calloc(pool_num, sizeof(struct block_buf));
+  free_list = (struct block_buf **)malloc(pool_num * sizeof(struct block_buf *));
+  ready = (struct block_buf **)calloc(pool_num, sizeof(struct block_buf *));
+  for (i = 0; i < pool_num; i++)
+  {
+    if (0 != posix_memalign((void **)&pool[i].buf, IO_ALIGN, block_len))
+    {
+      printf("malloc block buffer error\n");
+      return 1;
+    }
+    if (zip != NULL && 0 != posix_memalign((void **)&pool[i].zbuf, IO_ALIGN, zbuf_len))
+    {
+      printf("malloc compress buffer error\n");
+      return 1;
+    }
+    if (hash_col >= 0 && NULL == (pool[i].sbuf = (char *)malloc(block_len)))
+    {
+      printf("malloc shard buffer error\n");
+      return 1;
+    }
+    pool[i].seg_off = (unsigned long *)malloc(shard_num * sizeof(unsigned long));
+    pool[i].seg_len = (unsigned long *)malloc(shard_num * sizeof(unsigned long));
+    pool[i].seg_raw = (unsigned long *)malloc(shard_num * sizeof(unsigned long));
+    pool[i].seg_rows = (long *)malloc(shard_num * sizeof(long));
+    free_list[free_num++] = &pool[i];
+  }
+  
+  int t;
+  double start = now_sec(), cost;
+  unsigned long raw_total = 0;
+  pthread_t tid[thread_num];
+  for (t = 0; t < thread_num; t++)
+  {
+    if (0 != pthread_create(&tid[t], NULL, win_mb > 0 ? work_mmap : work, NULL))
+    {
+      printf("create work thread failed\n");
+      return 1;
+    }
+  }
+  if (win_mb == 0)
+    write_blocks();
+  for (t = 0; t < thread_num; t++)
+    pthread_join(tid[t], NULL);
+  // 文件没有以O_TRUNC打开，截掉上次运行残留的尾部以及O_DIRECT补齐的部分
+  for (total_len = 0, i = 0; i < shard_num; i++)
+  {
+    if (!streams[i].pipe && ftruncate(streams[i].fd, streams[i].offset) < 0)
+      printf("ftruncate %s error, pls check!\n", streams[i].path);
+    if (!streams[i].pipe && fsync(streams[i].fd) < 0)
+      printf("fsync %s error, pls check!\n", streams[i].path);
+    close(streams[i].fd);
+    free(streams[i].stage);
+    total_len += streams[i].offset;
+    raw_total += streams[i].raw;
+  }
+  cost = now_sec() - start;
+  printf("write %ld rows, %lu bytes in %.2fs, %.2f MB/s\n", loop, total_len, cost, total_len / 1048576.0 / cost);
+  if (zip != NULL)
+    printf("%s level %d: %lu raw bytes, ratio %.2f, %.2f MB/s before compression\n", zip->name, zip_level, raw_total, (double)raw_total / total_len, raw_total / 1048576.0 / cost);
+  if (shard_num > 1 && write_manifest(file) < 0)
+    return 1;
+  unlink(ckpt_path);
+  
+  for (i = 0; i < pool_num; i++)
+  {
+    free(pool[i].buf);
+    free(pool[i].zbuf);
+    free(pool[i].sbuf);
+    free(pool[i].seg_off);
+    free(pool[i].seg_len);
+    free(pool[i].seg_raw);
+    free(pool[i].seg_rows);
+  }
+  free(pool);
+  free(free_list);
+  free(ready);
+  free(streams);
+  free(block_shard);
+  free(block_local);
   free(p_all_unit);
-  free(p_row);
-  p_unit = NULL;
   p_all_unit = NULL;
-  p_row = NULL;
+  if (use_schema)
+    schema_free(&sc);
   
   return 0;
 }
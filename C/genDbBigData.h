@@ -0,0 +1,192 @@
+/*
+genDbBigData的公共定义：schema、列生成器、随机数
+*/
+
+#ifndef GEN_DB_BIG_DATA_H
+#define GEN_DB_BIG_DATA_H
+
+#define SEPARATOR ","
+// 列生成器每次生成的行数，每个向量按(seed, 列号, 向量号)独立播种，结果与线程数、块大小无关
+#define VEC_ROWS 1024
+#define COL_NAME_LEN 64
+
+enum col_type
+{
+  COL_SEQ = 0,  // 顺序id：start, start+step, ...
+  COL_INT,      // [min, max]均匀分布的整数
+  COL_STR,      // 定长随机字符串[a-zA-Z0-9]
+  COL_DATE,     // [from, to]均匀分布的日期，内部是距1970-01-01的天数
+  COL_ENUM,     // 按权重取值的枚举，内部是值的下标
+  COL_ZIPF,     // [1, n]上指数为s的Zipf分布
+  COL_FK        // 另一张生成表的seq列上的外键
+};
+
+// int/fk列取值的分布
+enum col_dist
+{
+  DIST_UNIFORM = 0,
+  DIST_ZIPF,    // 取值范围内第k个值的概率正比于1/k^s
+  DIST_NORMAL,  // 截断到[min, max]的正态分布
+  DIST_EXP      // 从min开始、截断到max的指数分布
+};
+
+struct column
+{
+  char name[COL_NAME_LEN];
+  int type;
+  long min;
+  long max;
+  long step;
+  // zipf/fk的取值个数
+  long n;
+  int len;
+  double s;
+  int dist;
+  double mean;
+  double stddev;
+  // 热点：每个值以概率hot取成取值范围内前hot_n个值之一
+  double hot;
+  long hot_n;
+  int enum_num;
+  char **enum_val;
+  // 枚举按权重抽样的别名表：随机取一个桶i，以enum_prob[i]的概率取i，否则取enum_alias[i]
+  double *enum_prob;
+  int *enum_alias;
+  // Zipf拒绝-逆变换采样的预计算量
+  double zipf_hx1;
+  double zipf_hxn;
+  double zipf_s;
+  // 文本格式下的最大宽度
+  int width;
+};
+
+struct schema
+{
+  int col_num;
+  struct column *cols;
+  // 一行文本的最大长度，含分隔符和换行
+  unsigned long max_row_len;
+};
+
+// 一个列向量，字符串列用sval(每个值占len字节)，其余列用ival
+struct col_vec
+{
+  long *ival;
+  char *sval;
+};
+
+/*
+xoshiro256**
+*/
+struct rng
+{
+  unsigned long s[4];
+};
+
+static inline unsigned long rng_rotl(unsigned long x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+static inline unsigned long rng_next(struct rng *r)
+{
+  unsigned long *s = r->s;
+  unsigned long result = rng_rotl(s[1] * 5, 7) * 9;
+  unsigned long t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rng_rotl(s[3], 45);
+  return result;
+}
+
+// [0, range)上的均匀整数，Lemire乘法取高位
+static inline unsigned long rng_range(struct rng *r, unsigned long range)
+{
+  return (unsigned long)(((unsigned __int128)rng_next(r) * range) >> 64);
+}
+
+// [0, 1)上的均匀浮点数
+static inline double rng_double(struct rng *r)
+{
+  return (rng_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void rng_seed(struct rng *r, unsigned long seed, unsigned long a, unsigned long b);
+
+// splitmix64的混合函数，用于按key分片
+static inline unsigned long hash64(unsigned long x)
+{
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+  return x ^ (x >> 31);
+}
+
+int digit(long number);
+int ltoa_lut(long number, char *p_dst);
+
+int schema_load(const char *file, struct schema *sc);
+/*
+seq列的宽度和每行最大长度取决于生成的行数，load之后调用
+*/
+void schema_set_rows(struct schema *sc, long rows);
+void schema_free(struct schema *sc);
+int schema_alloc_vec(const struct schema *sc, struct col_vec *vecs);
+void schema_free_vec(const struct schema *sc, struct col_vec *vecs);
+/*
+生成第first_row行开始的n行(n<=VEC_ROWS，first_row-1必须是VEC_ROWS的整数倍)，每列一个向量
+*/
+void schema_gen(const struct schema *sc, unsigned long seed, long first_row, int n, struct col_vec *vecs);
+/*
+列向量中第i个值的hash，相同的值hash相同
+*/
+unsigned long schema_key_hash(const struct column *col, const struct col_vec *vec, int i);
+/*
+把生成好的n行按文本格式写到p_dst，返回写入长度
+*/
+unsigned long schema_format(const struct schema *sc, const struct col_vec *vecs, int n, char *p_dst);
+
+/*
+块压缩。compress把一块压成一个独立的gzip member/zstd frame/lz4 frame，拼接后标准工具可以直接解压；
+page是parquet页压缩用的裸格式，pq_codec是对应的parquet CompressionCodec。
+*/
+struct compressor
+{
+  const char *name;
+  int pq_codec;
+  int default_level;
+  unsigned long (*bound)(unsigned long len);
+  unsigned long (*compress)(const char *p_src, unsigned long len, char *p_dst, unsigned long cap, int level);
+  unsigned long (*page)(const char *p_src, unsigned long len, char *p_dst, unsigned long cap, int level);
+};
+
+const struct compressor *find_compressor(const char *name);
+
+/*
+输出格式，比如csv、parquet。encode在工作线程里并行调用，把一块行编码到p_buf；
+其余函数在写线程里按块的顺序调用，用于写文件头、记录每块的元数据、写文件尾。
+*/
+struct out_format
+{
+  const char *name;
+  // 一行编码后的最大字节数，以及每块固定的额外开销，用于决定每块的行数
+  unsigned long (*row_bound)(const struct schema *sc, unsigned long *p_extra);
+  // 编码第first_row行开始的rows行，返回长度；*p_meta是交给block_written的块元数据，可以为NULL
+  unsigned long (*encode)(const struct schema *sc, unsigned long seed, long first_row, long rows, char *p_buf, void **p_meta);
+  // 以下可以为NULL。header/footer返回写入*p_buf的长度，*p_buf由调用者free
+  unsigned long (*header)(const struct schema *sc, char **p_buf);
+  // 块已写到文件偏移offset，负责释放meta。*p_state是每个输出文件自己的状态，初始为NULL
+  void (*block_written)(void **p_state, void *meta, unsigned long offset);
+  unsigned long (*footer)(void **p_state, const struct schema *sc, long rows, char **p_buf);
+  // 格式自己在内部做压缩(比如parquet的页压缩)时设置，此时不再整块压缩
+  void (*set_compressor)(const struct compressor *z, int level);
+};
+
+extern const struct out_format csv_format;
+extern const struct out_format parquet_format;
+extern const struct out_format pgbinary_format;
+const struct out_format *find_format(const char *name);
+
+#endif
@@ -0,0 +1,156 @@
+/*
+genDbBigData的块压缩：gzip用zlib；zstd、lz4需要编译时加-DHAVE_ZSTD -lzstd、-DHAVE_LZ4 -llz4。
+每块独立压缩成一个gzip member/zstd frame/lz4 frame，多个块直接拼接，zcat/zstd -d/lz4 -d都能解开。
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#include <lz4frame.h>
+#endif
+#include "genDbBigData.h"
+
+// parquet.thrift中的CompressionCodec
+#define PQ_GZIP 2
+#define PQ_ZSTD 6
+#define PQ_LZ4_RAW 7
+
+#ifndef GZ_CHUNK
+#define GZ_CHUNK UINT_MAX
+#endif
+
+static unsigned long gzip_bound(unsigned long len)
+{
+  // gzip头尾比zlib多12字节
+  return compressBound(len) + 32;
+}
+
+static unsigned long gzip_compress(const char *p_src, unsigned long len, char *p_dst, unsigned long cap, int level)
+{
+  z_stream zs;
+  unsigned long out;
+  int ret = Z_OK;
+  memset(&zs, 0x0, sizeof(zs));
+  // windowBits加16输出gzip格式
+  if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    printf("deflateInit2 error\n");
+    exit(1);
+  }
+  zs.next_in = (unsigned char *)p_src;
+  zs.next_out = (unsigned char *)p_dst;
+  // avail_in/avail_out是32位的uInt，4GB以上的块分段交给deflate
+  while (ret == Z_OK)
+  {
+    if (zs.avail_in == 0)
+    {
+      zs.avail_in = len < GZ_CHUNK ? len : GZ_CHUNK;
+      len -= zs.avail_in;
+    }
+    if (zs.avail_out == 0)
+    {
+      zs.avail_out = cap < GZ_CHUNK ? cap : GZ_CHUNK;
+      cap -= zs.avail_out;
+    }
+    ret = deflate(&zs, len == 0 ? Z_FINISH : Z_NO_FLUSH);
+  }
+  if (ret != Z_STREAM_END)
+  {
+    printf("deflate error\n");
+    exit(1);
+  }
+  out = zs.total_out;
+  deflateEnd(&zs);
+  return out;
+}
+
+#ifdef HAVE_ZSTD
+static unsigned long zstd_bound(unsigned long len)
+{
+  return ZSTD_compressBound(len);
+}
+
+static unsigned long zstd_compress(const char *p_src, unsigned long len, char *p_dst, unsigned long cap, int level)
+{
+  // 每个线程复用一个压缩上下文
+  static __thread ZSTD_CCtx *cctx = NULL;
+  size_t ret;
+  if (cctx == NULL && (cctx = ZSTD_createCCtx()) == NULL)
+  {
+    printf("ZSTD_createCCtx error\n");
+    exit(1);
+  }
+  ret = ZSTD_compressCCtx(cctx, p_dst, cap, p_src, len, level);
+  if (ZSTD_isError(ret))
+  {
+    printf("zstd compress error: %s\n", ZSTD_getErrorName(ret));
+    exit(1);
+  }
+  return ret;
+}
+#endif
+
+#ifdef HAVE_LZ4
+static unsigned long lz4_bound(unsigned long len)
+{
+  unsigned long frame = LZ4F_compressFrameBound(len, NULL);
+  unsigned long raw = LZ4_compressBound(len);
+  return frame > raw ? frame : raw;
+}
+
+static unsigned long lz4_compress(const char *p_src, unsigned long len, char *p_dst, unsigned long cap, int level)
+{
+  LZ4F_preferences_t prefs;
+  size_t ret;
+  memset(&prefs, 0x0, sizeof(prefs));
+  prefs.compressionLevel = level;
+  prefs.frameInfo.contentSize = len;
+  ret = LZ4F_compressFrame(p_dst, cap, p_src, len, &prefs);
+  if (LZ4F_isError(ret))
+  {
+    printf("lz4 compress error: %s\n", LZ4F_getErrorName(ret));
+    exit(1);
+  }
+  return ret;
+}
+
+static unsigned long lz4_page(const char *p_src, unsigned long len, char *p_dst, unsigned long cap, int level)
+{
+  int ret = LZ4_compress_default(p_src, p_dst, len, cap);
+  if (ret <= 0)
+  {
+    printf("lz4 compress error\n");
+    exit(1);
+  }
+  return ret;
+}
+#endif
+
+static const struct compressor compressors[] =
+{
+  { "gzip", PQ_GZIP, 6, gzip_bound, gzip_compress, gzip_compress },
+#ifdef HAVE_ZSTD
+  { "zstd", PQ_ZSTD, 3, zstd_bound, zstd_compress, zstd_compress },
+#endif
+#ifdef HAVE_LZ4
+  { "lz4", PQ_LZ4_RAW, 0, lz4_bound, lz4_compress, lz4_page },
+#endif
+};
+
+const struct compressor *find_compressor(const char *name)
+{
+  int i;
+  for (i = 0; i < sizeof(compressors) / sizeof(compressors[0]); i++)
+  {
+    if (strcmp(compressors[i].name, name) == 0)
+      return &compressors[i];
+  }
+  return NULL;
+}
@@ -0,0 +1,708 @@
+/*
+genDbBigData的parquet输出格式，不依赖arrow/thrift，直接按parquet规范写文件：
+每块是一个row group，每列一个column chunk、一个数据页，所有列都是REQUIRED。
+编码：seq列DELTA_BINARY_PACKED，enum列字典页+RLE_DICTIONARY(下标用RLE/bit-packed混合编码)，其余列PLAIN。
+每个column chunk都带min/max统计，hive、spark、arrow可以直接读，并按统计跳过row group。
+指定-z时按页压缩(GZIP/ZSTD/LZ4_RAW)，文件本身仍是合法的parquet。
+页头和文件尾的FileMetaData用thrift compact protocol编码。
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "genDbBigData.h"
+
+// parquet.thrift中的枚举值
+#define PQ_INT32 1
+#define PQ_INT64 2
+#define PQ_BYTE_ARRAY 6
+#define PQ_REQUIRED 0
+#define PQ_UTF8 0
+#define PQ_DATE 6
+#define PQ_PLAIN 0
+#define PQ_RLE 3
+#define PQ_DELTA_BINARY_PACKED 5
+#define PQ_RLE_DICTIONARY 8
+#define PQ_DATA_PAGE 0
+#define PQ_DICTIONARY_PAGE 2
+#define PQ_UNCOMPRESSED 0
+
+// thrift compact protocol的类型
+#define TC_I32 5
+#define TC_I64 6
+#define TC_BINARY 8
+#define TC_LIST 9
+#define TC_STRUCT 12
+
+#define TC_MAX_DEPTH 16
+// 一个bit-packed段最多63组，段头正好一个字节
+#define PQ_MAX_GROUPS 63
+
+struct pq_buf
+{
+  unsigned char *p;
+  unsigned long len;
+  unsigned long cap;
+};
+
+struct pq_col_meta
+{
+  long dict_off;
+  long data_off;
+  long size;
+  long raw_size;
+  int enc[2];
+  int enc_num;
+  unsigned char *min;
+  unsigned char *max;
+  int min_len;
+  int max_len;
+};
+
+struct pq_block_meta
+{
+  long rows;
+  unsigned long offset;
+  int col_num;
+  struct pq_col_meta cols[];
+};
+
+// 每个输出文件在写线程里累积的row group元数据，写文件尾时用
+struct pq_file
+{
+  struct pq_block_meta **row_groups;
+  long row_group_num;
+  long row_group_cap;
+};
+// 页压缩，NULL表示不压缩
+static const struct compressor *pq_codec = NULL;
+static int pq_level = 0;
+
+static void pb_reserve(struct pq_buf *b, unsigned long n)
+{
+  if (b->len + n <= b->cap)
+    return;
+  while (b->len + n > b->cap)
+    b->cap = b->cap ? b->cap * 2 : 4096;
+  if ((b->p = (unsigned char *)realloc(b->p, b->cap)) == NULL)
+  {
+    printf("malloc parquet buffer error\n");
+    exit(1);
+  }
+}
+
+static void pb_put(struct pq_buf *b, const void *src, unsigned long n)
+{
+  pb_reserve(b, n);
+  memcpy(b->p + b->len, src, n);
+  b->len += n;
+}
+
+static void pb_byte(struct pq_buf *b, unsigned char c)
+{
+  pb_reserve(b, 1);
+  b->p[b->len++] = c;
+}
+
+static void pb_varint(struct pq_buf *b, unsigned long v)
+{
+  while (v >= 0x80)
+  {
+    pb_byte(b, (v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  pb_byte(b, v);
+}
+
+static void pb_le(struct pq_buf *b, unsigned long v, int bytes)
+{
+  int i;
+  pb_reserve(b, bytes);
+  for (i = 0; i < bytes; i++)
+    b->p[b->len++] = v >> (8 * i);
+}
+
+static unsigned long zigzag(long v)
+{
+  return ((unsigned long)v << 1) ^ (unsigned long)(v >> 63);
+}
+
+/*
+LSB优先的bit packing，count*w必须是8的倍数
+*/
+static void pb_pack(struct pq_buf *b, const unsigned long *v, int count, int w)
+{
+  unsigned __int128 acc = 0;
+  int bits = 0, i;
+  pb_reserve(b, (unsigned long)count * w / 8 + 1);
+  for (i = 0; i < count; i++)
+  {
+    acc |= (unsigned __int128)v[i] << bits;
+    bits += w;
+    while (bits >= 8)
+    {
+      b->p[b->len++] = (unsigned char)acc;
+      acc >>= 8;
+      bits -= 8;
+    }
+  }
+  if (bits > 0)
+    b->p[b->len++] = (unsigned char)acc;
+}
+
+static int bit_width(unsigned long v)
+{
+  return v == 0 ? 0 : 64 - __builtin_clzl(v);
+}
+
+/*
+thrift compact protocol，字段头用与上一个字段id的差值编码
+*/
+struct tc
+{
+  struct pq_buf *b;
+  short last[TC_MAX_DEPTH];
+  int depth;
+};
+
+static void tc_field(struct tc *t, short id, int type)
+{
+  short delta = id - t->last[t->depth];
+  if (delta > 0 && delta <= 15)
+    pb_byte(t->b, (delta << 4) | type);
+  else
+  {
+    pb_byte(t->b, type);
+    pb_varint(t->b, zigzag(id));
+  }
+  t->last[t->depth] = id;
+}
+
+static void tc_i32(struct tc *t, short id, int v)
+{
+  tc_field(t, id, TC_I32);
+  pb_varint(t->b, zigzag(v));
+}
+
+static void tc_i64(struct tc *t, short id, long v)
+{
+  tc_field(t, id, TC_I64);
+  pb_varint(t->b, zigzag(v));
+}
+
+static void tc_bin(struct tc *t, short id, const void *p, int n)
+{
+  tc_field(t, id, TC_BINARY);
+  pb_varint(t->b, n);
+  pb_put(t->b, p, n);
+}
+
+static void tc_list(struct tc *t, short id, int elem_type, int size)
+{
+  tc_field(t, id, TC_LIST);
+  if (size < 15)
+    pb_byte(t->b, (size << 4) | elem_type);
+  else
+  {
+    pb_byte(t->b, 0xf0 | elem_type);
+    pb_varint(t->b, size);
+  }
+}
+
+// 结构体开始：字段形式(id>0)或者列表元素(id==0)
+static void tc_begin(struct tc *t, short id)
+{
+  if (id > 0)
+    tc_field(t, id, TC_STRUCT);
+  t->last[++t->depth] = 0;
+}
+
+static void tc_end(struct tc *t)
+{
+  pb_byte(t->b, 0);
+  t->depth--;
+}
+
+static int pq_type(const struct column *col)
+{
+  switch (col->type)
+  {
+    case COL_STR:
+    case COL_ENUM:
+      return PQ_BYTE_ARRAY;
+    case COL_DATE:
+      return PQ_INT32;
+    default:
+      return PQ_INT64;
+  }
+}
+
+/*
+DELTA_BINARY_PACKED：每块128个差值、4个miniblock，差值减去块内最小差值后按miniblock的位宽打包
+*/
+static void pq_delta(struct pq_buf *b, const long *v, long n)
+{
+  unsigned long d[128], max;
+  long i = 1, min_d;
+  int cnt, k, m, w[4];
+  pb_varint(b, 128);
+  pb_varint(b, 4);
+  pb_varint(b, n);
+  pb_varint(b, zigzag(v[0]));
+  while (i < n)
+  {
+    cnt = n - i < 128 ? n - i : 128;
+    min_d = LONG_MAX;
+    for (k = 0; k < cnt; k++)
+    {
+      if (v[i + k] - v[i + k - 1] < min_d)
+        min_d = v[i + k] - v[i + k - 1];
+    }
+    pb_varint(b, zigzag(min_d));
+    for (k = 0; k < 128; k++)
+      d[k] = k < cnt ? (unsigned long)(v[i + k] - v[i + k - 1] - min_d) : 0;
+    for (m = 0; m < 4; m++)
+    {
+      for (max = 0, k = m * 32; k < m * 32 + 32; k++)
+        max |= d[k];
+      w[m] = m * 32 < cnt ? bit_width(max) : 0;
+      pb_byte(b, w[m]);
+    }
+    // 最后一块里用不到的miniblock只写位宽，不写数据
+    for (m = 0; m < 4 && m * 32 < cnt; m++)
+      pb_pack(b, d + m * 32, 32, w[m]);
+    i += cnt;
+  }
+}
+
+static void pq_flush_packed(struct pq_buf *b, const long *v, long n, long start, long end, int bw)
+{
+  unsigned long g[8];
+  long k;
+  int j;
+  if (start >= end)
+    return;
+  pb_varint(b, ((end - start) / 8) << 1 | 1);
+  for (k = start; k < end; k += 8)
+  {
+    for (j = 0; j < 8; j++)
+      g[j] = k + j < n ? v[k + j] : 0;
+    pb_pack(b, g, 8, bw);
+  }
+}
+
+/*
+RLE/bit-packed混合编码：连续8个以上相同的值用RLE段，其余按8个一组bit-pack
+*/
+static void pq_hybrid(struct pq_buf *b, const long *v, long n, int bw)
+{
+  long i = 0, j, start = 0;
+  int k;
+  while (i < n)
+  {
+    if (i + 8 <= n)
+    {
+      for (k = 1; k < 8 && v[i + k] == v[i]; k++)
+        ;
+      if (k == 8)
+      {
+        for (j = i + 8; j < n && v[j] == v[i]; j++)
+          ;
+        pq_flush_packed(b, v, n, start, i, bw);
+        pb_varint(b, (unsigned long)(j - i) << 1);
+        pb_le(b, v[i], (bw + 7) / 8);
+        i = start = j;
+        continue;
+      }
+    }
+    i += 8;
+    if (i - start == PQ_MAX_GROUPS * 8)
+    {
+      pq_flush_packed(b, v, n, start, i, bw);
+      start = i;
+    }
+  }
+  pq_flush_packed(b, v, n, start, i, bw);
+}
+
+static void pq_page_header(struct pq_buf *b, int type, unsigned long raw_size, unsigned long size, long num_values, int encoding)
+{
+  struct tc t;
+  memset(&t, 0x0, sizeof(t));
+  t.b = b;
+  tc_i32(&t, 1, type);
+  tc_i32(&t, 2, raw_size);
+  tc_i32(&t, 3, size);
+  if (type == PQ_DATA_PAGE)
+  {
+    tc_begin(&t, 5);
+    tc_i32(&t, 1, num_values);
+    tc_i32(&t, 2, encoding);
+    tc_i32(&t, 3, PQ_RLE);
+    tc_i32(&t, 4, PQ_RLE);
+    tc_end(&t);
+  }
+  else
+  {
+    tc_begin(&t, 7);
+    tc_i32(&t, 1, num_values);
+    tc_i32(&t, 2, encoding);
+    tc_end(&t);
+  }
+  pb_byte(b, 0);
+}
+
+/*
+页头加页数据写到out，按需压缩，同时累计column chunk压缩前的大小
+*/
+static void pq_put_page(struct pq_buf *out, int type, struct pq_buf *page, long num_values, int encoding, struct pq_col_meta *cm)
+{
+  unsigned long start = out->len, size;
+  char *p_zip;
+  if (pq_codec == NULL)
+  {
+    pq_page_header(out, type, page->len, page->len, num_values, encoding);
+    pb_put(out, page->p, page->len);
+    cm->raw_size += out->len - start;
+    return;
+  }
+  p_zip = (char *)malloc(pq_codec->bound(page->len));
+  size = pq_codec->page((char *)page->p, page->len, p_zip, pq_codec->bound(page->len), pq_level);
+  pq_page_header(out, type, page->len, size, num_values, encoding);
+  cm->raw_size += out->len - start + page->len;
+  pb_put(out, p_zip, size);
+  free(p_zip);
+}
+
+static void set_stat(unsigned char **p_dst, int *p_len, const void *src, int len)
+{
+  *p_dst = (unsigned char *)malloc(len > 0 ? len : 1);
+  memcpy(*p_dst, src, len);
+  *p_len = len;
+}
+
+static int bytes_cmp(const void *a, int a_len, const void *b, int b_len)
+{
+  int r = memcmp(a, b, a_len < b_len ? a_len : b_len);
+  return r != 0 ? r : a_len - b_len;
+}
+
+static unsigned long pq_row_bound(const struct schema *sc, unsigned long *p_extra)
+{
+  unsigned long bound = 0;
+  int c, i;
+  *p_extra = 0;
+  for (c = 0; c < sc->col_num; c++)
+  {
+    // 每列的页头和统计
+    *p_extra += 256 + 2 * sc->cols[c].width;
+    switch (sc->cols[c].type)
+    {
+      case COL_STR:
+        bound += 4 + sc->cols[c].len;
+        break;
+      case COL_DATE:
+        bound += 4;
+        break;
+      case COL_ENUM:
+        // 下标最多16位，RLE段头按每8个值10字节估算
+        bound += 4;
+        for (i = 0; i < sc->cols[c].enum_num; i++)
+          *p_extra += 4 + strlen(sc->cols[c].enum_val[i]);
+        break;
+      default:
+        // 差值打包最坏每个值8字节，外加每128个值的块头
+        bound += 9;
+        break;
+    }
+  }
+  // 压缩后可能比原始数据略大
+  if (pq_codec != NULL)
+  {
+    *p_extra += sc->col_num * 1024;
+    bound += bound / 64 + 1;
+  }
+  return bound;
+}
+
+static unsigned long pq_encode(const struct schema *sc, unsigned long seed, long first_row, long rows, char *p_buf, void **p_meta)
+{
+  struct col_vec vecs[sc->col_num];
+  struct pq_buf page[sc->col_num], out;
+  long *vals[sc->col_num];
+  struct pq_block_meta *meta;
+  struct pq_col_meta *cm;
+  const struct column *col;
+  const char *s;
+  char *seen;
+  long i, k, min, max;
+  int c, n, bw, len, min_i, max_i;
+
+  if (schema_alloc_vec(sc, vecs) < 0)
+  {
+    printf("malloc column vector error\n");
+    exit(1);
+  }
+  meta = (struct pq_block_meta *)calloc(1, sizeof(struct pq_block_meta) + sc->col_num * sizeof(struct pq_col_meta));
+  meta->rows = rows;
+  meta->col_num = sc->col_num;
+  memset(page, 0x0, sizeof(page));
+  for (c = 0; c < sc->col_num; c++)
+    vals[c] = sc->cols[c].type == COL_STR ? NULL : (long *)malloc(rows * sizeof(long));
+
+  // 先按向量生成整块的值，字符串列直接写PLAIN
+  for (i = 0; i < rows; i += VEC_ROWS)
+  {
+    n = rows - i < VEC_ROWS ? rows - i : VEC_ROWS;
+    schema_gen(sc, seed, first_row + i, n, vecs);
+    for (c = 0; c < sc->col_num; c++)
+    {
+      col = &sc->cols[c];
+      cm = &meta->cols[c];
+      if (col->type != COL_STR)
+      {
+        memcpy(vals[c] + i, vecs[c].ival, n * sizeof(long));
+        continue;
+      }
+      for (k = 0; k < n; k++)
+      {
+        s = vecs[c].sval + k * col->len;
+        pb_le(&page[c], col->len, 4);
+        pb_put(&page[c], s, col->len);
+        if (cm->min == NULL || memcmp(s, cm->min, col->len) < 0)
+        {
+          free(cm->min);
+          set_stat(&cm->min, &cm->min_len, s, col->len);
+        }
+        if (cm->max == NULL || memcmp(s, cm->max, col->len) > 0)
+        {
+          free(cm->max);
+          set_stat(&cm->max, &cm->max_len, s, col->len);
+        }
+      }
+    }
+  }
+  schema_free_vec(sc, vecs);
+
+  memset(&out, 0x0, sizeof(out));
+  out.p = (unsigned char *)p_buf;
+  out.cap = ~0UL;
+  for (c = 0; c < sc->col_num; c++)
+  {
+    col = &sc->cols[c];
+    cm = &meta->cols[c];
+    cm->dict_off = -1;
+    cm->data_off = out.len;
+    cm->enc[0] = PQ_PLAIN;
+    cm->enc_num = 1;
+    if (col->type != COL_STR && col->type != COL_ENUM)
+    {
+      for (min = max = vals[c][0], i = 1; i < rows; i++)
+      {
+        if (vals[c][i] < min)
+          min = vals[c][i];
+        if (vals[c][i] > max)
+          max = vals[c][i];
+      }
+      set_stat(&cm->min, &cm->min_len, &min, col->type == COL_DATE ? 4 : 8);
+      set_stat(&cm->max, &cm->max_len, &max, col->type == COL_DATE ? 4 : 8);
+    }
+    switch (col->type)
+    {
+      case COL_STR:
+        break;
+      case COL_SEQ:
+        pq_delta(&page[c], vals[c], rows);
+        cm->enc[0] = PQ_DELTA_BINARY_PACKED;
+        break;
+      case COL_DATE:
+        for (i = 0; i < rows; i++)
+          pb_le(&page[c], vals[c][i], 4);
+        break;
+      case COL_ENUM:
+        // 字典页，统计取块内出现过的值里字典序最小、最大的
+        seen = (char *)calloc(col->enum_num, 1);
+        for (i = 0; i < rows; i++)
+          seen[vals[c][i]] = 1;
+        for (min_i = max_i = -1, k = 0; k < col->enum_num; k++)
+        {
+          len = strlen(col->enum_val[k]);
+          pb_le(&page[c], len, 4);
+          pb_put(&page[c], col->enum_val[k], len);
+          if (!seen[k])
+            continue;
+          if (min_i < 0 || bytes_cmp(col->enum_val[k], len, col->enum_val[min_i], strlen(col->enum_val[min_i])) < 0)
+            min_i = k;
+          if (max_i < 0 || bytes_cmp(col->enum_val[k], len, col->enum_val[max_i], strlen(col->enum_val[max_i])) > 0)
+            max_i = k;
+        }
+        free(seen);
+        set_stat(&cm->min, &cm->min_len, col->enum_val[min_i], strlen(col->enum_val[min_i]));
+        set_stat(&cm->max, &cm->max_len, col->enum_val[max_i], strlen(col->enum_val[max_i]));
+        cm->dict_off = out.len;
+        pq_put_page(&out, PQ_DICTIONARY_PAGE, &page[c], col->enum_num, PQ_PLAIN, cm);
+        page[c].len = 0;
+        cm->data_off = out.len;
+        bw = bit_width(col->enum_num - 1);
+        if (bw == 0)
+          bw = 1;
+        pb_byte(&page[c], bw);
+        pq_hybrid(&page[c], vals[c], rows, bw);
+        cm->enc[1] = PQ_RLE_DICTIONARY;
+        cm->enc_num = 2;
+        break;
+      default:
+        for (i = 0; i < rows; i++)
+          pb_le(&page[c], vals[c][i], 8);
+        break;
+    }
+    pq_put_page(&out, PQ_DATA_PAGE, &page[c], rows, cm->enc[cm->enc_num - 1], cm);
+    cm->size = out.len - (cm->dict_off >= 0 ? cm->dict_off : cm->data_off);
+    free(page[c].p);
+    free(vals[c]);
+  }
+  *p_meta = meta;
+  return out.len;
+}
+
+static unsigned long pq_header(const struct schema *sc, char **p_buf)
+{
+  *p_buf = strdup("PAR1");
+  return 4;
+}
+
+static void pq_block_written(void **p_state, void *meta, unsigned long offset)
+{
+  struct pq_block_meta *m = (struct pq_block_meta *)meta;
+  struct pq_file *f = (struct pq_file *)*p_state;
+  if (f == NULL)
+    *p_state = f = (struct pq_file *)calloc(1, sizeof(struct pq_file));
+  m->offset = offset;
+  if (f->row_group_num == f->row_group_cap)
+  {
+    f->row_group_cap = f->row_group_cap ? f->row_group_cap * 2 : 64;
+    f->row_groups = (struct pq_block_meta **)realloc(f->row_groups, f->row_group_cap * sizeof(struct pq_block_meta *));
+  }
+  f->row_groups[f->row_group_num++] = m;
+}
+
+static unsigned long pq_footer(void **p_state, const struct schema *sc, long rows, char **p_buf)
+{
+  struct pq_file empty, *f = *p_state != NULL ? (struct pq_file *)*p_state : &empty;
+  struct pq_buf b;
+  struct tc t;
+  struct pq_block_meta *m;
+  struct pq_col_meta *cm;
+  const struct column *col;
+  long g, total;
+  int c, e;
+  memset(&b, 0x0, sizeof(b));
+  memset(&t, 0x0, sizeof(t));
+  memset(&empty, 0x0, sizeof(empty));
+  t.b = &b;
+
+  tc_i32(&t, 1, 1);
+  tc_list(&t, 2, TC_STRUCT, sc->col_num + 1);
+  tc_begin(&t, 0);
+  tc_bin(&t, 4, "schema", 6);
+  tc_i32(&t, 5, sc->col_num);
+  tc_end(&t);
+  for (c = 0; c < sc->col_num; c++)
+  {
+    col = &sc->cols[c];
+    tc_begin(&t, 0);
+    tc_i32(&t, 1, pq_type(col));
+    tc_i32(&t, 3, PQ_REQUIRED);
+    tc_bin(&t, 4, col->name, strlen(col->name));
+    if (col->type == COL_STR || col->type == COL_ENUM)
+      tc_i32(&t, 6, PQ_UTF8);
+    else if (col->type == COL_DATE)
+      tc_i32(&t, 6, PQ_DATE);
+    tc_end(&t);
+  }
+  tc_i64(&t, 3, rows);
+  tc_list(&t, 4, TC_STRUCT, f->row_group_num);
+  for (g = 0; g < f->row_group_num; g++)
+  {
+    m = f->row_groups[g];
+    tc_begin(&t, 0);
+    tc_list(&t, 1, TC_STRUCT, m->col_num);
+    for (total = 0, c = 0; c < m->col_num; c++)
+    {
+      cm = &m->cols[c];
+      col = &sc->cols[c];
+      total += cm->raw_size;
+      tc_begin(&t, 0);
+      tc_i64(&t, 2, m->offset + (cm->dict_off >= 0 ? cm->dict_off : cm->data_off));
+      tc_begin(&t, 3);
+      tc_i32(&t, 1, pq_type(col));
+      tc_list(&t, 2, TC_I32, cm->enc_num);
+      for (e = 0; e < cm->enc_num; e++)
+        pb_varint(&b, zigzag(cm->enc[e]));
+      tc_list(&t, 3, TC_BINARY, 1);
+      pb_varint(&b, strlen(col->name));
+      pb_put(&b, col->name, strlen(col->name));
+      tc_i32(&t, 4, pq_codec != NULL ? pq_codec->pq_codec : PQ_UNCOMPRESSED);
+      tc_i64(&t, 5, m->rows);
+      tc_i64(&t, 6, cm->raw_size);
+      tc_i64(&t, 7, cm->size);
+      tc_i64(&t, 9, m->offset + cm->data_off);
+      if (cm->dict_off >= 0)
+        tc_i64(&t, 11, m->offset + cm->dict_off);
+      tc_begin(&t, 12);
+      tc_i64(&t, 3, 0);
+      tc_bin(&t, 5, cm->max, cm->max_len);
+      tc_bin(&t, 6, cm->min, cm->min_len);
+      tc_end(&t);
+      tc_end(&t);
+      tc_end(&t);
+      free(cm->min);
+      free(cm->max);
+    }
+    tc_i64(&t, 2, total);
+    tc_i64(&t, 3, m->rows);
+    tc_end(&t);
+    free(m);
+  }
+  tc_bin(&t, 6, "genDbBigData", 12);
+  // column_orders，声明min_value/max_value按类型定义的顺序比较，否则读者会忽略统计
+  tc_list(&t, 7, TC_STRUCT, sc->col_num);
+  for (c = 0; c < sc->col_num; c++)
+  {
+    tc_begin(&t, 0);
+    tc_begin(&t, 1);
+    tc_end(&t);
+    tc_end(&t);
+  }
+  pb_byte(&b, 0);
+
+  total = b.len;
+  pb_le(&b, total, 4);
+  pb_put(&b, "PAR1", 4);
+  if (f != &empty)
+  {
+    free(f->row_groups);
+    free(f);
+    *p_state = NULL;
+  }
+  *p_buf = (char *)b.p;
+  return b.len;
+}
+
+static void pq_set_compressor(const struct compressor *z, int level)
+{
+  pq_codec = z;
+  pq_level = level;
+}
+
+const struct out_format parquet_format =
+{
+  .name = "parquet",
+  .row_bound = pq_row_bound,
+  .encode = pq_encode,
+  .header = pq_header,
+  .block_written = pq_block_written,
+  .footer = pq_footer,
+  .set_compressor = pq_set_compressor,
+};
@@ -0,0 +1,778 @@
+/*
+genDbBigData的schema解析和列生成器。
+schema文件每行定义一列：列名 类型 参数...，#开头为注释，例如：
+  id      seq   start=1 step=1
+  age     int   min=18 max=90
+  name    str   len=12
+  birth   date  from=1950-01-01 to=2005-12-31
+  level   enum  values=gold:1,silver:3,bronze:6
+  user_id zipf  n=1000000 s=1.1
+  order   fk    ref=orders.schema:id rows=1000000
+fk引用另一个schema文件中的seq列(相对路径相对于当前schema文件所在目录)，rows是那张表生成的行数，
+取值均匀落在被引用表已有的key上，两张表可以直接join。
+int和fk列可以用dist=指定分布，用于复现join/分区时的数据倾斜：
+  score   int   min=0 max=100 dist=normal mean=60 stddev=15
+  wait    int   min=0 max=3600 dist=exp mean=30
+  shop    int   min=1 max=50000 dist=zipf s=1.2
+  order   fk    ref=orders.schema:id rows=1000000 dist=zipf s=0.9
+int/zipf/fk列还可以加hot=p:k，每个值以概率p换成取值范围里前k个值之一(fk是被引用表的前k个key)。
+枚举用别名表抽样，zipf用拒绝-逆变换，正态按范围宽窄用Marsaglia极坐标法或均匀提议的拒绝采样，
+截断的指数直接逆变换，每个值都是O(1)的期望开销。
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "genDbBigData.h"
+
+#define LINE_LEN 4096
+#define MAX_REF_DEPTH 8
+
+static unsigned long splitmix64(unsigned long *x)
+{
+  unsigned long z = (*x += 0x9e3779b97f4a7c15UL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+  return z ^ (z >> 31);
+}
+
+void rng_seed(struct rng *r, unsigned long seed, unsigned long a, unsigned long b)
+{
+  unsigned long x = seed ^ (a * 0xd1b54a32d192ed03UL) ^ (b * 0x8cb92ba72f3d8dd7UL);
+  int i;
+  for (i = 0; i < 4; i++)
+    r->s[i] = splitmix64(&x);
+}
+
+/*
+公历日期与距1970-01-01天数的互相转换
+*/
+static long days_from_civil(long y, int m, int d)
+{
+  y -= m <= 2;
+  long era = (y >= 0 ? y : y - 399) / 400;
+  long yoe = y - era * 400;
+  long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+static void civil_from_days(long z, long *y, int *m, int *d)
+{
+  z += 719468;
+  long era = (z >= 0 ? z : z - 146096) / 146097;
+  long doe = z - era * 146097;
+  long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  long mp = (5 * doy + 2) / 153;
+  *d = doy - (153 * mp + 2) / 5 + 1;
+  *m = mp < 10 ? mp + 3 : mp - 9;
+  *y = yoe + era * 400 + (*m <= 2);
+}
+
+static int parse_date(const char *str, long *days)
+{
+  int y, m, d;
+  if (sscanf(str, "%d-%d-%d", &y, &m, &d) != 3 || m < 1 || m > 12 || d < 1 || d > 31)
+    return -1;
+  *days = days_from_civil(y, m, d);
+  return 0;
+}
+
+/*
+Zipf分布的拒绝-逆变换采样(Hörmann & Derflinger)，不需要O(n)的累积分布表
+*/
+static double zipf_helper1(double x)
+{
+  return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+static double zipf_helper2(double x)
+{
+  return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+}
+
+static double zipf_h(double s, double x)
+{
+  return exp(-s * log(x));
+}
+
+static double zipf_hint(double s, double x)
+{
+  double log_x = log(x);
+  return zipf_helper2((1 - s) * log_x) * log_x;
+}
+
+static double zipf_hint_inv(double s, double x)
+{
+  double t = x * (1 - s);
+  if (t < -1)
+    t = -1;
+  return exp(zipf_helper1(t) * x);
+}
+
+static void zipf_init(struct column *col)
+{
+  col->zipf_hx1 = zipf_hint(col->s, 1.5) - 1;
+  col->zipf_hxn = zipf_hint(col->s, col->n + 0.5);
+  col->zipf_s = 2 - zipf_hint_inv(col->s, zipf_hint(col->s, 2.5) - zipf_h(col->s, 2));
+}
+
+static long zipf_sample(const struct column *col, struct rng *r)
+{
+  double u, x;
+  long k;
+  for (;;)
+  {
+    u = col->zipf_hxn + rng_double(r) * (col->zipf_hx1 - col->zipf_hxn);
+    x = zipf_hint_inv(col->s, u);
+    k = (long)(x + 0.5);
+    if (k < 1)
+      k = 1;
+    else if (k > col->n)
+      k = col->n;
+    if (k - x <= col->zipf_s || u >= zipf_hint(col->s, k + 0.5) - zipf_h(col->s, k))
+      return k;
+  }
+}
+
+/*
+Vose别名表：权重按均值归一后，不足1的桶用一个超过1的桶补满，补剩的再放回去
+*/
+static void alias_init(double *prob, int *alias, int n, double sum)
+{
+  int small[n], large[n];
+  int ns = 0, nl = 0, i, s, l;
+  for (i = 0; i < n; i++)
+  {
+    prob[i] = prob[i] * n / sum;
+    alias[i] = i;
+    if (prob[i] < 1.0)
+      small[ns++] = i;
+    else
+      large[nl++] = i;
+  }
+  while (ns > 0 && nl > 0)
+  {
+    s = small[--ns];
+    l = large[nl - 1];
+    alias[s] = l;
+    prob[l] -= 1.0 - prob[s];
+    if (prob[l] < 1.0)
+    {
+      nl--;
+      small[ns++] = l;
+    }
+  }
+  // 浮点误差剩下的桶概率都是1
+  while (nl > 0)
+    prob[large[--nl]] = 1.0;
+  while (ns > 0)
+    prob[small[--ns]] = 1.0;
+}
+
+static int parse_enum(struct column *col, char *values)
+{
+  char *save = NULL, *item, *colon;
+  double sum = 0;
+  int i, len;
+  col->enum_num = 1;
+  for (item = values; *item; item++)
+    if (*item == ',')
+      col->enum_num++;
+  col->enum_val = (char **)calloc(col->enum_num, sizeof(char *));
+  col->enum_prob = (double *)calloc(col->enum_num, sizeof(double));
+  col->enum_alias = (int *)calloc(col->enum_num, sizeof(int));
+  for (i = 0, item = strtok_r(values, ",", &save); item != NULL; i++, item = strtok_r(NULL, ",", &save))
+  {
+    colon = strrchr(item, ':');
+    if (colon != NULL)
+      *colon = '\0';
+    col->enum_val[i] = strdup(item);
+    col->enum_prob[i] = colon != NULL ? atof(colon + 1) : 1.0;
+    if (col->enum_prob[i] < 0)
+      return -1;
+    sum += col->enum_prob[i];
+    len = strlen(item);
+    if (len > col->width)
+      col->width = len;
+  }
+  col->enum_num = i;
+  if (i == 0 || sum <= 0)
+    return -1;
+  alias_init(col->enum_prob, col->enum_alias, col->enum_num, sum);
+  return 0;
+}
+
+static int schema_load_depth(const char *file, struct schema *sc, int depth);
+
+/*
+解析fk的ref=文件:列，取被引用列的start和step
+*/
+static int parse_ref(struct column *col, const char *schema_file, const char *ref, int depth)
+{
+  char path[LINE_LEN];
+  const char *colon = strrchr(ref, ':'), *slash;
+  struct schema ref_sc;
+  int i, ret = -1;
+  if (colon == NULL || depth >= MAX_REF_DEPTH)
+    return -1;
+  slash = strrchr(schema_file, '/');
+  if (ref[0] != '/' && slash != NULL)
+    snprintf(path, sizeof(path), "%.*s/%.*s", (int)(slash - schema_file), schema_file, (int)(colon - ref), ref);
+  else
+    snprintf(path, sizeof(path), "%.*s", (int)(colon - ref), ref);
+  if (schema_load_depth(path, &ref_sc, depth + 1) < 0)
+    return -1;
+  for (i = 0; i < ref_sc.col_num; i++)
+  {
+    if (strcmp(ref_sc.cols[i].name, colon + 1) == 0 && ref_sc.cols[i].type == COL_SEQ)
+    {
+      col->min = ref_sc.cols[i].min;
+      col->step = ref_sc.cols[i].step;
+      ret = 0;
+      break;
+    }
+  }
+  if (ret < 0)
+    printf("fk ref %s: no seq column named %s\n", path, colon + 1);
+  schema_free(&ref_sc);
+  return ret;
+}
+
+static int num_width(long v)
+{
+  return v < 0 ? digit(-v) + 1 : (v == 0 ? 1 : digit(v));
+}
+
+/*
+检查dist和hot参数，int列的zipf在[min, max]上取，fk列的zipf在被引用表的rows个key上取
+*/
+static int check_dist(struct column *col)
+{
+  if (col->dist != DIST_UNIFORM && col->type != COL_INT && !(col->type == COL_FK && col->dist == DIST_ZIPF))
+  {
+    printf("column %s: dist only works with int columns, and zipf with fk columns\n", col->name);
+    return -1;
+  }
+  if (col->hot > 0 && col->type != COL_INT && col->type != COL_ZIPF && col->type != COL_FK)
+  {
+    printf("column %s: hot only works with int, zipf and fk columns\n", col->name);
+    return -1;
+  }
+  if (col->type == COL_INT)
+    col->n = col->max - col->min + 1;
+  if (col->hot_n > col->n)
+    col->hot_n = col->n;
+  switch (col->dist)
+  {
+    case DIST_ZIPF:
+      if (col->s <= 0)
+      {
+        printf("column %s: s must greater than 0\n", col->name);
+        return -1;
+      }
+      zipf_init(col);
+      break;
+    case DIST_NORMAL:
+      if (isnan(col->mean))
+        col->mean = (col->min + col->max) / 2.0;
+      if (col->stddev <= 0 || col->mean < col->min || col->mean > col->max)
+      {
+        printf("column %s: normal needs stddev > 0 and mean in [min, max]\n", col->name);
+        return -1;
+      }
+      break;
+    case DIST_EXP:
+      if (!(col->mean > 0))
+      {
+        printf("column %s: exp needs mean > 0\n", col->name);
+        return -1;
+      }
+      break;
+  }
+  return 0;
+}
+
+static int parse_column(struct column *col, char *line, const char *file, int depth)
+{
+  char *save = NULL, *tok, *eq;
+  char *name = strtok_r(line, " \t\r\n", &save);
+  char *type = strtok_r(NULL, " \t\r\n", &save);
+  char *ref = NULL;
+  if (name == NULL || type == NULL)
+    return -1;
+  memset(col, 0x0, sizeof(*col));
+  snprintf(col->name, COL_NAME_LEN, "%s", name);
+  col->step = 1;
+  col->min = 1;
+  col->s = 1.0;
+  col->mean = NAN;
+  if (strcmp(type, "seq") == 0)
+    col->type = COL_SEQ;
+  else if (strcmp(type, "int") == 0)
+    col->type = COL_INT;
+  else if (strcmp(type, "str") == 0)
+    col->type = COL_STR;
+  else if (strcmp(type, "date") == 0)
+    col->type = COL_DATE;
+  else if (strcmp(type, "enum") == 0)
+    col->type = COL_ENUM;
+  else if (strcmp(type, "zipf") == 0)
+    col->type = COL_ZIPF;
+  else if (strcmp(type, "fk") == 0)
+    col->type = COL_FK;
+  else
+  {
+    printf("unknown column type: %s\n", type);
+    return -1;
+  }
+  while ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL)
+  {
+    if ((eq = strchr(tok, '=')) == NULL)
+    {
+      printf("column %s: bad param %s\n", col->name, tok);
+      return -1;
+    }
+    *eq++ = '\0';
+    if (strcmp(tok, "start") == 0 || strcmp(tok, "min") == 0)
+      col->min = atol(eq);
+    else if (strcmp(tok, "max") == 0)
+      col->max = atol(eq);
+    else if (strcmp(tok, "step") == 0)
+      col->step = atol(eq);
+    else if (strcmp(tok, "len") == 0)
+      col->len = atoi(eq);
+    else if (strcmp(tok, "n") == 0 || strcmp(tok, "rows") == 0)
+      col->n = atol(eq);
+    else if (strcmp(tok, "s") == 0)
+      col->s = atof(eq);
+    else if (strcmp(tok, "ref") == 0)
+      ref = eq;
+    else if (strcmp(tok, "mean") == 0)
+      col->mean = atof(eq);
+    else if (strcmp(tok, "stddev") == 0)
+      col->stddev = atof(eq);
+    else if (strcmp(tok, "hot") == 0)
+    {
+      if (sscanf(eq, "%lf:%ld", &col->hot, &col->hot_n) != 2 || col->hot <= 0 || col->hot > 1 || col->hot_n <= 0)
+      {
+        printf("column %s: hot must be probability:count, e.g. hot=0.3:10\n", col->name);
+        return -1;
+      }
+    }
+    else if (strcmp(tok, "dist") == 0)
+    {
+      if (strcmp(eq, "uniform") == 0)
+        col->dist = DIST_UNIFORM;
+      else if (strcmp(eq, "zipf") == 0)
+        col->dist = DIST_ZIPF;
+      else if (strcmp(eq, "normal") == 0)
+        col->dist = DIST_NORMAL;
+      else if (strcmp(eq, "exp") == 0)
+        col->dist = DIST_EXP;
+      else
+      {
+        printf("column %s: unknown dist %s\n", col->name, eq);
+        return -1;
+      }
+    }
+    else if (strcmp(tok, "from") == 0 || strcmp(tok, "to") == 0)
+    {
+      if (parse_date(eq, strcmp(tok, "from") == 0 ? &col->min : &col->max) < 0)
+      {
+        printf("column %s: bad date %s\n", col->name, eq);
+        return -1;
+      }
+    }
+    else if (strcmp(tok, "values") == 0)
+    {
+      if (parse_enum(col, eq) < 0)
+      {
+        printf("column %s: bad enum values\n", col->name);
+        return -1;
+      }
+    }
+    else
+    {
+      printf("column %s: unknown param %s\n", col->name, tok);
+      return -1;
+    }
+  }
+  switch (col->type)
+  {
+    case COL_SEQ:
+      // 宽度在schema_load之外按行数确定，见schema_set_rows
+      break;
+    case COL_INT:
+    case COL_DATE:
+      if (col->max < col->min)
+      {
+        printf("column %s: max/to must not less than min/from\n", col->name);
+        return -1;
+      }
+      col->width = col->type == COL_DATE ? 10 : (num_width(col->min) > num_width(col->max) ? num_width(col->min) : num_width(col->max));
+      break;
+    case COL_STR:
+      if (col->len <= 0)
+      {
+        printf("column %s: len must greater than 0\n", col->name);
+        return -1;
+      }
+      col->width = col->len;
+      break;
+    case COL_ENUM:
+      if (col->enum_num == 0)
+      {
+        printf("column %s: values required\n", col->name);
+        return -1;
+      }
+      break;
+    case COL_ZIPF:
+      if (col->n <= 0 || col->s <= 0)
+      {
+        printf("column %s: n and s must greater than 0\n", col->name);
+        return -1;
+      }
+      zipf_init(col);
+      col->width = num_width(col->n);
+      break;
+    case COL_FK:
+      if (ref == NULL || col->n <= 0 || parse_ref(col, file, ref, depth) < 0)
+      {
+        printf("column %s: fk needs ref=schemaFile:seqColumn and rows\n", col->name);
+        return -1;
+      }
+      col->width = num_width(col->min + col->step * (col->n - 1)) > num_width(col->min) ? num_width(col->min + col->step * (col->n - 1)) : num_width(col->min);
+      break;
+  }
+  return check_dist(col);
+}
+
+static int schema_load_depth(const char *file, struct schema *sc, int depth)
+{
+  char line[LINE_LEN], *p;
+  int cap = 16;
+  FILE *fp = fopen(file, "r");
+  if (fp == NULL)
+  {
+    printf("Can not open schema file: %s\n", file);
+    return -1;
+  }
+  memset(sc, 0x0, sizeof(*sc));
+  sc->cols = (struct column *)malloc(cap * sizeof(struct column));
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    for (p = line; *p == ' ' || *p == '\t'; p++)
+      ;
+    if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+      continue;
+    if (sc->col_num == cap)
+    {
+      cap *= 2;
+      sc->cols = (struct column *)realloc(sc->cols, cap * sizeof(struct column));
+    }
+    if (parse_column(&sc->cols[sc->col_num], p, file, depth) < 0)
+    {
+      fclose(fp);
+      schema_free(sc);
+      return -1;
+    }
+    sc->col_num++;
+  }
+  fclose(fp);
+  if (sc->col_num == 0)
+  {
+    printf("no column in schema file: %s\n", file);
+    schema_free(sc);
+    return -1;
+  }
+  return 0;
+}
+
+int schema_load(const char *file, struct schema *sc)
+{
+  return schema_load_depth(file, sc, 0);
+}
+
+/*
+seq列的宽度取决于生成的行数，确定行数后计算每行文本的最大长度
+*/
+void schema_set_rows(struct schema *sc, long rows)
+{
+  int i;
+  struct column *col;
+  sc->max_row_len = sc->col_num;
+  for (i = 0; i < sc->col_num; i++)
+  {
+    col = &sc->cols[i];
+    if (col->type == COL_SEQ)
+    {
+      col->max = col->min + col->step * (rows - 1);
+      col->width = num_width(col->min) > num_width(col->max) ? num_width(col->min) : num_width(col->max);
+    }
+    sc->max_row_len += col->width;
+  }
+}
+
+void schema_free(struct schema *sc)
+{
+  int i, j;
+  for (i = 0; i < sc->col_num; i++)
+  {
+    for (j = 0; j < sc->cols[i].enum_num; j++)
+      free(sc->cols[i].enum_val[j]);
+    free(sc->cols[i].enum_val);
+    free(sc->cols[i].enum_prob);
+    free(sc->cols[i].enum_alias);
+  }
+  free(sc->cols);
+  sc->cols = NULL;
+  sc->col_num = 0;
+}
+
+int schema_alloc_vec(const struct schema *sc, struct col_vec *vecs)
+{
+  int i;
+  for (i = 0; i < sc->col_num; i++)
+  {
+    vecs[i].ival = (long *)malloc(VEC_ROWS * sizeof(long));
+    vecs[i].sval = sc->cols[i].type == COL_STR ? (char *)malloc((size_t)VEC_ROWS * sc->cols[i].len) : NULL;
+    if (vecs[i].ival == NULL || (sc->cols[i].type == COL_STR && vecs[i].sval == NULL))
+      return -1;
+  }
+  return 0;
+}
+
+void schema_free_vec(const struct schema *sc, struct col_vec *vecs)
+{
+  int i;
+  for (i = 0; i < sc->col_num; i++)
+  {
+    free(vecs[i].ival);
+    free(vecs[i].sval);
+    vecs[i].ival = NULL;
+    vecs[i].sval = NULL;
+  }
+}
+
+static const char str_chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+static void gen_str(struct rng *r, char *p_dst, long total)
+{
+  unsigned long x = 0;
+  long i;
+  for (i = 0; i < total; i++)
+  {
+    if ((i & 7) == 0)
+      x = rng_next(r);
+    // 每个字节映射到62个字符之一，一个64位随机数用8次
+    p_dst[i] = str_chars[((x & 0xff) * 62) >> 8];
+    x >>= 8;
+  }
+}
+
+/*
+截断到[min, max]的正态，取整前等价于截断到[min - 0.5, max + 0.5]的连续正态。mean在范围内，所以：
+范围宽于2个stddev时，Marsaglia极坐标法一次出两个值，落在范围外的丢掉重来，接受率至少约0.47；
+否则范围内均匀取x，以exp(-(x - mean)^2 / (2 * stddev^2))的概率接受，接受率至少exp(-2)
+*/
+static void gen_normal(const struct column *col, struct rng *r, long *v, int n)
+{
+  double x, y, q, f, width = col->max - col->min + 1.0;
+  long k;
+  int i = 0;
+  if (width <= 2 * col->stddev)
+  {
+    f = -0.5 / (col->stddev * col->stddev);
+    while (i < n)
+    {
+      x = col->min - 0.5 + width * rng_double(r);
+      k = lround(x);
+      if (k >= col->min && k <= col->max && rng_double(r) < exp(f * (x - col->mean) * (x - col->mean)))
+        v[i++] = k;
+    }
+    return;
+  }
+  while (i < n)
+  {
+    x = 2 * rng_double(r) - 1;
+    y = 2 * rng_double(r) - 1;
+    q = x * x + y * y;
+    if (q >= 1 || q == 0)
+      continue;
+    f = col->stddev * sqrt(-2 * log(q) / q);
+    k = lround(col->mean + x * f);
+    if (k >= col->min && k <= col->max)
+      v[i++] = k;
+    k = lround(col->mean + y * f);
+    if (i < n && k >= col->min && k <= col->max)
+      v[i++] = k;
+  }
+}
+
+/*
+截断指数分布的逆变换：x = -mean * ln(1 - u * (1 - exp(-limit / mean)))，x落在[0, limit)，不需要重来
+*/
+static void gen_exp(const struct column *col, struct rng *r, long *v, int n)
+{
+  double x, limit = col->max - col->min + 1.0;
+  double mass = -expm1(-limit / col->mean);
+  int i;
+  for (i = 0; i < n; i++)
+  {
+    x = -col->mean * log1p(-rng_double(r) * mass);
+    // 舍入误差可能恰好得到limit
+    v[i] = x < limit ? col->min + (long)x : col->max;
+  }
+}
+
+void schema_gen(const struct schema *sc, unsigned long seed, long first_row, int n, struct col_vec *vecs)
+{
+  const struct column *col;
+  struct rng r;
+  long *v, k;
+  int c, i;
+  for (c = 0; c < sc->col_num; c++)
+  {
+    col = &sc->cols[c];
+    v = vecs[c].ival;
+    rng_seed(&r, seed, c, (first_row - 1) / VEC_ROWS);
+    switch (col->type)
+    {
+      case COL_SEQ:
+        for (i = 0; i < n; i++)
+          v[i] = col->min + col->step * (first_row - 1 + i);
+        break;
+      case COL_INT:
+        if (col->dist == DIST_ZIPF)
+        {
+          for (i = 0; i < n; i++)
+            v[i] = col->min + zipf_sample(col, &r) - 1;
+          break;
+        }
+        if (col->dist == DIST_NORMAL)
+        {
+          gen_normal(col, &r, v, n);
+          break;
+        }
+        if (col->dist == DIST_EXP)
+        {
+          gen_exp(col, &r, v, n);
+          break;
+        }
+        // fall through
+      case COL_DATE:
+        for (i = 0; i < n; i++)
+          v[i] = col->min + (long)rng_range(&r, col->max - col->min + 1);
+        break;
+      case COL_STR:
+        gen_str(&r, vecs[c].sval, (long)n * col->len);
+        break;
+      case COL_ENUM:
+        for (i = 0; i < n; i++)
+        {
+          k = rng_range(&r, col->enum_num);
+          v[i] = rng_double(&r) < col->enum_prob[k] ? k : col->enum_alias[k];
+        }
+        break;
+      case COL_ZIPF:
+        for (i = 0; i < n; i++)
+          v[i] = zipf_sample(col, &r);
+        break;
+      case COL_FK:
+        for (i = 0; i < n; i++)
+          v[i] = col->min + col->step * (col->dist == DIST_ZIPF ? zipf_sample(col, &r) - 1 : (long)rng_range(&r, col->n));
+        break;
+    }
+    // 热点值用同一个随机数流接着抽，结果仍只取决于seed
+    for (i = 0; col->hot > 0 && i < n; i++)
+    {
+      if (rng_double(&r) < col->hot)
+      {
+        k = (long)rng_range(&r, col->hot_n);
+        v[i] = col->type == COL_FK ? col->min + col->step * k : (col->type == COL_ZIPF ? 1 : col->min) + k;
+      }
+    }
+  }
+}
+
+unsigned long schema_key_hash(const struct column *col, const struct col_vec *vec, int i)
+{
+  const unsigned char *p;
+  unsigned long h = 0xcbf29ce484222325UL;
+  int k, len;
+  if (col->type != COL_STR && col->type != COL_ENUM)
+    return hash64(vec->ival[i]);
+  // 字符串按FNV-1a
+  p = col->type == COL_STR ? (const unsigned char *)vec->sval + (long)i * col->len : (const unsigned char *)col->enum_val[vec->ival[i]];
+  len = col->type == COL_STR ? col->len : strlen((const char *)p);
+  for (k = 0; k < len; k++)
+    h = (h ^ p[k]) * 0x100000001b3UL;
+  return hash64(h);
+}
+
+static char *format_long(long v, char *p)
+{
+  if (v < 0)
+  {
+    *p++ = '-';
+    v = -v;
+  }
+  return p + ltoa_lut(v, p);
+}
+
+static char *format_date(long days, char *p)
+{
+  long y;
+  int m, d;
+  civil_from_days(days, &y, &m, &d);
+  p[0] = '0' + y / 1000 % 10;
+  p[1] = '0' + y / 100 % 10;
+  p[2] = '0' + y / 10 % 10;
+  p[3] = '0' + y % 10;
+  p[4] = '-';
+  p[5] = '0' + m / 10;
+  p[6] = '0' + m % 10;
+  p[7] = '-';
+  p[8] = '0' + d / 10;
+  p[9] = '0' + d % 10;
+  return p + 10;
+}
+
+unsigned long schema_format(const struct schema *sc, const struct col_vec *vecs, int n, char *p_dst)
+{
+  const struct column *col;
+  char *p = p_dst;
+  int c, i, len;
+  for (i = 0; i < n; i++)
+  {
+    for (c = 0; c < sc->col_num; c++)
+    {
+      col = &sc->cols[c];
+      if (c > 0)
+        *p++ = SEPARATOR[0];
+      switch (col->type)
+      {
+        case COL_STR:
+          memcpy(p, vecs[c].sval + (long)i * col->len, col->len);
+          p += col->len;
+          break;
+        case COL_DATE:
+          p = format_date(vecs[c].ival[i], p);
+          break;
+        case COL_ENUM:
+          len = strlen(col->enum_val[vecs[c].ival[i]]);
+          memcpy(p, col->enum_val[vecs[c].ival[i]], len);
+          p += len;
+          break;
+        default:
+          p = format_long(vecs[c].ival[i], p);
+          break;
+      }
+    }
+    *p++ = '\n';
+  }
+  return p - p_dst;
+}
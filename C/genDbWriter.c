@@ -0,0 +1,163 @@
+/*
+genDbBigData的输出格式注册表，csv格式和PostgreSQL COPY BINARY格式。
+csv可以直接给PostgreSQL的COPY ... (format text, delimiter ',')和MySQL的LOAD DATA ... fields terminated by ','。
+pgbinary对应COPY ... (format binary)：seq/int/zipf/fk列是bigint，str/enum列是text/varchar，date列是date。
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "genDbBigData.h"
+
+static unsigned long csv_row_bound(const struct schema *sc, unsigned long *p_extra)
+{
+  *p_extra = 0;
+  return sc->max_row_len;
+}
+
+static unsigned long csv_encode(const struct schema *sc, unsigned long seed, long first_row, long rows, char *p_buf, void **p_meta)
+{
+  struct col_vec vecs[sc->col_num];
+  unsigned long len = 0;
+  long i;
+  int n;
+  *p_meta = NULL;
+  if (schema_alloc_vec(sc, vecs) < 0)
+  {
+    printf("malloc column vector error\n");
+    exit(1);
+  }
+  for (i = 0; i < rows; i += VEC_ROWS)
+  {
+    n = rows - i < VEC_ROWS ? rows - i : VEC_ROWS;
+    schema_gen(sc, seed, first_row + i, n, vecs);
+    len += schema_format(sc, vecs, n, p_buf + len);
+  }
+  schema_free_vec(sc, vecs);
+  return len;
+}
+
+const struct out_format csv_format =
+{
+  .name = "csv",
+  .row_bound = csv_row_bound,
+  .encode = csv_encode,
+};
+
+// PostgreSQL的date是距2000-01-01的天数
+#define PG_EPOCH_DAYS 10957
+
+static char *put_be(char *p, unsigned long v, int bytes)
+{
+  int i;
+  for (i = bytes - 1; i >= 0; i--)
+  {
+    p[i] = v & 0xff;
+    v >>= 8;
+  }
+  return p + bytes;
+}
+
+static unsigned long pg_row_bound(const struct schema *sc, unsigned long *p_extra)
+{
+  unsigned long len = 2;
+  int c;
+  *p_extra = 0;
+  for (c = 0; c < sc->col_num; c++)
+  {
+    if (sc->cols[c].type == COL_STR || sc->cols[c].type == COL_ENUM)
+      len += 4 + sc->cols[c].width;
+    else
+      len += 4 + (sc->cols[c].type == COL_DATE ? 4 : 8);
+  }
+  return len;
+}
+
+static unsigned long pg_encode(const struct schema *sc, unsigned long seed, long first_row, long rows, char *p_buf, void **p_meta)
+{
+  struct col_vec vecs[sc->col_num];
+  const struct column *col;
+  const char *p_val;
+  char *p = p_buf;
+  long i;
+  int c, k, n, len;
+  *p_meta = NULL;
+  if (schema_alloc_vec(sc, vecs) < 0)
+  {
+    printf("malloc column vector error\n");
+    exit(1);
+  }
+  for (i = 0; i < rows; i += VEC_ROWS)
+  {
+    n = rows - i < VEC_ROWS ? rows - i : VEC_ROWS;
+    schema_gen(sc, seed, first_row + i, n, vecs);
+    for (k = 0; k < n; k++)
+    {
+      // 每行：int16列数，每列int32长度加网络字节序的值
+      p = put_be(p, sc->col_num, 2);
+      for (c = 0; c < sc->col_num; c++)
+      {
+        col = &sc->cols[c];
+        switch (col->type)
+        {
+          case COL_STR:
+          case COL_ENUM:
+            p_val = col->type == COL_STR ? vecs[c].sval + (long)k * col->len : col->enum_val[vecs[c].ival[k]];
+            len = col->type == COL_STR ? col->len : strlen(p_val);
+            p = put_be(p, len, 4);
+            memcpy(p, p_val, len);
+            p += len;
+            break;
+          case COL_DATE:
+            p = put_be(p, 4, 4);
+            p = put_be(p, vecs[c].ival[k] - PG_EPOCH_DAYS, 4);
+            break;
+          default:
+            p = put_be(p, 8, 4);
+            p = put_be(p, vecs[c].ival[k], 8);
+            break;
+        }
+      }
+    }
+  }
+  schema_free_vec(sc, vecs);
+  return p - p_buf;
+}
+
+static unsigned long pg_header(const struct schema *sc, char **p_buf)
+{
+  // 11字节签名，int32 flags，int32头部扩展长度
+  static const char head[19] = "PGCOPY\n\377\r\n\0\0\0\0\0\0\0\0\0";
+  *p_buf = (char *)malloc(sizeof(head));
+  memcpy(*p_buf, head, sizeof(head));
+  return sizeof(head);
+}
+
+static unsigned long pg_footer(void **p_state, const struct schema *sc, long rows, char **p_buf)
+{
+  *p_buf = (char *)malloc(2);
+  put_be(*p_buf, -1, 2);
+  return 2;
+}
+
+const struct out_format pgbinary_format =
+{
+  .name = "pgbinary",
+  .row_bound = pg_row_bound,
+  .encode = pg_encode,
+  .header = pg_header,
+  .footer = pg_footer,
+};
+
+static const struct out_format *formats[] = { &csv_format, &parquet_format, &pgbinary_format };
+
+const struct out_format *find_format(const char *name)
+{
+  int i;
+  for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+  {
+    if (strcmp(formats[i]->name, name) == 0)
+      return formats[i];
+  }
+  return NULL;
+}
@@ -1,10 +1,12 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 /*
 * this is a demo to show multi processes on Linux
+* for a pool that restarts crashed workers and drains on SIGTERM see prefork.c and multiProcessPool.c
 */
 
 void process()
@@ -38,11 +40,13 @@ int main(int argc,char *argv[])
 			{
 				printf("i am father, my id=%d, my child id=%d\n", getpid(), pid[i]);
 				// WNOHANG is none blocking, and 0 is blocking
-				waitpid(pid[i], &status, WNOHANG);
-				exit(0);
+				if (waitpid(pid[i], &status, WNOHANG) == pid[i])
+					printf("child %d already exited\n", pid[i]);
 			}
 		}
 	}
-	sleep(60);
+	// exiting here would leave the children as orphans, reap them all
+	for (i=0; i<2; i++)
+		waitpid(pid[i], &status, 0);
 	return 0;
 }
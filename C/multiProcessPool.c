@@ -0,0 +1,157 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "prefork.h"
+
+/*
+* demo of the prefork worker pool (prefork.c), the grown up multiProcess.c
+*   job mode: the supervisor submits -n jobs, every job counts the primes below a number, workers exit when all are done
+*   http mode (-l port): workers accept on one shared listen socket and answer "hello", stop it with SIGTERM or ctrl-c
+* -c crashes a worker after every that many jobs, to watch the supervisor restart it (the job in hand is lost)
+* -p pins the workers to cpus
+* build: gcc -O2 multiProcessPool.c prefork.c -o multiProcessPool
+* usage: ./multiProcessPool [-w workers] [-n jobs] [-l port] [-c crashEvery] [-r reportSec] [-p]
+*/
+
+struct demo_arg
+{
+	int crash_every;
+};
+
+// keeps the compiler from dropping the work
+static volatile long sink;
+
+static long count_primes(long n)
+{
+	long i, j, num = 0;
+	for (i = 2; i < n; i++)
+	{
+		for (j = 2; j * j <= i && i % j != 0; j++)
+			;
+		if (j * j > i)
+			num++;
+	}
+	return num;
+}
+
+static void job_worker(struct prefork_pool *p, int id, void *arg)
+{
+	struct demo_arg *a = (struct demo_arg *)arg;
+	long n, done = 0;
+	while (prefork_job(p, &n, sizeof(n)) == sizeof(n))
+	{
+		sink += count_primes(n);
+		if (a->crash_every > 0 && ++done % a->crash_every == 0)
+			abort();
+		prefork_done(p);
+	}
+}
+
+static void http_worker(struct prefork_pool *p, int id, void *arg)
+{
+	static const char resp[] = "HTTP/1.1 200 OK\r\nContent-Length: 6\r\nConnection: close\r\n\r\nhello\n";
+	char buf[4096];
+	int fd;
+	while ((fd = prefork_accept(p)) >= 0)
+	{
+		read(fd, buf, sizeof(buf));
+		write(fd, resp, sizeof(resp) - 1);
+		close(fd);
+		prefork_done(p);
+	}
+}
+
+static int listen_on(int port)
+{
+	struct sockaddr_in addr;
+	int fd, on = 1;
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	memset(&addr, 0x0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1024) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int main(int argc, char *argv[])
+{
+	struct prefork_pool *p;
+	struct demo_arg a;
+	int opt, i, workers = 4, port = 0, pin = 0, report_sec = 1, fd = -1;
+	long jobs = 2000, n;
+	unsigned long units = 0;
+	memset(&a, 0x0, sizeof(a));
+	while ((opt = getopt(argc, argv, "w:n:l:c:r:p")) != -1)
+	{
+		switch (opt)
+		{
+			case 'w':
+				workers = atoi(optarg);
+				break;
+			case 'n':
+				jobs = atol(optarg);
+				break;
+			case 'l':
+				port = atoi(optarg);
+				break;
+			case 'c':
+				a.crash_every = atoi(optarg);
+				break;
+			case 'r':
+				report_sec = atoi(optarg);
+				break;
+			case 'p':
+				pin = 1;
+				break;
+			default:
+				printf("usage: %s [-w workers] [-n jobs] [-l port] [-c crashEvery] [-r reportSec] [-p]\n", argv[0]);
+				exit(1);
+		}
+	}
+	if (port > 0 && (fd = listen_on(port)) < 0)
+	{
+		printf("listen on %d error\n", port);
+		exit(1);
+	}
+	if ((p = prefork_create(workers, fd, fd >= 0 ? http_worker : job_worker, &a)) == NULL)
+	{
+		printf("workers must between 1 and %d\n", PREFORK_MAX_WORKERS);
+		exit(1);
+	}
+	p->pin = pin;
+	p->report_sec = report_sec;
+	if (prefork_start(p) < 0)
+	{
+		printf("start pool error\n");
+		exit(1);
+	}
+	if (fd < 0)
+	{
+		for (n = 0; n < jobs; n++)
+		{
+			long limit = 20000 + n % 100 * 1000;
+			if (prefork_submit(p, &limit, sizeof(limit)) < 0)
+				break;
+		}
+		prefork_close(p);
+	}
+	prefork_run(p);
+	prefork_report(p, stdout);
+	for (i = 0; i < workers; i++)
+		units += atomic_load(&p->shm->load[i].units);
+	printf("%lu units done\n", units);
+	prefork_destroy(p);
+	return 0;
+}
@@ -0,0 +1,147 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include "shmFutex.h"
+#include "notify.h"
+
+// signals caught by the NOTIFY_SIGNAL handler, only touched while the signal is blocked or in the handler
+static volatile sig_atomic_t sig_count = 0;
+
+static const char *kind_names[NOTIFY_KIND_NUM] = { "eventfd", "futex", "signalfd", "signal" };
+
+static void on_notify(int sig)
+{
+	sig_count++;
+}
+
+const char *notify_name(int kind)
+{
+	return kind >= 0 && kind < NOTIFY_KIND_NUM ? kind_names[kind] : "unknown";
+}
+
+struct notify *notify_create(int kind)
+{
+	struct notify *n;
+	if (kind < 0 || kind >= NOTIFY_KIND_NUM || (n = (struct notify *)calloc(1, sizeof(struct notify))) == NULL)
+		return NULL;
+	n->kind = kind;
+	n->sig = SIGRTMIN + 2;
+	n->fd = -1;
+	n->shm = (struct notify_shm *)mmap(NULL, sizeof(struct notify_shm), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (n->shm == MAP_FAILED || (kind == NOTIFY_EVENTFD && (n->fd = eventfd(0, EFD_CLOEXEC)) < 0))
+	{
+		if (n->shm != MAP_FAILED)
+			munmap(n->shm, sizeof(struct notify_shm));
+		free(n);
+		return NULL;
+	}
+	return n;
+}
+
+void notify_close(struct notify *n)
+{
+	if (n->fd >= 0)
+		close(n->fd);
+	munmap(n->shm, sizeof(struct notify_shm));
+	free(n);
+}
+
+int notify_bind(struct notify *n)
+{
+	struct sigaction sa;
+	sigset_t mask;
+	if (n->kind == NOTIFY_SIGNALFD || n->kind == NOTIFY_SIGNAL)
+	{
+		// blocked outside of wait, so the signal is only taken where we expect it
+		sigemptyset(&mask);
+		sigaddset(&mask, n->sig);
+		if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+			return -1;
+		if (n->kind == NOTIFY_SIGNALFD)
+		{
+			if ((n->fd = signalfd(-1, &mask, SFD_CLOEXEC)) < 0)
+				return -1;
+		}
+		else
+		{
+			memset(&sa, 0x0, sizeof(sa));
+			sa.sa_handler = on_notify;
+			sigemptyset(&sa.sa_mask);
+			if (sigaction(n->sig, &sa, NULL) < 0)
+				return -1;
+		}
+	}
+	atomic_store(&n->shm->pid, getpid());
+	return 0;
+}
+
+int notify_fd(struct notify *n)
+{
+	return n->fd;
+}
+
+long notify_wait(struct notify *n)
+{
+	struct notify_shm *s = n->shm;
+	struct signalfd_siginfo si[16];
+	sigset_t mask;
+	uint64_t v;
+	ssize_t len;
+	long c;
+	switch (n->kind)
+	{
+		case NOTIFY_EVENTFD:
+			while ((len = read(n->fd, &v, sizeof(v))) < 0 && errno == EINTR)
+				;
+			return len == sizeof(v) ? (long)v : -1;
+		case NOTIFY_FUTEX:
+			while ((c = atomic_exchange(&s->pending, 0)) == 0)
+				SHM_WAIT(atomic_load(&s->pending) != 0, &s->waiting);
+			return c;
+		case NOTIFY_SIGNALFD:
+			// real time signals queue, take every one already there
+			while ((len = read(n->fd, si, sizeof(si))) < 0 && errno == EINTR)
+				;
+			return len > 0 ? len / sizeof(si[0]) : -1;
+		case NOTIFY_SIGNAL:
+			sigprocmask(SIG_SETMASK, NULL, &mask);
+			sigdelset(&mask, n->sig);
+			while (sig_count == 0)
+				sigsuspend(&mask);
+			c = sig_count;
+			sig_count = 0;
+			return c;
+	}
+	return -1;
+}
+
+int notify_post(struct notify *n)
+{
+	struct notify_shm *s = n->shm;
+	union sigval val;
+	uint64_t one = 1;
+	pid_t pid;
+	switch (n->kind)
+	{
+		case NOTIFY_EVENTFD:
+			return write(n->fd, &one, sizeof(one)) == sizeof(one) ? 0 : -1;
+		case NOTIFY_FUTEX:
+			// seq_cst add pairs with the waiter's store to waiting before it rechecks pending
+			atomic_fetch_add(&s->pending, 1);
+			shm_wake(&s->waiting, 1);
+			return 0;
+		default:
+			if ((pid = atomic_load(&s->pid)) == 0)
+				return -1;
+			val.sival_int = 0;
+			return sigqueue(pid, n->sig, val);
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef NOTIFY_H
+#define NOTIFY_H
+
+/*
+* wake one process from another, the same api over four mechanisms:
+*   NOTIFY_EVENTFD: eventfd counter inherited by fork, the waiter can also poll notify_fd
+*   NOTIFY_FUTEX: counter and futex word in shared memory, spins a little before sleeping (on more than 1 cpu)
+*   NOTIFY_SIGNALFD: real time signal read synchronously from a signalfd, nothing runs in a signal handler
+*   NOTIFY_SIGNAL: real time signal caught by a handler, the IPC_signal.c way (with sigsuspend instead of racy pause)
+* a notify has exactly one waiter process, create it before fork and call notify_bind in the waiter
+* posts are counted, wait returns how many arrived since the last wait (at least 1)
+* build with: gcc -O2 yourProgram.c notify.c
+*/
+
+#include <stdatomic.h>
+#include <sys/types.h>
+
+enum notify_kind
+{
+	NOTIFY_EVENTFD = 0,
+	NOTIFY_FUTEX,
+	NOTIFY_SIGNALFD,
+	NOTIFY_SIGNAL,
+	NOTIFY_KIND_NUM
+};
+
+struct notify_shm
+{
+	_Atomic unsigned int pending;
+	// futex word, set to 1 by the waiter before it sleeps
+	_Atomic unsigned int waiting;
+	// the waiter, target of the signal kinds
+	_Atomic pid_t pid;
+};
+
+struct notify
+{
+	int kind;
+	// signal number for the signal kinds, SIGRTMIN + 2 unless changed before notify_bind
+	int sig;
+	// eventfd or signalfd, -1 for the others
+	int fd;
+	struct notify_shm *shm;
+};
+
+struct notify *notify_create(int kind);
+void notify_close(struct notify *n);
+const char *notify_name(int kind);
+
+/*
+* waiter: bind makes the calling process the waiter, -1 on error
+* wait blocks for posts and returns how many it consumed, -1 on error
+* fd is readable when a post is pending (eventfd and signalfd only, else -1)
+*/
+int notify_bind(struct notify *n);
+long notify_wait(struct notify *n);
+int notify_fd(struct notify *n);
+
+/*
+* any process: wake the waiter, -1 if it has not bound yet
+*/
+int notify_post(struct notify *n);
+
+#endif
@@ -0,0 +1,425 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "shmFutex.h"
+#include "prefork.h"
+
+// SIGTERM seen by this worker
+static volatile sig_atomic_t term_flag = 0;
+
+static long now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static long now_ms()
+{
+	return now_us() / 1000;
+}
+
+static void on_term(int sig)
+{
+	term_flag = 1;
+}
+
+struct prefork_pool *prefork_create(int worker_num, int listen_fd, prefork_fn fn, void *arg)
+{
+	struct prefork_pool *p;
+	int i;
+	if (worker_num <= 0 || worker_num > PREFORK_MAX_WORKERS)
+		return NULL;
+	if ((p = (struct prefork_pool *)calloc(1, sizeof(struct prefork_pool) + worker_num * sizeof(struct prefork_child))) == NULL)
+		return NULL;
+	// anonymous shared memory is enough, only forked workers use it
+	p->shm = (struct prefork_shm *)mmap(NULL, sizeof(struct prefork_shm), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (p->shm == MAP_FAILED)
+	{
+		free(p);
+		return NULL;
+	}
+	for (i = 0; i < PREFORK_JOB_SLOTS; i++)
+		atomic_store(&p->shm->jobs[i].seq, i);
+	p->worker_num = worker_num;
+	p->listen_fd = listen_fd;
+	p->fn = fn;
+	p->arg = arg;
+	p->drain_ms = 5000;
+	p->report_fp = stdout;
+	p->id = -1;
+	p->sig_fd = -1;
+	for (i = 0; i < worker_num; i++)
+		p->child[i].cpu = -1;
+	return p;
+}
+
+void prefork_destroy(struct prefork_pool *p)
+{
+	if (p->sig_fd >= 0)
+	{
+		close(p->sig_fd);
+		sigprocmask(SIG_SETMASK, &p->old_mask, NULL);
+	}
+	munmap(p->shm, sizeof(struct prefork_shm));
+	free(p);
+}
+
+static void worker_main(struct prefork_pool *p, int id)
+{
+	struct sigaction sa;
+	cpu_set_t set;
+	// no SA_RESTART, so that a blocking accept or futex wait returns and sees the flag
+	memset(&sa, 0x0, sizeof(sa));
+	sa.sa_handler = on_term;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGTERM, &sa, NULL);
+	// ctrl-c reaches the whole process group, only the supervisor decides how workers stop
+	signal(SIGINT, SIG_IGN);
+	close(p->sig_fd);
+	sigprocmask(SIG_SETMASK, &p->old_mask, NULL);
+	p->id = id;
+	p->sig_fd = -1;
+	prctl(PR_SET_PDEATHSIG, SIGTERM);
+	// the supervisor died before prctl
+	if (getppid() != p->supervisor)
+		exit(0);
+	if (p->child[id].cpu >= 0)
+	{
+		CPU_ZERO(&set);
+		CPU_SET(p->child[id].cpu, &set);
+		sched_setaffinity(0, sizeof(set), &set);
+	}
+	p->fn(p, id, p->arg);
+	exit(0);
+}
+
+static void spawn(struct prefork_pool *p, int i)
+{
+	struct prefork_child *c = &p->child[i];
+	pid_t pid;
+	atomic_store(&p->shm->load[i].unit_start, 0);
+	fflush(NULL);
+	switch (pid = fork())
+	{
+		case -1:
+			printf("fork worker %d error, retry later\n", i);
+			c->restart_ms = now_ms() + PREFORK_MAX_DELAY_MS;
+			return;
+		case 0:
+			worker_main(p, i);
+		default:
+			c->pid = pid;
+			c->start_ms = now_ms();
+			c->restart_ms = 0;
+			p->alive++;
+			break;
+	}
+}
+
+int prefork_start(struct prefork_pool *p)
+{
+	sigset_t mask;
+	cpu_set_t set;
+	int i, cpu, cpus[CPU_SETSIZE], cpu_num = 0;
+	// signals reach the supervisor through a signalfd only, so handling them needs no async-signal-safety
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGINT);
+	if (sigprocmask(SIG_BLOCK, &mask, &p->old_mask) < 0)
+		return -1;
+	if ((p->sig_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
+	{
+		sigprocmask(SIG_SETMASK, &p->old_mask, NULL);
+		return -1;
+	}
+	if (p->pin && sched_getaffinity(0, sizeof(set), &set) == 0)
+	{
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if (CPU_ISSET(cpu, &set))
+				cpus[cpu_num++] = cpu;
+		}
+		for (i = 0; i < p->worker_num && cpu_num > 0; i++)
+			p->child[i].cpu = cpus[i % cpu_num];
+	}
+	p->supervisor = getpid();
+	p->report_ms = now_ms();
+	for (i = 0; i < p->worker_num; i++)
+		spawn(p, i);
+	return 0;
+}
+
+/*
+* collect dead workers and schedule their restarts
+*/
+static void reap(struct prefork_pool *p)
+{
+	struct prefork_child *c;
+	pid_t pid;
+	int i, status;
+	long now = now_ms();
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+	{
+		for (i = 0; i < p->worker_num && p->child[i].pid != pid; i++)
+			;
+		if (i == p->worker_num)
+			continue;
+		c = &p->child[i];
+		c->pid = 0;
+		p->alive--;
+		if (atomic_load(&p->shm->draining) || (atomic_load(&p->shm->closed) && WIFEXITED(status) && WEXITSTATUS(status) == 0))
+			continue;
+		if (WIFSIGNALED(status))
+			printf("worker %d pid %d killed by signal %d, restart\n", i, pid, WTERMSIG(status));
+		else
+			printf("worker %d pid %d exit %d, restart\n", i, pid, WEXITSTATUS(status));
+		c->restarts++;
+		c->crash_streak = now - c->start_ms < PREFORK_MIN_LIFE_MS ? c->crash_streak + 1 : 0;
+		c->restart_ms = now;
+		// 100ms, 200ms, ... for a worker that keeps dying on start
+		if (c->crash_streak > 0)
+			c->restart_ms += c->crash_streak > 6 ? PREFORK_MAX_DELAY_MS : 100L << (c->crash_streak - 1);
+	}
+}
+
+int prefork_poll(struct prefork_pool *p, int timeout_ms)
+{
+	struct pollfd pfd;
+	struct signalfd_siginfo si;
+	long now = now_ms(), wait = timeout_ms;
+	int i, pending = 0;
+	for (i = 0; i < p->worker_num; i++)
+	{
+		if (p->child[i].restart_ms > 0 && p->child[i].restart_ms - now < wait)
+			wait = p->child[i].restart_ms - now;
+	}
+	if (p->drain_deadline > 0 && p->drain_deadline - now < wait)
+		wait = p->drain_deadline - now;
+	if (p->report_sec > 0 && p->report_ms + p->report_sec * 1000L - now < wait)
+		wait = p->report_ms + p->report_sec * 1000L - now;
+	pfd.fd = p->sig_fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, wait < 0 ? 0 : wait) > 0)
+	{
+		while (read(p->sig_fd, &si, sizeof(si)) == sizeof(si))
+		{
+			if (si.ssi_signo != SIGCHLD)
+				prefork_stop(p);
+		}
+	}
+	reap(p);
+
+	now = now_ms();
+	for (i = 0; i < p->worker_num; i++)
+	{
+		if (p->child[i].restart_ms > 0 && p->child[i].restart_ms <= now)
+			spawn(p, i);
+		if (p->child[i].restart_ms > 0)
+			pending++;
+	}
+	if (p->drain_deadline > 0 && now >= p->drain_deadline)
+	{
+		for (i = 0; i < p->worker_num; i++)
+		{
+			if (p->child[i].pid > 0)
+			{
+				printf("worker %d pid %d did not drain in %ums, kill it\n", i, p->child[i].pid, p->drain_ms);
+				kill(p->child[i].pid, SIGKILL);
+			}
+		}
+		p->drain_deadline = 0;
+	}
+	if (p->report_sec > 0 && now >= p->report_ms + p->report_sec * 1000L && !atomic_load(&p->shm->draining))
+		prefork_report(p, p->report_fp);
+	return p->alive + pending;
+}
+
+void prefork_run(struct prefork_pool *p)
+{
+	while (prefork_poll(p, 1000) > 0)
+		;
+}
+
+void prefork_stop(struct prefork_pool *p)
+{
+	struct prefork_shm *s = p->shm;
+	int i;
+	if (atomic_exchange(&s->draining, 1))
+		return;
+	atomic_store(&s->job_wait, 0);
+	futex_wake(&s->job_wait, INT_MAX);
+	atomic_store(&s->space_wait, 0);
+	futex_wake(&s->space_wait, INT_MAX);
+	for (i = 0; i < p->worker_num; i++)
+	{
+		p->child[i].restart_ms = 0;
+		if (p->child[i].pid > 0)
+			kill(p->child[i].pid, SIGTERM);
+	}
+	p->drain_deadline = now_ms() + p->drain_ms;
+}
+
+/*
+* units/s and busy% are over the time since the last report, busy time includes the unit in progress
+*/
+void prefork_report(struct prefork_pool *p, FILE *fp)
+{
+	struct prefork_load *l;
+	struct prefork_child *c;
+	unsigned long units, busy;
+	long now = now_us(), start, interval = now - p->report_ms * 1000;
+	int i;
+	if (interval <= 0)
+		interval = 1;
+	fprintf(fp, "%6s %8s %4s %12s %10s %6s %8s\n", "worker", "pid", "cpu", "units", "units/s", "busy%", "restarts");
+	for (i = 0; i < p->worker_num; i++)
+	{
+		l = &p->shm->load[i];
+		c = &p->child[i];
+		start = atomic_load(&l->unit_start);
+		units = atomic_load(&l->units);
+		busy = atomic_load(&l->busy_us) + (start > 0 ? now - start : 0);
+		fprintf(fp, "%6d %8d %4d %12lu %10.1f %6.1f %8u\n", i, c->pid, c->cpu, units,
+			(units - c->last_units) * 1e6 / interval, (busy - c->last_busy_us) * 100.0 / interval, c->restarts);
+		c->last_units = units;
+		c->last_busy_us = busy;
+	}
+	fflush(fp);
+	p->report_ms = now / 1000;
+}
+
+static void unit_start(struct prefork_pool *p)
+{
+	atomic_store(&p->shm->load[p->id].unit_start, now_us());
+}
+
+void prefork_done(struct prefork_pool *p)
+{
+	struct prefork_load *l = &p->shm->load[p->id];
+	long start = atomic_load(&l->unit_start);
+	if (start == 0)
+		return;
+	atomic_fetch_add(&l->busy_us, now_us() - start);
+	atomic_fetch_add(&l->units, 1);
+	atomic_store(&l->unit_start, 0);
+}
+
+int prefork_draining(struct prefork_pool *p)
+{
+	return term_flag || atomic_load(&p->shm->draining);
+}
+
+int prefork_accept(struct prefork_pool *p)
+{
+	int fd;
+	// SIGTERM between the check and accept is only seen at the next connection or the drain_ms kill
+	while (!prefork_draining(p))
+	{
+		if ((fd = accept(p->listen_fd, NULL, NULL)) >= 0)
+		{
+			unit_start(p);
+			return fd;
+		}
+		if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN)
+			return -1;
+	}
+	return -1;
+}
+
+int prefork_submit(struct prefork_pool *p, const void *buf, unsigned int len)
+{
+	struct prefork_shm *s = p->shm;
+	struct prefork_job *j;
+	unsigned long pos = atomic_load_explicit(&s->job_head, memory_order_relaxed);
+	long diff;
+	if (len > PREFORK_JOB_LEN)
+		return -1;
+	for (;;)
+	{
+		if (atomic_load(&s->draining))
+			return -1;
+		j = &s->jobs[pos & (PREFORK_JOB_SLOTS - 1)];
+		diff = (long)(atomic_load_explicit(&j->seq, memory_order_acquire) - pos);
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak(&s->job_head, &pos, pos + 1))
+				break;
+			continue;
+		}
+		if (diff < 0)
+		{
+			// full: sleep a little at a time, the supervisor has to keep restarting workers meanwhile
+			atomic_store(&s->space_wait, 1);
+			if ((long)(atomic_load(&j->seq) - pos) < 0)
+				futex_wait_ms(&s->space_wait, 1, 100);
+			if (p->id < 0)
+				prefork_poll(p, 0);
+		}
+		pos = atomic_load_explicit(&s->job_head, memory_order_relaxed);
+	}
+	j->len = len;
+	memcpy(j->data, buf, len);
+	atomic_store(&j->seq, pos + 1);
+	shm_wake(&s->job_wait, 1);
+	return 0;
+}
+
+void prefork_close(struct prefork_pool *p)
+{
+	__atomic_store_n(&p->shm->closed, 1, __ATOMIC_SEQ_CST);
+	atomic_store(&p->shm->job_wait, 0);
+	futex_wake(&p->shm->job_wait, INT_MAX);
+}
+
+static int job_ready(struct prefork_shm *s)
+{
+	unsigned long pos = atomic_load(&s->job_tail);
+	return atomic_load(&s->jobs[pos & (PREFORK_JOB_SLOTS - 1)].seq) == pos + 1;
+}
+
+long prefork_job(struct prefork_pool *p, void *buf, unsigned int cap)
+{
+	struct prefork_shm *s = p->shm;
+	struct prefork_job *j;
+	unsigned long pos;
+	long diff, len;
+	for (;;)
+	{
+		if (prefork_draining(p))
+			return -1;
+		pos = atomic_load_explicit(&s->job_tail, memory_order_relaxed);
+		j = &s->jobs[pos & (PREFORK_JOB_SLOTS - 1)];
+		diff = (long)(atomic_load_explicit(&j->seq, memory_order_acquire) - (pos + 1));
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak(&s->job_tail, &pos, pos + 1))
+				break;
+		}
+		else if (diff < 0)
+		{
+			// empty, closed is set after the last submit
+			if (atomic_load(&s->closed) && !job_ready(s))
+				return -1;
+			SHM_WAIT(job_ready(s) || atomic_load(&s->closed) || prefork_draining(p), &s->job_wait);
+		}
+	}
+	len = j->len < cap ? j->len : cap;
+	memcpy(buf, j->data, len);
+	atomic_store_explicit(&j->seq, pos + PREFORK_JOB_SLOTS, memory_order_release);
+	shm_wake(&s->space_wait, 1);
+	unit_start(p);
+	return len;
+}
@@ -0,0 +1,144 @@
+#ifndef PREFORK_H
+#define PREFORK_H
+
+/*
+* prefork worker pool: a supervisor process forks a fixed number of workers and keeps them alive
+* - worker i can be pinned to the i-th cpu the supervisor may run on
+* - a worker that dies is restarted, a worker that keeps dying right after start is restarted with a growing delay
+* - SIGTERM or SIGINT to the supervisor drains the pool: every worker finishes the unit of work it holds and exits,
+*   workers still running after drain_ms are killed
+* - workers die with the supervisor (PR_SET_PDEATHSIG), so no orphans are left behind
+* work is handed out through a listen socket every worker accepts on, or a shared memory job queue, or both,
+* each worker counts its units and busy time in shared memory so that the supervisor can report the load
+* a job held by a worker that crashes is lost, the queue gives at most once delivery
+* build with: gcc -O2 yourProgram.c prefork.c
+*/
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#define PREFORK_MAX_WORKERS 256
+#define PREFORK_JOB_SLOTS 1024
+#define PREFORK_JOB_LEN 240
+// a worker that lives shorter than this counts as crashing on start
+#define PREFORK_MIN_LIFE_MS 1000
+#define PREFORK_MAX_DELAY_MS 5000
+
+/*
+* per worker load, written by the worker and read by the supervisor
+*/
+struct prefork_load
+{
+	_Atomic unsigned long units __attribute__((aligned(64)));
+	_Atomic unsigned long busy_us;
+	// start of the unit being worked on in us, 0 when idle
+	_Atomic long unit_start;
+};
+
+struct prefork_job
+{
+	// slot of position pos is free when seq == pos, holds a job when seq == pos + 1
+	_Atomic unsigned long seq;
+	unsigned int len;
+	char data[PREFORK_JOB_LEN];
+};
+
+struct prefork_shm
+{
+	_Atomic unsigned int draining;
+	// no more jobs will be submitted, workers exit once the queue is empty
+	_Atomic unsigned int closed;
+	_Atomic unsigned long job_head __attribute__((aligned(64)));
+	_Atomic unsigned long job_tail __attribute__((aligned(64)));
+	// futex words, workers waiting for a job and submitters waiting for a free slot
+	_Atomic unsigned int job_wait __attribute__((aligned(64)));
+	_Atomic unsigned int space_wait __attribute__((aligned(64)));
+	struct prefork_load load[PREFORK_MAX_WORKERS];
+	struct prefork_job jobs[PREFORK_JOB_SLOTS];
+};
+
+struct prefork_pool;
+/*
+* body of a worker, returning from it exits the worker
+*/
+typedef void (*prefork_fn)(struct prefork_pool *p, int id, void *arg);
+
+/*
+* supervisor side state of one worker
+*/
+struct prefork_child
+{
+	pid_t pid;
+	int cpu;
+	long start_ms;
+	// restart pending at this time, 0 if none
+	long restart_ms;
+	unsigned int restarts;
+	// consecutive deaths within PREFORK_MIN_LIFE_MS
+	unsigned int crash_streak;
+	unsigned long last_units;
+	unsigned long last_busy_us;
+};
+
+struct prefork_pool
+{
+	int worker_num;
+	int listen_fd;
+	prefork_fn fn;
+	void *arg;
+	// options, change them between prefork_create and prefork_start
+	int pin;
+	unsigned int drain_ms;
+	unsigned int report_sec;
+	FILE *report_fp;
+
+	struct prefork_shm *shm;
+	// worker id inside a worker, -1 in the supervisor
+	int id;
+	pid_t supervisor;
+	int sig_fd;
+	sigset_t old_mask;
+	int alive;
+	long drain_deadline;
+	long report_ms;
+	struct prefork_child child[];
+};
+
+/*
+* listen_fd -1 when only the job queue is used
+*/
+struct prefork_pool *prefork_create(int worker_num, int listen_fd, prefork_fn fn, void *arg);
+void prefork_destroy(struct prefork_pool *p);
+
+/*
+* supervisor: start forks the workers, -1 on error
+* poll handles signals, dead workers, restarts and reports for up to timeout_ms, returns the number of live workers
+* run polls until every worker is gone
+* stop starts draining as SIGTERM does
+*/
+int prefork_start(struct prefork_pool *p);
+int prefork_poll(struct prefork_pool *p, int timeout_ms);
+void prefork_run(struct prefork_pool *p);
+void prefork_stop(struct prefork_pool *p);
+void prefork_report(struct prefork_pool *p, FILE *fp);
+
+/*
+* job queue, submit is called by the supervisor and blocks while the queue is full, -1 if len is too large or draining
+* close tells the workers that no more jobs come
+*/
+int prefork_submit(struct prefork_pool *p, const void *buf, unsigned int len);
+void prefork_close(struct prefork_pool *p);
+
+/*
+* worker: accept returns a connection and job blocks for the next job and returns its length,
+* both return -1 once the pool drains (job also when it is closed and empty)
+* done ends the unit of work taken by accept or job and accounts it
+*/
+int prefork_accept(struct prefork_pool *p);
+long prefork_job(struct prefork_pool *p, void *buf, unsigned int cap);
+void prefork_done(struct prefork_pool *p);
+int prefork_draining(struct prefork_pool *p);
+
+#endif
@@ -0,0 +1,260 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shmFutex.h"
+#include "shmBcast.h"
+
+// a reader slot being claimed by join, the writer ignores it until it becomes active
+#define SHM_BCAST_JOINING 3
+
+_Static_assert(sizeof(struct shm_bcast_hdr) <= SHM_BCAST_HDR_LEN, "SHM_BCAST_HDR_LEN too small");
+
+static inline struct shm_bcast_slot *slot_at(struct shm_bcast *b, unsigned long pos)
+{
+	return (struct shm_bcast_slot *)(b->slots + (pos & (b->hdr->slot_num - 1)) * b->hdr->slot_len);
+}
+
+static long now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static struct shm_bcast *bcast_map(int fd, unsigned long map_len)
+{
+	struct shm_bcast *b = (struct shm_bcast *)calloc(1, sizeof(struct shm_bcast));
+	if (b == NULL)
+		return NULL;
+	b->fd = fd;
+	b->map_len = map_len;
+	b->hdr = (struct shm_bcast_hdr *)mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (b->hdr == MAP_FAILED)
+	{
+		free(b);
+		return NULL;
+	}
+	b->slots = (char *)b->hdr + SHM_BCAST_HDR_LEN;
+	return b;
+}
+
+struct shm_bcast *shm_bcast_create(const char *name, unsigned long slot_num, unsigned long msg_max, int policy, unsigned int slow_ms)
+{
+	struct shm_bcast *b;
+	unsigned long num = 2, len = (sizeof(struct shm_bcast_slot) + msg_max + 63) & ~63UL;
+	int fd;
+	while (num < slot_num)
+		num <<= 1;
+	if (name == NULL)
+		fd = memfd_create("shm_bcast", MFD_CLOEXEC);
+	else
+		fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		return NULL;
+	if (ftruncate(fd, SHM_BCAST_HDR_LEN + num * len) < 0 || (b = bcast_map(fd, SHM_BCAST_HDR_LEN + num * len)) == NULL)
+	{
+		close(fd);
+		return NULL;
+	}
+	// a fresh memfd or truncated shm object is all zero: no readers, every slot seq 0
+	b->hdr->slot_num = num;
+	b->hdr->slot_len = len;
+	b->hdr->policy = policy;
+	b->hdr->slow_ms = slow_ms;
+	b->hdr->magic = SHM_BCAST_MAGIC;
+	return b;
+}
+
+struct shm_bcast *shm_bcast_open(const char *name)
+{
+	struct shm_bcast_hdr hdr;
+	struct shm_bcast *b;
+	int fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0)
+		return NULL;
+	if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || hdr.magic != SHM_BCAST_MAGIC
+		|| (b = bcast_map(fd, SHM_BCAST_HDR_LEN + hdr.slot_num * hdr.slot_len)) == NULL)
+	{
+		close(fd);
+		return NULL;
+	}
+	return b;
+}
+
+void shm_bcast_close(struct shm_bcast *b)
+{
+	munmap(b->hdr, b->map_len);
+	close(b->fd);
+	free(b);
+}
+
+/*
+* lowest cursor of the active readers, pos if there is none
+*/
+static unsigned long min_cursor(struct shm_bcast *b, unsigned long pos)
+{
+	struct shm_bcast_reader *r;
+	unsigned long min = pos, c;
+	int i;
+	for (i = 0; i < SHM_BCAST_MAX_READERS; i++)
+	{
+		r = &b->hdr->readers[i];
+		if (atomic_load(&r->state) == SHM_BCAST_ACTIVE && pos - (c = atomic_load(&r->cursor)) > pos - min)
+			min = c;
+	}
+	return min;
+}
+
+/*
+* block policy: wait until the slowest reader leaves the slot of pos,
+* after slow_ms every reader still a whole ring behind is evicted
+*/
+static void wait_readers(struct shm_bcast *b, unsigned long pos)
+{
+	struct shm_bcast_hdr *h = b->hdr;
+	long start = 0, left;
+	int i, spin;
+	for (spin = 0; spin < spin_num(); spin++)
+	{
+		if (pos - (b->min_cursor = min_cursor(b, pos)) < h->slot_num)
+			return;
+		cpu_relax();
+	}
+	for (;;)
+	{
+		atomic_store(&h->writer_wait, 1);
+		if (pos - (b->min_cursor = min_cursor(b, pos)) < h->slot_num)
+			return;
+		if (h->slow_ms == 0)
+		{
+			futex_wait(&h->writer_wait, 1);
+			continue;
+		}
+		if (start == 0)
+			start = now_ms();
+		if ((left = start + h->slow_ms - now_ms()) > 0)
+		{
+			futex_wait_ms(&h->writer_wait, 1, left);
+			continue;
+		}
+		for (i = 0; i < SHM_BCAST_MAX_READERS; i++)
+		{
+			unsigned int active = SHM_BCAST_ACTIVE;
+			if (pos - atomic_load(&h->readers[i].cursor) >= h->slot_num)
+				atomic_compare_exchange_strong(&h->readers[i].state, &active, SHM_BCAST_EVICTED);
+		}
+		start = 0;
+	}
+}
+
+int shm_bcast_send(struct shm_bcast *b, const void *buf, unsigned long len)
+{
+	struct shm_bcast_hdr *h = b->hdr;
+	struct shm_bcast_slot *s;
+	unsigned long pos = atomic_load_explicit(&h->head, memory_order_relaxed);
+	if (len > h->slot_len - sizeof(struct shm_bcast_slot))
+		return -1;
+	if (h->policy == SHM_BCAST_BLOCK && pos - b->min_cursor >= h->slot_num)
+		wait_readers(b, pos);
+	s = slot_at(b, pos);
+	// seqlock: odd while writing, readers that copied across this retry
+	atomic_store_explicit(&s->seq, 2 * pos + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	s->len = len;
+	memcpy(s->data, buf, len);
+	atomic_store_explicit(&s->seq, 2 * pos + 2, memory_order_release);
+	atomic_store(&h->head, pos + 1);
+	shm_wake(&h->reader_wait, INT_MAX);
+	return 0;
+}
+
+void shm_bcast_shutdown(struct shm_bcast *b)
+{
+	__atomic_store_n(&b->hdr->closed, 1, __ATOMIC_SEQ_CST);
+	atomic_store(&b->hdr->reader_wait, 0);
+	futex_wake(&b->hdr->reader_wait, INT_MAX);
+}
+
+int shm_bcast_slow(struct shm_bcast *b, unsigned long lag)
+{
+	struct shm_bcast_hdr *h = b->hdr;
+	unsigned long pos = atomic_load(&h->head);
+	int i, n = 0;
+	for (i = 0; i < SHM_BCAST_MAX_READERS; i++)
+	{
+		if (atomic_load(&h->readers[i].state) == SHM_BCAST_ACTIVE && pos - atomic_load(&h->readers[i].cursor) > lag)
+			n++;
+	}
+	return n;
+}
+
+int shm_bcast_join(struct shm_bcast *b)
+{
+	struct shm_bcast_reader *r;
+	unsigned int state;
+	int i;
+	for (i = 0; i < SHM_BCAST_MAX_READERS; i++)
+	{
+		r = &b->hdr->readers[i];
+		state = SHM_BCAST_FREE;
+		if (!atomic_compare_exchange_strong(&r->state, &state, SHM_BCAST_JOINING))
+			continue;
+		r->lost = 0;
+		atomic_store(&r->cursor, atomic_load(&b->hdr->head));
+		atomic_store(&r->state, SHM_BCAST_ACTIVE);
+		return i;
+	}
+	return -1;
+}
+
+void shm_bcast_leave(struct shm_bcast *b, int id)
+{
+	atomic_store(&b->hdr->readers[id].state, SHM_BCAST_FREE);
+	shm_wake(&b->hdr->writer_wait, 1);
+}
+
+long shm_bcast_recv(struct shm_bcast *b, int id, void *buf, unsigned long cap)
+{
+	struct shm_bcast_hdr *h = b->hdr;
+	struct shm_bcast_reader *r = &h->readers[id];
+	struct shm_bcast_slot *s;
+	unsigned long cur = atomic_load_explicit(&r->cursor, memory_order_relaxed), head, seq, len;
+	for (;;)
+	{
+		SHM_WAIT((head = atomic_load(&h->head)) != cur || __atomic_load_n(&h->closed, __ATOMIC_SEQ_CST)
+			|| atomic_load(&r->state) != SHM_BCAST_ACTIVE, &h->reader_wait);
+		if (atomic_load(&r->state) != SHM_BCAST_ACTIVE)
+			return SHM_BCAST_GONE;
+		if ((head = atomic_load(&h->head)) == cur)
+			return SHM_BCAST_CLOSED;
+		s = slot_at(b, cur);
+		seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+		if (seq == 2 * cur + 2)
+		{
+			len = s->len < cap ? s->len : cap;
+			memcpy(buf, s->data, len);
+			atomic_thread_fence(memory_order_acquire);
+			if (atomic_load_explicit(&s->seq, memory_order_relaxed) == seq)
+				break;
+		}
+		// lapped by the writer, skip to the oldest message that is surely still there
+		head = atomic_load(&h->head);
+		r->lost += head - h->slot_num / 2 - cur;
+		cur = head - h->slot_num / 2;
+	}
+	atomic_store(&r->cursor, cur + 1);
+	if (h->policy == SHM_BCAST_BLOCK)
+		shm_wake(&h->writer_wait, 1);
+	return len;
+}
+
+unsigned long shm_bcast_lost(struct shm_bcast *b, int id)
+{
+	return b->hdr->readers[id].lost;
+}
@@ -0,0 +1,101 @@
+#ifndef SHM_BCAST_H
+#define SHM_BCAST_H
+
+/*
+* one writer to many readers broadcast ring in shared memory, every reader sees every message
+* fixed size slots each guarded by a seqlock, and one cursor per reader in the header
+* two policies when the slowest reader is a whole ring behind:
+*   SHM_BCAST_BLOCK: the writer waits, a reader that keeps it waiting longer than slow_ms is evicted
+*   SHM_BCAST_OVERWRITE: the writer never waits, a reader that was lapped skips ahead and counts the lost messages
+* build with: gcc -O2 yourProgram.c shmBcast.c
+*/
+
+#include <stdatomic.h>
+
+#define SHM_BCAST_MAGIC 0x42434153
+#define SHM_BCAST_HDR_LEN 16384
+#define SHM_BCAST_MAX_READERS 64
+
+#define SHM_BCAST_BLOCK 0
+#define SHM_BCAST_OVERWRITE 1
+
+// reader states
+#define SHM_BCAST_FREE 0
+#define SHM_BCAST_ACTIVE 1
+#define SHM_BCAST_EVICTED 2
+
+// recv return values besides the message length
+#define SHM_BCAST_CLOSED -1
+#define SHM_BCAST_GONE -2
+
+struct shm_bcast_reader
+{
+	_Atomic unsigned int state __attribute__((aligned(64)));
+	_Atomic unsigned long cursor;
+	// messages this reader missed because it was lapped (overwrite policy)
+	unsigned long lost;
+};
+
+struct shm_bcast_hdr
+{
+	unsigned int magic;
+	unsigned int policy;
+	unsigned int closed;
+	unsigned int slow_ms;
+	unsigned long slot_num;
+	unsigned long slot_len;
+	// messages published so far
+	_Atomic unsigned long head __attribute__((aligned(64)));
+	// futex words, the writer waiting for the slowest reader and readers waiting for a message
+	_Atomic unsigned int writer_wait __attribute__((aligned(64)));
+	_Atomic unsigned int reader_wait __attribute__((aligned(64)));
+	struct shm_bcast_reader readers[SHM_BCAST_MAX_READERS];
+};
+
+struct shm_bcast_slot
+{
+	// 2 * pos + 1 while message pos is being written, 2 * pos + 2 once it is complete
+	_Atomic unsigned long seq;
+	unsigned long len;
+	char data[];
+};
+
+struct shm_bcast
+{
+	struct shm_bcast_hdr *hdr;
+	char *slots;
+	int fd;
+	unsigned long map_len;
+	// writer only: lowest cursor of the active readers when last computed
+	unsigned long min_cursor;
+};
+
+/*
+* name NULL creates an anonymous memfd ring to be shared by fork, otherwise shm_open(name)
+* slot_num is rounded up to a power of 2, slow_ms 0 never evicts
+*/
+struct shm_bcast *shm_bcast_create(const char *name, unsigned long slot_num, unsigned long msg_max, int policy, unsigned int slow_ms);
+struct shm_bcast *shm_bcast_open(const char *name);
+void shm_bcast_close(struct shm_bcast *b);
+
+/*
+* writer: publish one message, -1 if len is too large
+* shutdown wakes the readers, they get SHM_BCAST_CLOSED after reading everything
+*/
+int shm_bcast_send(struct shm_bcast *b, const void *buf, unsigned long len);
+void shm_bcast_shutdown(struct shm_bcast *b);
+/*
+* number of active readers more than lag messages behind, for slow consumer monitoring
+*/
+int shm_bcast_slow(struct shm_bcast *b, unsigned long lag);
+
+/*
+* readers: join returns a reader id that starts at the next published message, -1 if all are taken
+* recv blocks until a message arrives and copies it out, returns its length, SHM_BCAST_CLOSED or SHM_BCAST_GONE if evicted
+*/
+int shm_bcast_join(struct shm_bcast *b);
+void shm_bcast_leave(struct shm_bcast *b, int id);
+long shm_bcast_recv(struct shm_bcast *b, int id, void *buf, unsigned long cap);
+unsigned long shm_bcast_lost(struct shm_bcast *b, int id);
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef SHM_FUTEX_H
+#define SHM_FUTEX_H
+
+/*
+* futex and spin helpers shared by the shared memory queues (shmRing.c, shmMpsc.c, shmBcast.c)
+* the futex words live in MAP_SHARED memory, so no FUTEX_PRIVATE_FLAG
+*/
+
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// busy polls before sleeping on the futex
+#define SHM_SPIN_NUM 2000
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+/*
+* no polling on a single cpu, the other side can not run meanwhile
+*/
+static inline int spin_num()
+{
+	static int num = -1;
+	if (num < 0)
+		num = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SHM_SPIN_NUM : 0;
+	return num;
+}
+
+static inline void futex_wait(_Atomic unsigned int *addr, unsigned int val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+
+/*
+* same as futex_wait but gives up after ms milliseconds
+*/
+static inline void futex_wait_ms(_Atomic unsigned int *addr, unsigned int val, long ms)
+{
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = ms % 1000 * 1000000;
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static inline void futex_wake(_Atomic unsigned int *addr, int num)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE, num, NULL, NULL, 0);
+}
+
+/*
+* wait until cond holds: spin first, then announce ourselves in *flag and sleep,
+* the other side clears the flag and wakes us after it changes what cond looks at
+* both the flag store here and the other side's store before it checks the flag are seq_cst
+*/
+#define SHM_WAIT(cond, flag) \
+	do { \
+		int spin_, spin_num_ = spin_num(); \
+		for (spin_ = 0; !(cond) && spin_ < spin_num_; spin_++) \
+			cpu_relax(); \
+		while (!(cond)) \
+		{ \
+			atomic_store(flag, 1); \
+			if (cond) \
+				break; \
+			futex_wait(flag, 1); \
+		} \
+	} while (0)
+
+/*
+* wake the waiters announced in *flag, num is 1 or INT_MAX
+*/
+static inline void shm_wake(_Atomic unsigned int *flag, int num)
+{
+	if (atomic_load(flag) && atomic_exchange(flag, 0))
+		futex_wake(flag, num);
+}
+
+#endif
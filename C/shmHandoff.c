@@ -0,0 +1,311 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include "shmHandoff.h"
+
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+#define POOL_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL)
+#define ONESHOT_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)
+
+// the message carries the fd of its buffer
+#define MSG_FD 1
+// one shot buffer, the receiver unmaps it on release and sends nothing back
+#define MSG_ONESHOT 2
+
+/*
+* sender --> receiver: a payload, receiver --> sender: a released id (flags and len 0)
+*/
+struct handoff_msg
+{
+	unsigned int id;
+	unsigned int flags;
+	unsigned long len;
+};
+
+static struct shm_handoff *handoff_new(int sock, int sender)
+{
+	struct shm_handoff *h = (struct shm_handoff *)calloc(1, sizeof(struct shm_handoff));
+	int i;
+	if (h == NULL)
+		return NULL;
+	h->sock = sock;
+	h->sender = sender;
+	for (i = 0; i < SHM_HANDOFF_MAX_BUFS; i++)
+		h->bufs[i].fd = -1;
+	return h;
+}
+
+static void buf_free(struct shm_handoff_buf *b)
+{
+	if (b->addr != NULL)
+		munmap(b->addr, b->len);
+	if (b->fd >= 0)
+		close(b->fd);
+	b->addr = NULL;
+	b->fd = -1;
+	b->busy = 0;
+}
+
+/*
+* memfd of len bytes mapped writable, -1 on error
+*/
+static int buf_make(struct shm_handoff_buf *b, unsigned long len)
+{
+	b->len = len;
+	if ((b->fd = memfd_create("shm_handoff", MFD_CLOEXEC | MFD_ALLOW_SEALING)) < 0)
+		return -1;
+	if (ftruncate(b->fd, len) < 0
+		|| (b->addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, b->fd, 0)) == MAP_FAILED)
+	{
+		b->addr = NULL;
+		buf_free(b);
+		return -1;
+	}
+	return 0;
+}
+
+struct shm_handoff *shm_handoff_sender(int sock, int buf_num, unsigned long buf_len)
+{
+	struct shm_handoff *h;
+	int i;
+	if (buf_num < 0 || buf_num > SHM_HANDOFF_MAX_BUFS || (h = handoff_new(sock, 1)) == NULL)
+		return NULL;
+	h->buf_num = buf_num;
+	h->buf_len = buf_len;
+	for (i = 0; i < buf_num; i++)
+	{
+		// the sender's own mapping exists before the seal, so it stays writable
+		if (buf_make(&h->bufs[i], buf_len) < 0 || fcntl(h->bufs[i].fd, F_ADD_SEALS, POOL_SEALS) < 0)
+		{
+			shm_handoff_close(h);
+			return NULL;
+		}
+	}
+	return h;
+}
+
+struct shm_handoff *shm_handoff_receiver(int sock)
+{
+	return handoff_new(sock, 0);
+}
+
+void shm_handoff_close(struct shm_handoff *h)
+{
+	int i;
+	for (i = 0; i < SHM_HANDOFF_MAX_BUFS; i++)
+		buf_free(&h->bufs[i]);
+	close(h->sock);
+	free(h);
+}
+
+/*
+* sender: take the released ids off the socket, wait for at least one when block is set
+*/
+static int take_released(struct shm_handoff *h, int block)
+{
+	struct handoff_msg m;
+	ssize_t n;
+	int num = 0;
+	for (;;)
+	{
+		n = recv(h->sock, &m, sizeof(m), block && num == 0 ? 0 : MSG_DONTWAIT);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n != sizeof(m))
+			break;
+		if (m.id < h->buf_num)
+			h->bufs[m.id].busy = 0;
+		num++;
+	}
+	if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+		return -1;
+	// the receiver went away while we wait for a buffer
+	if (n == 0 && num == 0 && block)
+		return -1;
+	return num;
+}
+
+void *shm_handoff_get(struct shm_handoff *h, unsigned long len, int *p_id)
+{
+	struct shm_handoff_buf *b;
+	int i;
+	if (h->buf_num == 0)
+	{
+		*p_id = h->next_id++ % SHM_HANDOFF_MAX_BUFS;
+		b = &h->bufs[0];
+		buf_free(b);
+		return buf_make(b, len) < 0 ? NULL : b->addr;
+	}
+	if (len > h->buf_len)
+		return NULL;
+	for (;;)
+	{
+		for (i = 0; i < h->buf_num && h->bufs[i].busy; i++)
+			;
+		if (i < h->buf_num)
+			break;
+		if (take_released(h, 1) < 0)
+			return NULL;
+	}
+	*p_id = i;
+	return h->bufs[i].addr;
+}
+
+static int send_msg(int sock, struct handoff_msg *m, int fd)
+{
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr *cm;
+	char ctl[CMSG_SPACE(sizeof(int))];
+	memset(&mh, 0x0, sizeof(mh));
+	iov.iov_base = m;
+	iov.iov_len = sizeof(*m);
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	if (fd >= 0)
+	{
+		memset(ctl, 0x0, sizeof(ctl));
+		mh.msg_control = ctl;
+		mh.msg_controllen = sizeof(ctl);
+		cm = CMSG_FIRSTHDR(&mh);
+		cm->cmsg_level = SOL_SOCKET;
+		cm->cmsg_type = SCM_RIGHTS;
+		cm->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cm), &fd, sizeof(int));
+	}
+	while (sendmsg(sock, &mh, MSG_NOSIGNAL) != sizeof(*m))
+	{
+		if (errno != EINTR)
+			return -1;
+	}
+	return 0;
+}
+
+int shm_handoff_send(struct shm_handoff *h, int id, unsigned long len)
+{
+	struct shm_handoff_buf *b;
+	struct handoff_msg m;
+	int ret;
+	m.id = id;
+	m.len = len;
+	if (h->buf_num == 0)
+	{
+		// F_SEAL_WRITE needs every writable mapping gone
+		b = &h->bufs[0];
+		munmap(b->addr, b->len);
+		b->addr = NULL;
+		if (fcntl(b->fd, F_ADD_SEALS, ONESHOT_SEALS) < 0)
+			return -1;
+		m.flags = MSG_FD | MSG_ONESHOT;
+		ret = send_msg(h->sock, &m, b->fd);
+		buf_free(b);
+		return ret;
+	}
+	if (id < 0 || id >= h->buf_num || len > h->buf_len)
+		return -1;
+	b = &h->bufs[id];
+	m.flags = b->fd_sent ? 0 : MSG_FD;
+	if (send_msg(h->sock, &m, b->fd_sent ? -1 : b->fd) < 0)
+		return -1;
+	b->fd_sent = 1;
+	b->busy = 1;
+	return 0;
+}
+
+/*
+* receiver: map a received memfd read only after checking that it can not shrink or be written by others
+*/
+static int map_fd(struct shm_handoff_buf *b, int fd, int oneshot, unsigned long len)
+{
+	struct stat st;
+	int seals = fcntl(fd, F_GET_SEALS), need = oneshot ? ONESHOT_SEALS : POOL_SEALS;
+	buf_free(b);
+	b->fd = fd;
+	if (seals < 0 || (seals & need) != need || fstat(fd, &st) < 0 || st.st_size < len)
+	{
+		printf("shm_handoff: received memfd is not sealed or too small\n");
+		buf_free(b);
+		return -1;
+	}
+	b->len = st.st_size;
+	if ((b->addr = mmap(NULL, b->len, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0)) == MAP_FAILED)
+	{
+		b->addr = NULL;
+		buf_free(b);
+		return -1;
+	}
+	// the mapping keeps the memfd alive, a one shot fd is not needed any more
+	if (oneshot)
+	{
+		close(fd);
+		b->fd = -1;
+	}
+	return 0;
+}
+
+const void *shm_handoff_recv(struct shm_handoff *h, int *p_id, unsigned long *p_len)
+{
+	struct shm_handoff_buf *b;
+	struct handoff_msg m;
+	struct msghdr mh;
+	struct iovec iov;
+	struct cmsghdr *cm;
+	char ctl[CMSG_SPACE(sizeof(int))];
+	int fd = -1;
+	ssize_t n;
+	memset(&mh, 0x0, sizeof(mh));
+	iov.iov_base = &m;
+	iov.iov_len = sizeof(m);
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = ctl;
+	mh.msg_controllen = sizeof(ctl);
+	while ((n = recvmsg(h->sock, &mh, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR)
+		;
+	for (cm = CMSG_FIRSTHDR(&mh); n > 0 && cm != NULL; cm = CMSG_NXTHDR(&mh, cm))
+	{
+		if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+			memcpy(&fd, CMSG_DATA(cm), sizeof(int));
+	}
+	if (n != sizeof(m) || m.id >= SHM_HANDOFF_MAX_BUFS || ((m.flags & MSG_FD) != 0) != (fd >= 0))
+	{
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+	b = &h->bufs[m.id];
+	if (fd >= 0 && map_fd(b, fd, m.flags & MSG_ONESHOT, m.len) < 0)
+		return NULL;
+	if (b->addr == NULL || m.len > b->len)
+		return NULL;
+	b->busy = (m.flags & MSG_ONESHOT) ? 2 : 1;
+	*p_id = m.id;
+	*p_len = m.len;
+	return b->addr;
+}
+
+int shm_handoff_release(struct shm_handoff *h, int id)
+{
+	struct handoff_msg m;
+	if (id < 0 || id >= SHM_HANDOFF_MAX_BUFS || !h->bufs[id].busy)
+		return -1;
+	if (h->bufs[id].busy == 2)
+	{
+		buf_free(&h->bufs[id]);
+		return 0;
+	}
+	h->bufs[id].busy = 0;
+	memset(&m, 0x0, sizeof(m));
+	m.id = id;
+	return send_msg(h->sock, &m, -1);
+}
@@ -0,0 +1,64 @@
+#ifndef SHM_HANDOFF_H
+#define SHM_HANDOFF_H
+
+/*
+* zero copy handoff of large buffers between two processes over a unix SOCK_SEQPACKET socket
+* the sender writes the payload straight into a memfd, only a small message (and the fd, by SCM_RIGHTS) crosses the socket,
+* the receiver maps the memfd read only, so the payload is written once and never copied
+* two modes:
+*   pool (buf_num > 0): buf_num memfds of buf_len are made once and recycled, each fd is passed only on its first use,
+*     later messages carry just the buffer id and the receiver gives it back with release;
+*     the memfds are sealed against resizing and against new writable mappings (F_SEAL_FUTURE_WRITE),
+*     the sender keeps writing through its own mapping, so a buffer must not be touched between send and its release
+*   one shot (buf_num 0): a new memfd per message, fully sealed with F_SEAL_WRITE before it is sent,
+*     for a receiver that must not trust the sender, at the price of a memfd, mmap and page faults per message
+* the receiver checks the seals before it maps, a sender can never make it SIGBUS by shrinking the file
+* build with: gcc -O2 yourProgram.c shmHandoff.c
+*/
+
+#define SHM_HANDOFF_MAX_BUFS 64
+
+struct shm_handoff_buf
+{
+	void *addr;
+	unsigned long len;
+	int fd;
+	// sender: buffer is with the receiver; receiver: 1 a held pool buffer, 2 a held one shot buffer
+	int busy;
+	// sender only: the receiver has the fd already
+	int fd_sent;
+};
+
+struct shm_handoff
+{
+	int sock;
+	int sender;
+	int buf_num;
+	unsigned long buf_len;
+	// one shot sender: id of the next message
+	unsigned int next_id;
+	struct shm_handoff_buf bufs[SHM_HANDOFF_MAX_BUFS];
+};
+
+/*
+* both take over sock, a connected SOCK_SEQPACKET unix socket (socketpair before fork, or accepted)
+*/
+struct shm_handoff *shm_handoff_sender(int sock, int buf_num, unsigned long buf_len);
+struct shm_handoff *shm_handoff_receiver(int sock);
+void shm_handoff_close(struct shm_handoff *h);
+
+/*
+* sender: get returns a buffer of at least len bytes to write the payload into, blocks until one comes back,
+* NULL if len is too large or on error; send hands it over, -1 on error
+*/
+void *shm_handoff_get(struct shm_handoff *h, unsigned long len, int *p_id);
+int shm_handoff_send(struct shm_handoff *h, int id, unsigned long len);
+
+/*
+* receiver: recv blocks for the next payload and returns it read only, NULL once the sender closed;
+* release gives the buffer back, at most SHM_HANDOFF_MAX_BUFS can be held unreleased
+*/
+const void *shm_handoff_recv(struct shm_handoff *h, int *p_id, unsigned long *p_len);
+int shm_handoff_release(struct shm_handoff *h, int id);
+
+#endif
@@ -0,0 +1,163 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shmFutex.h"
+#include "shmMpsc.h"
+
+/*
+* slot i is free for the producer of position pos when seq == pos, published when seq == pos + 1,
+* and the consumer frees it for the next lap by storing pos + slot_num
+*/
+
+static inline struct shm_mpsc_slot *slot_at(struct shm_mpsc *q, unsigned long pos)
+{
+	return (struct shm_mpsc_slot *)(q->slots + (pos & (q->hdr->slot_num - 1)) * q->hdr->slot_len);
+}
+
+static struct shm_mpsc *mpsc_map(int fd, unsigned long map_len)
+{
+	struct shm_mpsc *q = (struct shm_mpsc *)calloc(1, sizeof(struct shm_mpsc));
+	if (q == NULL)
+		return NULL;
+	q->fd = fd;
+	q->map_len = map_len;
+	q->hdr = (struct shm_mpsc_hdr *)mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (q->hdr == MAP_FAILED)
+	{
+		free(q);
+		return NULL;
+	}
+	q->slots = (char *)q->hdr + SHM_MPSC_HDR_LEN;
+	return q;
+}
+
+struct shm_mpsc *shm_mpsc_create(const char *name, unsigned long slot_num, unsigned long msg_max)
+{
+	struct shm_mpsc *q;
+	unsigned long num = 2, len = (sizeof(struct shm_mpsc_slot) + msg_max + 63) & ~63UL, i;
+	int fd;
+	while (num < slot_num)
+		num <<= 1;
+	if (name == NULL)
+		fd = memfd_create("shm_mpsc", MFD_CLOEXEC);
+	else
+		fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		return NULL;
+	if (ftruncate(fd, SHM_MPSC_HDR_LEN + num * len) < 0 || (q = mpsc_map(fd, SHM_MPSC_HDR_LEN + num * len)) == NULL)
+	{
+		close(fd);
+		return NULL;
+	}
+	memset(q->hdr, 0x0, sizeof(struct shm_mpsc_hdr));
+	q->hdr->slot_num = num;
+	q->hdr->slot_len = len;
+	for (i = 0; i < num; i++)
+		atomic_store(&slot_at(q, i)->seq, i);
+	atomic_store(&q->hdr->head, 0);
+	q->hdr->magic = SHM_MPSC_MAGIC;
+	return q;
+}
+
+struct shm_mpsc *shm_mpsc_open(const char *name)
+{
+	struct shm_mpsc_hdr hdr;
+	struct shm_mpsc *q;
+	int fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0)
+		return NULL;
+	if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || hdr.magic != SHM_MPSC_MAGIC
+		|| (q = mpsc_map(fd, SHM_MPSC_HDR_LEN + hdr.slot_num * hdr.slot_len)) == NULL)
+	{
+		close(fd);
+		return NULL;
+	}
+	return q;
+}
+
+void shm_mpsc_close(struct shm_mpsc *q)
+{
+	munmap(q->hdr, q->map_len);
+	close(q->fd);
+	free(q);
+}
+
+int shm_mpsc_send(struct shm_mpsc *q, const void *buf, unsigned long len)
+{
+	struct shm_mpsc_hdr *h = q->hdr;
+	struct shm_mpsc_slot *s;
+	unsigned long pos = atomic_load_explicit(&h->head, memory_order_relaxed);
+	long diff;
+	if (len > h->slot_len - sizeof(struct shm_mpsc_slot))
+		return -1;
+	for (;;)
+	{
+		s = slot_at(q, pos);
+		diff = (long)(atomic_load_explicit(&s->seq, memory_order_acquire) - pos);
+		if (diff == 0)
+		{
+			// on failure pos is reloaded with the current head
+			if (atomic_compare_exchange_weak(&h->head, &pos, pos + 1))
+				break;
+		}
+		else if (diff < 0)
+		{
+			// the slot still holds a message from the previous lap, the queue is full
+			SHM_WAIT((long)(atomic_load(&s->seq) - pos) >= 0, &h->prod_wait);
+			pos = atomic_load_explicit(&h->head, memory_order_relaxed);
+		}
+		else
+			pos = atomic_load_explicit(&h->head, memory_order_relaxed);
+	}
+	s->len = len;
+	memcpy(s->data, buf, len);
+	atomic_store(&s->seq, pos + 1);
+	shm_wake(&h->cons_wait, 1);
+	return 0;
+}
+
+void shm_mpsc_shutdown(struct shm_mpsc *q)
+{
+	__atomic_store_n(&q->hdr->closed, 1, __ATOMIC_SEQ_CST);
+	atomic_store(&q->hdr->cons_wait, 0);
+	futex_wake(&q->hdr->cons_wait, 1);
+}
+
+int shm_mpsc_recv_batch(struct shm_mpsc *q, struct shm_mpsc_msg *msgs, int max)
+{
+	struct shm_mpsc_hdr *h = q->hdr;
+	struct shm_mpsc_slot *s = slot_at(q, q->tail);
+	int n;
+	SHM_WAIT(atomic_load(&s->seq) == q->tail + 1
+		|| (__atomic_load_n(&h->closed, __ATOMIC_SEQ_CST) && atomic_load(&h->head) == q->tail), &h->cons_wait);
+	for (n = 0; n < max; n++)
+	{
+		s = slot_at(q, q->tail + n);
+		if (atomic_load_explicit(&s->seq, memory_order_acquire) != q->tail + n + 1)
+			break;
+		msgs[n].data = s->data;
+		msgs[n].len = s->len;
+	}
+	q->batch = n;
+	return n;
+}
+
+void shm_mpsc_release(struct shm_mpsc *q)
+{
+	int i;
+	for (i = 0; i < q->batch; i++)
+		atomic_store_explicit(&slot_at(q, q->tail + i)->seq, q->tail + i + q->hdr->slot_num, memory_order_release);
+	q->tail += q->batch;
+	q->batch = 0;
+	// pairs with the producer's store to prod_wait before it rechecks the slot
+	atomic_thread_fence(memory_order_seq_cst);
+	// wake the blocked producers only when half of the queue is free, so that a wake up pays for many messages
+	// instead of all of them fighting for every released batch; a drained queue always gets here
+	if (atomic_load(&q->hdr->head) - q->tail <= q->hdr->slot_num / 2)
+		shm_wake(&q->hdr->prod_wait, INT_MAX);
+}
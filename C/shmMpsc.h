@@ -0,0 +1,78 @@
+#ifndef SHM_MPSC_H
+#define SHM_MPSC_H
+
+/*
+* multi producer single consumer queue in shared memory, for N worker processes funnelling into one reader
+* a bounded array of fixed size slots, every slot carries a sequence number (Vyukov's bounded queue):
+* producers claim a slot with one CAS on head and publish it by storing its sequence,
+* the single consumer takes a batch of consecutive published slots and gives them back in one go
+* build with: gcc -O2 yourProgram.c shmMpsc.c
+*/
+
+#include <stdatomic.h>
+
+#define SHM_MPSC_MAGIC 0x4d505343
+#define SHM_MPSC_HDR_LEN 4096
+
+struct shm_mpsc_hdr
+{
+	unsigned int magic;
+	unsigned int closed;
+	unsigned long slot_num;
+	unsigned long slot_len;
+	_Atomic unsigned long head __attribute__((aligned(64)));
+	// futex words, producers waiting for a free slot and the consumer waiting for a published one
+	_Atomic unsigned int prod_wait __attribute__((aligned(64)));
+	_Atomic unsigned int cons_wait __attribute__((aligned(64)));
+};
+
+struct shm_mpsc_slot
+{
+	_Atomic unsigned long seq;
+	unsigned long len;
+	char data[];
+};
+
+struct shm_mpsc
+{
+	struct shm_mpsc_hdr *hdr;
+	char *slots;
+	int fd;
+	unsigned long map_len;
+	// consumer only: next slot to take and the size of the batch taken
+	unsigned long tail;
+	int batch;
+};
+
+struct shm_mpsc_msg
+{
+	void *data;
+	unsigned long len;
+};
+
+/*
+* name NULL creates an anonymous memfd queue to be shared by fork, otherwise shm_open(name)
+* slot_num is rounded up to a power of 2, msg_max is the largest message
+*/
+struct shm_mpsc *shm_mpsc_create(const char *name, unsigned long slot_num, unsigned long msg_max);
+struct shm_mpsc *shm_mpsc_open(const char *name);
+void shm_mpsc_close(struct shm_mpsc *q);
+
+/*
+* producers: blocks while the queue is full, -1 if len > msg_max
+*/
+int shm_mpsc_send(struct shm_mpsc *q, const void *buf, unsigned long len);
+/*
+* no more messages will be sent, called after all producers are done
+*/
+void shm_mpsc_shutdown(struct shm_mpsc *q);
+
+/*
+* consumer: blocks until at least one message is published, fills up to max messages in place,
+* returns the number filled, 0 after shutdown when everything is drained
+* release gives all the slots of the last batch back to the producers
+*/
+int shm_mpsc_recv_batch(struct shm_mpsc *q, struct shm_mpsc_msg *msgs, int max);
+void shm_mpsc_release(struct shm_mpsc *q);
+
+#endif
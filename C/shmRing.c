@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shmFutex.h"
+#include "shmRing.h"
+
+/*
+* every record starts with an 8 bytes header and is padded to 8 bytes,
+* a record that does not fit before the end of the data area is preceded by a pad record up to the end
+*/
+
+#define REC_MSG 0
+#define REC_PAD 1
+
+struct rec_hdr
+{
+	unsigned int len;
+	unsigned int type;
+};
+
+static unsigned long rec_len(unsigned long len)
+{
+	return sizeof(struct rec_hdr) + ((len + 7) & ~7UL);
+}
+
+static struct shm_ring *ring_map(int fd, unsigned long capacity)
+{
+	struct shm_ring *r = (struct shm_ring *)calloc(1, sizeof(struct shm_ring));
+	if (r == NULL)
+		return NULL;
+	r->fd = fd;
+	r->map_len = SHM_RING_HDR_LEN + capacity;
+	r->hdr = (struct shm_ring_hdr *)mmap(NULL, r->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (r->hdr == MAP_FAILED)
+	{
+		free(r);
+		return NULL;
+	}
+	r->data = (char *)r->hdr + SHM_RING_HDR_LEN;
+	return r;
+}
+
+struct shm_ring *shm_ring_create(const char *name, unsigned long capacity)
+{
+	struct shm_ring *r;
+	unsigned long cap = 4096;
+	int fd;
+	while (cap < capacity)
+		cap <<= 1;
+	if (name == NULL)
+		fd = memfd_create("shm_ring", MFD_CLOEXEC);
+	else
+		fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		return NULL;
+	if (ftruncate(fd, SHM_RING_HDR_LEN + cap) < 0 || (r = ring_map(fd, cap)) == NULL)
+	{
+		close(fd);
+		return NULL;
+	}
+	memset(r->hdr, 0x0, sizeof(struct shm_ring_hdr));
+	r->hdr->capacity = cap;
+	atomic_store(&r->hdr->head, 0);
+	atomic_store(&r->hdr->tail, 0);
+	r->hdr->magic = SHM_RING_MAGIC;
+	return r;
+}
+
+struct shm_ring *shm_ring_open(const char *name)
+{
+	struct shm_ring_hdr hdr;
+	struct shm_ring *r;
+	int fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0)
+		return NULL;
+	if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || hdr.magic != SHM_RING_MAGIC || (r = ring_map(fd, hdr.capacity)) == NULL)
+	{
+		close(fd);
+		return NULL;
+	}
+	return r;
+}
+
+void shm_ring_close(struct shm_ring *r)
+{
+	munmap(r->hdr, r->map_len);
+	close(r->fd);
+	free(r);
+}
+
+unsigned long shm_ring_max_msg(const struct shm_ring *r)
+{
+	return r->hdr->capacity / 2 - sizeof(struct rec_hdr);
+}
+
+void *shm_ring_reserve(struct shm_ring *r, unsigned long len)
+{
+	struct shm_ring_hdr *h = r->hdr;
+	unsigned long cap = h->capacity, need = rec_len(len), off, room, total;
+	struct rec_hdr *rec;
+	if (len > shm_ring_max_msg(r))
+		return NULL;
+	off = r->pos & (cap - 1);
+	room = cap - off;
+	total = need + (room < need ? room : 0);
+	// r->other caches the consumer's tail, reload it only when the ring looks full
+	if (cap - (r->pos - r->other) < total)
+		SHM_WAIT(cap - (r->pos - (r->other = atomic_load(&h->tail))) >= total, &h->prod_wait);
+	if (room < need)
+	{
+		rec = (struct rec_hdr *)(r->data + off);
+		rec->len = room - sizeof(struct rec_hdr);
+		rec->type = REC_PAD;
+		r->pos += room;
+		off = 0;
+	}
+	rec = (struct rec_hdr *)(r->data + off);
+	rec->len = len;
+	rec->type = REC_MSG;
+	r->pending = need;
+	return rec + 1;
+}
+
+void shm_ring_commit(struct shm_ring *r)
+{
+	struct shm_ring_hdr *h = r->hdr;
+	r->pos += r->pending;
+	r->pending = 0;
+	// seq_cst store pairs with the consumer's store to cons_wait before it rechecks head
+	atomic_store(&h->head, r->pos);
+	shm_wake(&h->cons_wait, 1);
+}
+
+int shm_ring_send(struct shm_ring *r, const void *buf, unsigned long len)
+{
+	void *p = shm_ring_reserve(r, len);
+	if (p == NULL)
+		return -1;
+	memcpy(p, buf, len);
+	shm_ring_commit(r);
+	return 0;
+}
+
+void shm_ring_shutdown(struct shm_ring *r)
+{
+	struct shm_ring_hdr *h = r->hdr;
+	__atomic_store_n(&h->closed, 1, __ATOMIC_SEQ_CST);
+	atomic_store(&h->cons_wait, 0);
+	futex_wake(&h->cons_wait, 1);
+}
+
+void *shm_ring_peek(struct shm_ring *r, unsigned long *p_len)
+{
+	struct shm_ring_hdr *h = r->hdr;
+	struct rec_hdr *rec;
+	for (;;)
+	{
+		if (r->pos == r->other)
+			SHM_WAIT((r->other = atomic_load(&h->head)) != r->pos || __atomic_load_n(&h->closed, __ATOMIC_SEQ_CST), &h->cons_wait);
+		// closed is set after the last commit, so head is final here
+		if (r->pos == r->other && (r->other = atomic_load(&h->head)) == r->pos)
+			return NULL;
+		rec = (struct rec_hdr *)(r->data + (r->pos & (h->capacity - 1)));
+		if (rec->type == REC_MSG)
+			break;
+		r->pos += sizeof(struct rec_hdr) + rec->len;
+	}
+	r->pending = rec_len(rec->len);
+	*p_len = rec->len;
+	return rec + 1;
+}
+
+void shm_ring_release(struct shm_ring *r)
+{
+	struct shm_ring_hdr *h = r->hdr;
+	r->pos += r->pending;
+	r->pending = 0;
+	atomic_store(&h->tail, r->pos);
+	shm_wake(&h->prod_wait, 1);
+}
+
+long shm_ring_recv(struct shm_ring *r, void *buf, unsigned long cap)
+{
+	unsigned long len;
+	void *p = shm_ring_peek(r, &len);
+	if (p == NULL)
+		return -1;
+	if (len > cap)
+		len = cap;
+	memcpy(buf, p, len);
+	shm_ring_release(r);
+	return len;
+}
@@ -0,0 +1,72 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+/*
+* single producer single consumer message ring in shared memory
+* the ring lives in a memfd (inherited by fork) or a named shm_open object (for unrelated processes),
+* messages are variable length records written in place, both sides spin a little then sleep on a futex
+* build with: gcc -O2 yourProgram.c shmRing.c
+*/
+
+#include <stdatomic.h>
+
+#define SHM_RING_MAGIC 0x52494e47
+// header takes a whole page so that the data area is page aligned
+#define SHM_RING_HDR_LEN 4096
+
+struct shm_ring_hdr
+{
+	unsigned int magic;
+	unsigned int closed;
+	unsigned long capacity;
+	// producer and consumer positions never wrap, offset in data is pos & (capacity - 1)
+	_Atomic unsigned long head __attribute__((aligned(64)));
+	_Atomic unsigned long tail __attribute__((aligned(64)));
+	// futex words, set to 1 by a side before it sleeps
+	_Atomic unsigned int prod_wait __attribute__((aligned(64)));
+	_Atomic unsigned int cons_wait;
+};
+
+/*
+* process local handle, after fork each process has its own copy
+*/
+struct shm_ring
+{
+	struct shm_ring_hdr *hdr;
+	char *data;
+	int fd;
+	unsigned long map_len;
+	// the producer's head or the consumer's tail, and the last seen position of the other side
+	unsigned long pos;
+	unsigned long other;
+	// record length of the pending reserve or peek
+	unsigned long pending;
+};
+
+/*
+* name NULL creates an anonymous memfd ring to be shared by fork, otherwise shm_open(name)
+* capacity is rounded up to a power of 2, a message can take at most half of it
+*/
+struct shm_ring *shm_ring_create(const char *name, unsigned long capacity);
+struct shm_ring *shm_ring_open(const char *name);
+void shm_ring_close(struct shm_ring *r);
+unsigned long shm_ring_max_msg(const struct shm_ring *r);
+
+/*
+* producer side: reserve blocks until len bytes are free and returns where to write, commit publishes it
+* shutdown tells the consumer that no more messages will come
+*/
+void *shm_ring_reserve(struct shm_ring *r, unsigned long len);
+void shm_ring_commit(struct shm_ring *r);
+int shm_ring_send(struct shm_ring *r, const void *buf, unsigned long len);
+void shm_ring_shutdown(struct shm_ring *r);
+
+/*
+* consumer side: peek blocks until a message arrives and returns it in place, NULL after shutdown
+* release gives its space back to the producer
+*/
+void *shm_ring_peek(struct shm_ring *r, unsigned long *p_len);
+void shm_ring_release(struct shm_ring *r);
+long shm_ring_recv(struct shm_ring *r, void *buf, unsigned long cap);
+
+#endif
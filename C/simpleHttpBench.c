@@ -1,6 +1,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <pthread.h>
@@ -10,6 +11,27 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <errno.h>
+
+/*
+* 请求分为几个阶段分别统计耗时和失败：
+* connect     三次握手完成（SYN backlog满、端口耗尽等都体现在这里）
+* first byte  writev之后收到第一个字节（服务端处理耗时）
+* last byte   收到最后一个字节，即对端关闭连接（payload传输耗时）
+* 失败按阶段和errno分类计数，便于tps下降时定位原因
+*/
+
+enum phase { PH_CONNECT = 0, PH_SEND, PH_RECV, PH_KEY, PH_NUM };
+static const char *phaseName[PH_NUM] = { "connect", "writev", "recv", "key" };
+
+enum errClass { EC_REFUSED = 0, EC_TIMEOUT, EC_RESET, EC_NOADDR, EC_AGAIN, EC_PIPE, EC_EOF, EC_NOMATCH, EC_OTHER, EC_NUM };
+static const char *errClassName[EC_NUM] = { "refused", "timeout", "reset", "noaddr", "again", "pipe", "eof", "nomatch", "other" };
+
+enum latPhase { LAT_CONNECT = 0, LAT_FIRST, LAT_LAST, LAT_NUM };
+static const char *latName[LAT_NUM] = { "connect", "first byte", "last byte" };
+
+// 延迟直方图，按微秒取log2分桶，桶i覆盖[2^(i-1), 2^i)us
+#define LAT_BUCKETS 32
 
 static int threadNum = 0;
 static char *srvIp = NULL;
@@ -17,27 +39,131 @@ static char *srvPort = NULL;
 static char *key = NULL;
 static long success = 0;
 static long fail = 0;
+static long failCnt[PH_NUM][EC_NUM];
+static long latHist[LAT_NUM][LAT_BUCKETS];
+static long latSum[LAT_NUM];
 static struct sockaddr_in srvAddr;
 static char send_data_1[] = "GET /hello HTTTP/1.1\nHost:";
 static char send_data_2[] = "\nConnection:close\nContent-Length:0\n\n\r\n\r\n";
 
+static long nowUs()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000L + tv.tv_usec;
+}
+
+static int classify(int err)
+{
+  switch (err)
+  {
+    case ECONNREFUSED:
+      return EC_REFUSED;
+    case ETIMEDOUT:
+      return EC_TIMEOUT;
+    case ECONNRESET:
+    case ECONNABORTED:
+      return EC_RESET;
+    case EADDRNOTAVAIL:
+    case EADDRINUSE:
+      return EC_NOADDR;
+    case EAGAIN:
+    case EINPROGRESS:
+      return EC_AGAIN;
+    case EPIPE:
+      return EC_PIPE;
+    default:
+      return EC_OTHER;
+  }
+}
+
+static void recordFail(int ph, int ec)
+{
+  __sync_fetch_and_add(&failCnt[ph][ec], 1);
+  __sync_fetch_and_add(&fail, 1);
+}
+
+static void recordLat(int lp, long us)
+{
+  int b = 0;
+  long v = us;
+  while (v > 0 && b < LAT_BUCKETS - 1)
+  {
+    v >>= 1;
+    b++;
+  }
+  __sync_fetch_and_add(&latHist[lp][b], 1);
+  __sync_fetch_and_add(&latSum[lp], us);
+}
+
+// 返回直方图中百分位pct所在桶的上界（微秒）
+static long percentile(long *hist, long total, int pct)
+{
+  int b;
+  long acc = 0, target = (total * pct + 99) / 100;
+  for (b = 0; b < LAT_BUCKETS; b++)
+  {
+    acc += hist[b];
+    if (acc >= target)
+      return 1L << b;
+  }
+  return 1L << (LAT_BUCKETS - 1);
+}
+
 void *print(void *arg)
 {
-  long start, end;
+  long start, end, total;
+  long prevHist[LAT_NUM][LAT_BUCKETS], curHist[LAT_NUM][LAT_BUCKETS], diff[LAT_BUCKETS];
+  long prevSum[LAT_NUM], curSum[LAT_NUM];
+  long prevFail[PH_NUM][EC_NUM], curFail[PH_NUM][EC_NUM];
+  int lp, ph, ec, b;
+  memset(prevHist, 0x0, sizeof(prevHist));
+  memset(prevSum, 0x0, sizeof(prevSum));
+  memset(prevFail, 0x0, sizeof(prevFail));
   for (;;)
   {
     start = success;
     usleep(4000000);
     end = success;
-    printf("total success=%ld, fail=%ld, tps=%d, errRate=%.2f%%\n", success, fail, (end - start) >> 2, 100 * fail / (success + fail));
+    total = success + fail;
+    printf("total success=%ld, fail=%ld, tps=%ld, errRate=%.2f%%\n", success, fail, (end - start) >> 2, total > 0 ? 100.0 * fail / total : 0.0);
+    memcpy(curHist, latHist, sizeof(curHist));
+    memcpy(curSum, latSum, sizeof(curSum));
+    memcpy(curFail, failCnt, sizeof(curFail));
+    for (lp = 0; lp < LAT_NUM; lp++)
+    {
+      long n = 0;
+      for (b = 0; b < LAT_BUCKETS; b++)
+      {
+        diff[b] = curHist[lp][b] - prevHist[lp][b];
+        n += diff[b];
+      }
+      if (n == 0)
+        continue;
+      printf("  %-10s n=%ld avg=%ldus p50<%ldus p99<%ldus\n", latName[lp], n, (curSum[lp] - prevSum[lp]) / n, percentile(diff, n, 50), percentile(diff, n, 99));
+    }
+    for (ph = 0; ph < PH_NUM; ph++)
+    {
+      for (ec = 0; ec < EC_NUM; ec++)
+      {
+        if (curFail[ph][ec] != prevFail[ph][ec])
+          printf("  fail %s/%s +%ld (total %ld)\n", phaseName[ph], errClassName[ec], curFail[ph][ec] - prevFail[ph][ec], curFail[ph][ec]);
+      }
+    }
+    memcpy(prevHist, curHist, sizeof(prevHist));
+    memcpy(prevSum, curSum, sizeof(prevSum));
+    memcpy(prevFail, curFail, sizeof(prevFail));
   }
 }
 
 void *work(void *arg)
 {
   int sfd = -1;
-  char buffer[1024];
+  char buffer[4096];
   char *res = NULL;
+  ssize_t n;
+  size_t got;
+  long t0, t1;
   
   struct iovec iov[5];
   iov[0].iov_base = send_data_1;
@@ -60,28 +186,58 @@ void *work(void *arg)
       printf("create socket failed\n");
       exit(1);
     }
+    t0 = nowUs();
     if ((connect(sfd, (struct sockaddr *)(&srvAddr), sizeof(struct sockaddr))) < 0)
     {
-      __sync_fetch_and_add(&fail, 1);
+      recordFail(PH_CONNECT, classify(errno));
+      close(sfd);
       continue;
     }
+    t1 = nowUs();
+    recordLat(LAT_CONNECT, t1 - t0);
     if ((writev(sfd, iov, 5)) < 0)
     {
+      recordFail(PH_SEND, classify(errno));
       close(sfd);
-      __sync_fetch_and_add(&fail, 1);
       continue;
     }
-    if ((recv(sfd, buffer, 1024, 0)) < 0)
+    t0 = nowUs();
+    if ((n = recv(sfd, buffer, sizeof(buffer) - 1, 0)) <= 0)
+    {
+      recordFail(PH_RECV, n == 0 ? EC_EOF : classify(errno));
+      close(sfd);
+      continue;
+    }
+    recordLat(LAT_FIRST, nowUs() - t0);
+    // Connection:close，读到对端关闭为止；key只在前sizeof(buffer)-1字节中匹配
+    got = n;
+    for (;;)
+    {
+      if (got < sizeof(buffer) - 1)
+        n = recv(sfd, buffer + got, sizeof(buffer) - 1 - got, 0);
+      else
+      {
+        char drain[4096];
+        n = recv(sfd, drain, sizeof(drain), 0);
+      }
+      if (n <= 0)
+        break;
+      if (got < sizeof(buffer) - 1)
+        got += n;
+    }
+    if (n < 0)
     {
+      recordFail(PH_RECV, classify(errno));
       close(sfd);
-      __sync_fetch_and_add(&fail, 1);
       continue;
     }
+    recordLat(LAT_LAST, nowUs() - t0);
+    buffer[got] = '\0';
     res = strstr(buffer, key);
     if (NULL == res)
     {
+      recordFail(PH_KEY, EC_NOMATCH);
       close(sfd);
-      __sync_fetch_and_add(&fail, 1);
       continue;
     }
     close(sfd);
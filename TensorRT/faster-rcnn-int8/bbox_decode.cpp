@@ -0,0 +1,210 @@
+#include "bbox_decode.h"
+#include "postprocess.h"
+#include <cmath>
+
+// exp(x) = 2^n * exp(r), n = round(x / ln2), r = x - n * ln2 in [-ln2/2, ln2/2], exp(r) by a degree 6 polynomial (cephes expf)
+// x is clamped so that 2^n stays a normal float
+#define EXP_HI 88.0f
+#define EXP_LO -87.0f
+#define LOG2E 1.44269504088896341f
+#define LN2_HI 0.693359375f
+#define LN2_LO -2.12194440e-4f
+#define EXP_P0 1.9875691500E-4f
+#define EXP_P1 1.3981999507E-3f
+#define EXP_P2 8.3334519073E-3f
+#define EXP_P3 4.1665795894E-2f
+#define EXP_P4 1.6666665459E-1f
+#define EXP_P5 5.0000001201E-1f
+
+__attribute__((target("avx2,fma"))) static inline __m256 exp8(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_HI), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_LO), r);
+    __m256 p = _mm256_set1_ps(EXP_P0);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P1));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P2));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P3));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P4));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P5));
+    p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.f)));
+    // 2^n built in the exponent field
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+__attribute__((target("avx512f"))) static inline __m512 exp16(__m512 x)
+{
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_LO)), _mm512_set1_ps(EXP_HI));
+    __m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(LN2_HI), x);
+    r = _mm512_fnmadd_ps(n, _mm512_set1_ps(LN2_LO), r);
+    __m512 p = _mm512_set1_ps(EXP_P0);
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P1));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P2));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P3));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P4));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P5));
+    p = _mm512_fmadd_ps(p, _mm512_mul_ps(r, r), _mm512_add_ps(r, _mm512_set1_ps(1.f)));
+    return _mm512_scalef_ps(p, n);
+}
+
+/*
+ * rows are 4 floats, 4 rows per 128 bit lane: lane g of m[k] holds row 4g + k,
+ * the unpack / shuffle pair turns them into one register per column with the rows in order
+ */
+#define TRANSPOSE_IN(unpacklo, unpackhi, shuffle, m, c0, c1, c2, c3) \
+    { \
+	auto t0_ = unpacklo(m[0], m[1]), t1_ = unpackhi(m[0], m[1]), t2_ = unpacklo(m[2], m[3]), t3_ = unpackhi(m[2], m[3]); \
+	c0 = shuffle(t0_, t2_, _MM_SHUFFLE(1, 0, 1, 0)); \
+	c1 = shuffle(t0_, t2_, _MM_SHUFFLE(3, 2, 3, 2)); \
+	c2 = shuffle(t1_, t3_, _MM_SHUFFLE(1, 0, 1, 0)); \
+	c3 = shuffle(t1_, t3_, _MM_SHUFFLE(3, 2, 3, 2)); \
+    }
+
+/*
+ * the way back, m[k] gets rows k, 4 + k, ... in its lanes
+ */
+#define TRANSPOSE_OUT(unpacklo, unpackhi, shuffle, c0, c1, c2, c3, m) \
+    { \
+	auto t0_ = unpacklo(c0, c1), t1_ = unpackhi(c0, c1), t2_ = unpacklo(c2, c3), t3_ = unpackhi(c2, c3); \
+	m[0] = shuffle(t0_, t2_, _MM_SHUFFLE(1, 0, 1, 0)); \
+	m[1] = shuffle(t0_, t2_, _MM_SHUFFLE(3, 2, 3, 2)); \
+	m[2] = shuffle(t1_, t3_, _MM_SHUFFLE(1, 0, 1, 0)); \
+	m[3] = shuffle(t1_, t3_, _MM_SHUFFLE(3, 2, 3, 2)); \
+    }
+
+// 8 rois of one image starting at rois, all classes
+__attribute__((target("avx2,fma"))) static void decode8(const float* rois, const float* deltas, float* pred, float imH, float imW, int numCls)
+{
+    const int stride = numCls * 4;
+    const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.f), zero = _mm256_setzero_ps();
+    const __m256 maxX = _mm256_set1_ps(imW - 1.f), maxY = _mm256_set1_ps(imH - 1.f);
+    __m256 m[4], x1, y1, x2, y2, dx, dy, dw, dh;
+    for (int k = 0; k < 4; ++k)
+	m[k] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(rois + k * 4)), _mm_loadu_ps(rois + (k + 4) * 4), 1);
+    TRANSPOSE_IN(_mm256_unpacklo_ps, _mm256_unpackhi_ps, _mm256_shuffle_ps, m, x1, y1, x2, y2);
+    __m256 width = _mm256_add_ps(_mm256_sub_ps(x2, x1), one), height = _mm256_add_ps(_mm256_sub_ps(y2, y1), one);
+    __m256 ctrX = _mm256_fmadd_ps(half, width, x1), ctrY = _mm256_fmadd_ps(half, height, y1);
+    for (int j = 0; j < numCls; ++j)
+    {
+	const float* d = deltas + j * 4;
+	for (int k = 0; k < 4; ++k)
+	    m[k] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(d + k * stride)), _mm_loadu_ps(d + (k + 4) * stride), 1);
+	TRANSPOSE_IN(_mm256_unpacklo_ps, _mm256_unpackhi_ps, _mm256_shuffle_ps, m, dx, dy, dw, dh);
+	__m256 predCtrX = _mm256_fmadd_ps(dx, width, ctrX), predCtrY = _mm256_fmadd_ps(dy, height, ctrY);
+	__m256 halfW = _mm256_mul_ps(_mm256_mul_ps(exp8(dw), width), half), halfH = _mm256_mul_ps(_mm256_mul_ps(exp8(dh), height), half);
+	x1 = _mm256_max_ps(_mm256_min_ps(_mm256_sub_ps(predCtrX, halfW), maxX), zero);
+	y1 = _mm256_max_ps(_mm256_min_ps(_mm256_sub_ps(predCtrY, halfH), maxY), zero);
+	x2 = _mm256_max_ps(_mm256_min_ps(_mm256_add_ps(predCtrX, halfW), maxX), zero);
+	y2 = _mm256_max_ps(_mm256_min_ps(_mm256_add_ps(predCtrY, halfH), maxY), zero);
+	TRANSPOSE_OUT(_mm256_unpacklo_ps, _mm256_unpackhi_ps, _mm256_shuffle_ps, x1, y1, x2, y2, m);
+	float* p = pred + j * 4;
+	for (int k = 0; k < 4; ++k)
+	{
+	    _mm_storeu_ps(p + k * stride, _mm256_castps256_ps128(m[k]));
+	    _mm_storeu_ps(p + (k + 4) * stride, _mm256_extractf128_ps(m[k], 1));
+	}
+    }
+}
+
+__attribute__((target("avx512f"))) static inline __m512 load4x128(const float* p, int step)
+{
+    __m512 v = _mm512_castps128_ps512(_mm_loadu_ps(p));
+    v = _mm512_insertf32x4(v, _mm_loadu_ps(p + step), 1);
+    v = _mm512_insertf32x4(v, _mm_loadu_ps(p + 2 * step), 2);
+    return _mm512_insertf32x4(v, _mm_loadu_ps(p + 3 * step), 3);
+}
+
+// 16 rois of one image starting at rois, all classes
+__attribute__((target("avx512f"))) static void decode16(const float* rois, const float* deltas, float* pred, float imH, float imW, int numCls)
+{
+    const int stride = numCls * 4;
+    const __m512 half = _mm512_set1_ps(0.5f), one = _mm512_set1_ps(1.f), zero = _mm512_setzero_ps();
+    const __m512 maxX = _mm512_set1_ps(imW - 1.f), maxY = _mm512_set1_ps(imH - 1.f);
+    __m512 m[4], x1, y1, x2, y2, dx, dy, dw, dh;
+    for (int k = 0; k < 4; ++k)
+	m[k] = load4x128(rois + k * 4, 16);
+    TRANSPOSE_IN(_mm512_unpacklo_ps, _mm512_unpackhi_ps, _mm512_shuffle_ps, m, x1, y1, x2, y2);
+    __m512 width = _mm512_add_ps(_mm512_sub_ps(x2, x1), one), height = _mm512_add_ps(_mm512_sub_ps(y2, y1), one);
+    __m512 ctrX = _mm512_fmadd_ps(half, width, x1), ctrY = _mm512_fmadd_ps(half, height, y1);
+    for (int j = 0; j < numCls; ++j)
+    {
+	const float* d = deltas + j * 4;
+	for (int k = 0; k < 4; ++k)
+	    m[k] = load4x128(d + k * stride, 4 * stride);
+	TRANSPOSE_IN(_mm512_unpacklo_ps, _mm512_unpackhi_ps, _mm512_shuffle_ps, m, dx, dy, dw, dh);
+	__m512 predCtrX = _mm512_fmadd_ps(dx, width, ctrX), predCtrY = _mm512_fmadd_ps(dy, height, ctrY);
+	__m512 halfW = _mm512_mul_ps(_mm512_mul_ps(exp16(dw), width), half), halfH = _mm512_mul_ps(_mm512_mul_ps(exp16(dh), height), half);
+	x1 = _mm512_max_ps(_mm512_min_ps(_mm512_sub_ps(predCtrX, halfW), maxX), zero);
+	y1 = _mm512_max_ps(_mm512_min_ps(_mm512_sub_ps(predCtrY, halfH), maxY), zero);
+	x2 = _mm512_max_ps(_mm512_min_ps(_mm512_add_ps(predCtrX, halfW), maxX), zero);
+	y2 = _mm512_max_ps(_mm512_min_ps(_mm512_add_ps(predCtrY, halfH), maxY), zero);
+	TRANSPOSE_OUT(_mm512_unpacklo_ps, _mm512_unpackhi_ps, _mm512_shuffle_ps, x1, y1, x2, y2, m);
+	float* p = pred + j * 4;
+	for (int k = 0; k < 4; ++k)
+	{
+	    _mm_storeu_ps(p + k * stride, _mm512_castps512_ps128(m[k]));
+	    _mm_storeu_ps(p + (k + 4) * stride, _mm512_extractf32x4_ps(m[k], 1));
+	    _mm_storeu_ps(p + (k + 8) * stride, _mm512_extractf32x4_ps(m[k], 2));
+	    _mm_storeu_ps(p + (k + 12) * stride, _mm512_extractf32x4_ps(m[k], 3));
+	}
+    }
+}
+
+void bboxDecode(int isa, const float* rois, const float* deltas, float* predBBoxes, const float* imInfo, const int N, const int nmsMaxOut, const int numCls)
+{
+    const int block = isa == ISA_AVX512 ? 16 : (isa == ISA_AVX2 ? 8 : 1);
+    const int stride = numCls * 4;
+    for (int i = 0; i < N; ++i)
+    {
+	const float* r = rois + size_t(i) * nmsMaxOut * 4;
+	const float* d = deltas + size_t(i) * nmsMaxOut * stride;
+	float* p = predBBoxes + size_t(i) * nmsMaxOut * stride;
+	int k = 0;
+	for (; block > 1 && k + block <= nmsMaxOut; k += block)
+	{
+	    if (isa == ISA_AVX512)
+		decode16(r + k * 4, d + k * stride, p + k * stride, imInfo[i * 3], imInfo[i * 3 + 1], numCls);
+	    else
+		decode8(r + k * 4, d + k * stride, p + k * stride, imInfo[i * 3], imInfo[i * 3 + 1], numCls);
+	}
+	if (k < nmsMaxOut)
+	    bboxTransformInvAndClip(r + k * 4, d + k * stride, p + k * stride, imInfo + i * 3, 1, nmsMaxOut - k, numCls);
+    }
+}
+
+void bboxDecode(const float* rois, const float* deltas, float* predBBoxes, const float* imInfo, const int N, const int nmsMaxOut, const int numCls)
+{
+    bboxDecode(bestIsa(), rois, deltas, predBBoxes, imInfo, N, nmsMaxOut, numCls);
+}
+
+__attribute__((target("avx2,fma"))) static void fastExp8(const float* in, float* out, int n)
+{
+    for (int i = 0; i + 8 <= n; i += 8)
+	_mm256_storeu_ps(out + i, exp8(_mm256_loadu_ps(in + i)));
+}
+
+__attribute__((target("avx512f"))) static void fastExp16(const float* in, float* out, int n)
+{
+    for (int i = 0; i + 16 <= n; i += 16)
+	_mm512_storeu_ps(out + i, exp16(_mm512_loadu_ps(in + i)));
+}
+
+void bboxFastExp(int isa, const float* in, float* out, int n)
+{
+    int done = 0;
+    if (isa == ISA_AVX512)
+    {
+	fastExp16(in, out, n);
+	done = n / 16 * 16;
+    }
+    else if (isa == ISA_AVX2)
+    {
+	fastExp8(in, out, n);
+	done = n / 8 * 8;
+    }
+    for (int i = done; i < n; ++i)
+	out[i] = exp(in[i]);
+}
@@ -0,0 +1,20 @@
+#ifndef _BBOX_DECODE_H_
+#define _BBOX_DECODE_H_
+
+/*
+ * bboxTransformInvAndClip with AVX2 (8 rois at once) and AVX-512 (16 rois at once) kernels, chosen at runtime
+ * a block of rois is transposed into struct of arrays registers (x1[], y1[], ... / dx[], dy[], ...) per class,
+ * decoded with a polynomial exp (max relative error about 1e-7, a couple of float ulps) and transposed back
+ * the rois of an image that do not fill a whole block go through the scalar code
+ */
+
+#include "cpu_isa.h"
+
+// same arguments as bboxTransformInvAndClip, isa (cpu_isa.h) must not be wider than bestIsa()
+void bboxDecode(int isa, const float* rois, const float* deltas, float* predBBoxes, const float* imInfo, const int N, const int nmsMaxOut, const int numCls);
+void bboxDecode(const float* rois, const float* deltas, float* predBBoxes, const float* imInfo, const int N, const int nmsMaxOut, const int numCls);
+
+// the exp the kernels use, exposed for the accuracy test
+void bboxFastExp(int isa, const float* in, float* out, int n);
+
+#endif
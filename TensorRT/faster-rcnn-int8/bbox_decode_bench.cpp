@@ -0,0 +1,100 @@
+#include "bbox_decode.h"
+#include "postprocess.h"
+#include "stream.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+/*
+ * accuracy and throughput of the bbox decoding kernels against bboxTransformInvAndClip
+ *   exp: max relative error of the vector exp over [-10, 10] and over its whole clamp range
+ *   decode: max coordinate difference in pixels against the scalar function on the same tensors
+ *   speed: decoded boxes (roi x class) per second
+ * exits with 1 if a kernel is off by more than 1e-5 relative in exp or 0.01 pixel in a box
+ * build: g++ -O2 -std=c++11 -pthread bbox_decode_bench.cpp bbox_decode.cpp cpu_isa.cpp postprocess.cpp nms.cpp -o bbox_decode_bench
+ * usage: ./bbox_decode_bench [-f tensorFile] [-n images] [-i iterations]
+ */
+
+static double expError(int isa, float lo, float hi)
+{
+    const int n = 1 << 20;
+    std::vector<float> in(n), out(n);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uni(lo, hi);
+    double maxErr = 0;
+    for (int i = 0; i < n; ++i)
+	in[i] = uni(rng);
+    bboxFastExp(isa, in.data(), out.data(), n);
+    for (int i = 0; i < n; ++i)
+    {
+	double ref = std::exp(double(in[i]));
+	maxErr = std::max(maxErr, std::fabs(out[i] - ref) / ref);
+    }
+    return maxErr;
+}
+
+int main(int argc, char* argv[])
+{
+    DetectionTensors t;
+    std::string file;
+    int images = 64, iterations = 20;
+    for (int i = 1; i < argc; ++i)
+    {
+	if (!strcmp(argv[i], "-f") && i + 1 < argc)
+	    file = argv[++i];
+	else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+	    images = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-i") && i + 1 < argc)
+	    iterations = atoi(argv[++i]);
+	else
+	{
+	    std::cout << "usage: " << argv[0] << " [-f tensorFile] [-n images] [-i iterations]" << std::endl;
+	    return 1;
+	}
+    }
+    if (!file.empty())
+    {
+	if (!t.load(file))
+	{
+	    std::cout << "can not load tensors from " << file << std::endl;
+	    return 1;
+	}
+    }
+    else
+	t.synthesize(images, 300, 21, 1);
+    std::cout << t.N << " images x " << t.nmsMaxOut << " rois x " << t.numCls << " classes, best isa " << isaName(bestIsa()) << std::endl;
+
+    size_t boxes = size_t(t.N) * t.nmsMaxOut * t.numCls;
+    std::vector<float> ref(boxes * 4), pred(boxes * 4);
+    double start = streamNowMs();
+    for (int it = 0; it < iterations; ++it)
+	bboxTransformInvAndClip(t.rois.data(), t.bboxPreds.data(), ref.data(), t.imInfo.data(), t.N, t.nmsMaxOut, t.numCls);
+    double scalarMs = (streamNowMs() - start) / iterations;
+    bool bad = false;
+    printf("%-8s %12s %12s %12s %12s %8s\n", "isa", "exp err", "exp err all", "max diff px", "Mboxes/s", "speedup");
+    printf("%-8s %12s %12s %12s %12.1f %8.2f\n", "libm", "-", "-", "-", boxes / scalarMs / 1000, 1.0);
+    for (int isa = ISA_SCALAR; isa <= bestIsa(); ++isa)
+    {
+	double err = expError(isa, -10.f, 10.f), errAll = expError(isa, -87.f, 88.f), diff = 0;
+	std::fill(pred.begin(), pred.end(), -1.f);
+	bboxDecode(isa, t.rois.data(), t.bboxPreds.data(), pred.data(), t.imInfo.data(), t.N, t.nmsMaxOut, t.numCls);
+	for (size_t k = 0; k < pred.size(); ++k)
+	    diff = std::max(diff, double(std::fabs(pred[k] - ref[k])));
+	start = streamNowMs();
+	for (int it = 0; it < iterations; ++it)
+	    bboxDecode(isa, t.rois.data(), t.bboxPreds.data(), pred.data(), t.imInfo.data(), t.N, t.nmsMaxOut, t.numCls);
+	double ms = (streamNowMs() - start) / iterations;
+	printf("%-8s %12.3g %12.3g %12.3g %12.1f %8.2f\n", isaName(isa), err, errAll, diff, boxes / ms / 1000, scalarMs / ms);
+	bad = bad || err > 1e-5 || errAll > 1e-5 || diff > 0.01;
+    }
+    if (bad)
+    {
+	std::cout << "a kernel is out of its error bound" << std::endl;
+	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "buffer_pool.h"
+#include <cassert>
+#include <cstdlib>
+
+static const size_t ALIGNMENT = 64;
+
+void* AlignedAllocator::allocate(size_t bytes)
+{
+    void* p = nullptr;
+    return posix_memalign(&p, ALIGNMENT, bytes ? bytes : ALIGNMENT) == 0 ? p : nullptr;
+}
+
+void AlignedAllocator::release(void* p)
+{
+    free(p);
+}
+
+BufferPool::Buffer& BufferPool::Buffer::operator=(Buffer&& o)
+{
+    if (this != &o)
+    {
+	reset();
+	mPool = o.mPool;
+	mBucket = o.mBucket;
+	mData = o.mData;
+	o.mData = nullptr;
+    }
+    return *this;
+}
+
+void BufferPool::Buffer::reset()
+{
+    if (mData)
+	mPool->giveBack(mBucket, mData);
+    mData = nullptr;
+}
+
+BufferPool::BufferPool(HostAllocator* allocator) : mAllocator(allocator ? allocator : &mDefault)
+{
+}
+
+BufferPool::~BufferPool()
+{
+    // a buffer still out would be freed under its holder
+    for (auto& b : mBuckets)
+	assert(b.second.live == 0), (void)b;
+    trim();
+}
+
+BufferPool::Buffer BufferPool::acquire(const BufferShape& shape)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    Bucket& bucket = mBuckets[shape];
+    bucket.shape = shape;
+    ++mStats.acquires;
+    float* data;
+    if (!bucket.idle.empty())
+    {
+	data = bucket.idle.back();
+	bucket.idle.pop_back();
+	mStats.idleBytes -= shape.volume() * sizeof(float);
+    }
+    else
+    {
+	// the idle list gets room for every buffer of the shape now, so giving them back never allocates
+	bucket.idle.reserve(bucket.live + 1);
+	++bucket.live;
+	lock.unlock();
+	data = static_cast<float*>(mAllocator->allocate(shape.volume() * sizeof(float)));
+	lock.lock();
+	if (!data)
+	{
+	    --bucket.live;
+	    return Buffer();
+	}
+	++mStats.allocations;
+	mStats.bytes += shape.volume() * sizeof(float);
+	return Buffer(this, &bucket, data);
+    }
+    ++bucket.live;
+    return Buffer(this, &bucket, data);
+}
+
+void BufferPool::giveBack(Bucket* bucket, float* data)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    --bucket->live;
+    bucket->idle.push_back(data);
+    mStats.idleBytes += bucket->shape.volume() * sizeof(float);
+}
+
+void BufferPool::trim()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& b : mBuckets)
+    {
+	size_t bytes = b.second.shape.volume() * sizeof(float);
+	for (float* p : b.second.idle)
+	{
+	    mAllocator->release(p);
+	    ++mStats.frees;
+	    mStats.bytes -= bytes;
+	    mStats.idleBytes -= bytes;
+	}
+	b.second.idle.clear();
+    }
+}
+
+BufferPoolStats BufferPool::stats()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
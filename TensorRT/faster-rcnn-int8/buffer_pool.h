@@ -0,0 +1,119 @@
+#ifndef _BUFFER_POOL_H_
+#define _BUFFER_POOL_H_
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// where the memory of a BufferPool comes from
+class HostAllocator
+{
+public:
+    virtual ~HostAllocator() {}
+    // at least 64 byte aligned, nullptr when out of memory
+    virtual void* allocate(size_t bytes) = 0;
+    virtual void release(void* p) = 0;
+    virtual const char* name() const = 0;
+};
+
+// plain pageable memory, aligned for the AVX-512 kernels
+class AlignedAllocator : public HostAllocator
+{
+public:
+    void* allocate(size_t bytes) override;
+    void release(void* p) override;
+    const char* name() const override { return "aligned"; }
+};
+
+// page locked memory of cudaMallocHost, cudaMemcpyAsync from and to it is a real DMA, in buffer_pool_cuda.cpp as it needs CUDA
+class PinnedAllocator : public HostAllocator
+{
+public:
+    void* allocate(size_t bytes) override;
+    void release(void* p) override;
+    const char* name() const override { return "pinned"; }
+};
+
+// NCHW, unused trailing dimensions stay 1
+struct BufferShape
+{
+    int n;
+    int c;
+    int h;
+    int w;
+
+    BufferShape(int n = 1, int c = 1, int h = 1, int w = 1) : n(n), c(c), h(h), w(w) {}
+    size_t volume() const { return size_t(n) * c * h * w; }
+    bool operator<(const BufferShape& o) const
+    {
+	return n != o.n ? n < o.n : c != o.c ? c < o.c : h != o.h ? h < o.h : w < o.w;
+    }
+};
+
+struct BufferPoolStats
+{
+    long acquires{ 0 };
+    long allocations{ 0 };  // calls to the allocator, flat once every shape was seen as often as it is used at once
+    long frees{ 0 };
+    size_t bytes{ 0 };      // held from the allocator, in use or idle
+    size_t idleBytes{ 0 };
+};
+
+/*
+ * float tensors reused across batches: every shape has its own list of idle buffers,
+ * acquire() takes one from the list of its shape or allocates it, the Buffer handle puts it back when it goes away
+ * once warm a batch neither calls the allocator nor the heap, the pool only frees memory on trim() and in its destructor
+ * thread safe, buffers must go back before the pool is destroyed
+ */
+class BufferPool
+{
+    struct Bucket
+    {
+	BufferShape shape;
+	std::vector<float*> idle;
+	int live{ 0 };
+    };
+public:
+    // move only handle of one buffer of the pool
+    class Buffer
+    {
+    public:
+	Buffer() {}
+	Buffer(Buffer&& o) : mPool(o.mPool), mBucket(o.mBucket), mData(o.mData) { o.mData = nullptr; }
+	Buffer& operator=(Buffer&& o);
+	Buffer(const Buffer&) = delete;
+	Buffer& operator=(const Buffer&) = delete;
+	~Buffer() { reset(); }
+	float* data() const { return mData; }
+	size_t size() const { return mData ? mBucket->shape.volume() : 0; }
+	size_t bytes() const { return size() * sizeof(float); }
+	// gives the memory back to the pool
+	void reset();
+    private:
+	friend class BufferPool;
+	Buffer(BufferPool* pool, Bucket* bucket, float* data) : mPool(pool), mBucket(bucket), mData(data) {}
+	BufferPool* mPool{ nullptr };
+	Bucket* mBucket{ nullptr };
+	float* mData{ nullptr };
+    };
+
+    // allocator is not owned, nullptr is an AlignedAllocator of the pool
+    explicit BufferPool(HostAllocator* allocator = nullptr);
+    ~BufferPool();
+    // data() is nullptr when the allocator fails
+    Buffer acquire(const BufferShape& shape);
+    // frees the idle buffers
+    void trim();
+    BufferPoolStats stats();
+    const char* allocatorName() const { return mAllocator->name(); }
+private:
+    void giveBack(Bucket* bucket, float* data);
+    AlignedAllocator mDefault;
+    HostAllocator* mAllocator;
+    std::mutex mMutex;
+    std::map<BufferShape, Bucket> mBuckets;
+    BufferPoolStats mStats;
+};
+
+#endif
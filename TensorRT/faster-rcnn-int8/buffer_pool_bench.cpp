@@ -0,0 +1,151 @@
+#include "buffer_pool.h"
+#include "stream.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+/*
+ * CPU only test of BufferPool with the tensors of a Faster R-CNN batch (data, im_info, rois, bbox_pred, cls_prob):
+ * after a warm up batch, a batch must neither call the allocator nor operator new, counted by replacing both here,
+ * then the time per batch of the pool against new[] / delete[] of the same tensors, each written once as inference would
+ * build: g++ -O2 -std=c++11 -pthread buffer_pool_bench.cpp buffer_pool.cpp -o buffer_pool_bench
+ * usage: ./buffer_pool_bench [-n batchSize] [-i iterations]
+ */
+
+static std::atomic<long> gNews{ 0 };
+
+void* operator new(size_t bytes)
+{
+    ++gNews;
+    void* p = malloc(bytes ? bytes : 1);
+    if (!p)
+	throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+// counts what the pool asks for
+class CountingAllocator : public AlignedAllocator
+{
+public:
+    void* allocate(size_t bytes) override
+    {
+	++allocations;
+	return AlignedAllocator::allocate(bytes);
+    }
+    long allocations{ 0 };
+};
+
+static const int INPUT_C = 3, INPUT_H = 375, INPUT_W = 500, NMS_MAX_OUT = 300, CLS_NUM = 21;
+
+// the tensors of one batch, written once
+static float poolBatch(BufferPool& pool, int n)
+{
+    BufferPool::Buffer data = pool.acquire(BufferShape{ n, INPUT_C, INPUT_H, INPUT_W });
+    BufferPool::Buffer imInfo = pool.acquire(BufferShape{ n, 3 });
+    BufferPool::Buffer rois = pool.acquire(BufferShape{ n, NMS_MAX_OUT, 4 });
+    BufferPool::Buffer bboxPreds = pool.acquire(BufferShape{ n, NMS_MAX_OUT, CLS_NUM * 4 });
+    BufferPool::Buffer clsProbs = pool.acquire(BufferShape{ n, NMS_MAX_OUT, CLS_NUM });
+    float sum = 0;
+    for (BufferPool::Buffer* b : { &data, &imInfo, &rois, &bboxPreds, &clsProbs })
+    {
+	memset(b->data(), 0, b->bytes());
+	sum += b->data()[b->size() - 1];
+    }
+    return sum;
+}
+
+static float newBatch(int n)
+{
+    size_t sizes[]{ size_t(n) * INPUT_C * INPUT_H * INPUT_W, size_t(n) * 3, size_t(n) * NMS_MAX_OUT * 4, size_t(n) * NMS_MAX_OUT * CLS_NUM * 4, size_t(n) * NMS_MAX_OUT * CLS_NUM };
+    float sum = 0;
+    for (size_t size : sizes)
+    {
+	float* p = new float[size];
+	memset(p, 0, size * sizeof(float));
+	sum += p[size - 1];
+	delete[] p;
+    }
+    return sum;
+}
+
+int main(int argc, char* argv[])
+{
+    int batchSize = 5, iterations = 200;
+    for (int i = 1; i < argc; ++i)
+    {
+	if (!strcmp(argv[i], "-n") && i + 1 < argc)
+	    batchSize = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-i") && i + 1 < argc)
+	    iterations = atoi(argv[++i]);
+	else
+	{
+	    std::cout << "usage: " << argv[0] << " [-n batchSize] [-i iterations]" << std::endl;
+	    return 1;
+	}
+    }
+    CountingAllocator allocator;
+    BufferPool pool(&allocator);
+    volatile float sink = 0;
+
+    sink = sink + poolBatch(pool, batchSize);
+    long allocations = allocator.allocations, news = gNews;
+    for (int it = 0; it < iterations; ++it)
+	sink = sink + poolBatch(pool, batchSize);
+    allocations = allocator.allocations - allocations;
+    news = gNews - news;
+    BufferPoolStats s = pool.stats();
+    printf("steady state: %d batches, %ld allocator calls, %ld operator new calls, %ld acquires, %.1f MB held\n", iterations, allocations, news, s.acquires, s.bytes / 1048576.0);
+    if (allocations || news)
+    {
+	std::cout << "the pool allocates in steady state" << std::endl;
+	return 1;
+    }
+    // a second batch in flight, as with double buffering, adds one buffer per shape and no more
+    {
+	BufferPool::Buffer held = pool.acquire(BufferShape{ batchSize, INPUT_C, INPUT_H, INPUT_W });
+	sink = sink + poolBatch(pool, batchSize);
+    }
+    for (int it = 0; it < 10; ++it)
+    {
+	BufferPool::Buffer held = pool.acquire(BufferShape{ batchSize, INPUT_C, INPUT_H, INPUT_W });
+	sink = sink + poolBatch(pool, batchSize);
+    }
+    if (allocator.allocations != 6)
+    {
+	std::cout << allocator.allocations << " allocator calls for two batches in flight, expected 6" << std::endl;
+	return 1;
+    }
+
+    double start = streamNowMs();
+    for (int it = 0; it < iterations; ++it)
+	sink = sink + newBatch(batchSize);
+    double newMs = (streamNowMs() - start) / iterations;
+    start = streamNowMs();
+    for (int it = 0; it < iterations; ++it)
+	sink = sink + poolBatch(pool, batchSize);
+    double poolMs = (streamNowMs() - start) / iterations;
+    printf("%-10s %10s\n", "path", "ms/batch");
+    printf("%-10s %10.3f\n", "new[]", newMs);
+    printf("%-10s %10.3f\n", "pool", poolMs);
+    pool.trim();
+    s = pool.stats();
+    if (s.bytes != 0 || s.frees != s.allocations)
+    {
+	std::cout << "trim() left " << s.bytes << " bytes" << std::endl;
+	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+#include "buffer_pool.h"
+#include <cuda_runtime_api.h>
+
+void* PinnedAllocator::allocate(size_t bytes)
+{
+    void* p = nullptr;
+    return cudaMallocHost(&p, bytes) == cudaSuccess ? p : nullptr;
+}
+
+void PinnedAllocator::release(void* p)
+{
+    cudaFreeHost(p);
+}
@@ -0,0 +1,25 @@
+#include "cpu_isa.h"
+
+static const char* isaNames[ISA_NUM]{ "scalar", "avx2", "avx512" };
+
+static int detectIsa()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+	return ISA_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+	return ISA_AVX2;
+    return ISA_SCALAR;
+}
+
+int bestIsa()
+{
+    // the pool threads of PostProcessor ask at once on the first batch, a function local static is initialized once for all of them
+    static const int best = detectIsa();
+    return best;
+}
+
+const char* isaName(int isa)
+{
+    return isa >= 0 && isa < ISA_NUM ? isaNames[isa] : "unknown";
+}
@@ -0,0 +1,25 @@
+#ifndef _CPU_ISA_H_
+#define _CPU_ISA_H_
+
+// the kernels get the intrinsics from here: gcc 12 warns about the self initialized _mm512_undefined_ps inside them (gcc bug 105593),
+// the warnings are off for the header only
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+
+// instruction sets the hand vectorized kernels (bbox_decode.cpp, preprocess.cpp) are built for, chosen at runtime
+enum CpuIsa
+{
+    ISA_SCALAR = 0,
+    ISA_AVX2,   // avx2 + fma
+    ISA_AVX512, // avx512f
+    ISA_NUM
+};
+
+// widest kernel the cpu runs
+int bestIsa();
+const char* isaName(int isa);
+
+#endif
@@ -0,0 +1,161 @@
+#include "data_loader.h"
+#include "stream.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+DataLoader::DataLoader(int batchSize, std::string file_list, int width, int height, int channel, ImageDecoder decoder, int threadNum, int prefetch)
+    : mBatchSize(batchSize), mWidth(width), mHeight(height), mChannel(channel), mDecoder(decoder), mThreadNum(std::max(threadNum, 0))
+{
+    std::ifstream infile(file_list);
+    std::string tmp;
+    while (infile >> tmp)
+	mFileNames.push_back(tmp);
+    // decoding on the calling thread needs a single buffer
+    mSlots.resize(mThreadNum ? std::max(prefetch, 1) : 1);
+    for (Slot& slot : mSlots)
+    {
+	slot.batch.resize(size_t(mBatchSize) * mChannel * mHeight * mWidth);
+	slot.imInfo.resize(mBatchSize * 3);
+    }
+    // no workers yet, they start with the first next(): a calibrator that reads its cache decodes nothing
+}
+
+DataLoader::~DataLoader()
+{
+    stop();
+}
+
+void DataLoader::start()
+{
+    mNextItem = 0;
+    mNextBatch = 0;
+    mHolding = false;
+    mStop = false;
+    mStarted = true;
+    for (Slot& slot : mSlots)
+	slot.batchId = -1;
+    for (int i = 0; i < mThreadNum; ++i)
+	mThreads.push_back(std::thread(&DataLoader::worker, this));
+}
+
+void DataLoader::stop()
+{
+    {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mStop = true;
+    }
+    mFree.notify_all();
+    for (std::thread& t : mThreads)
+	t.join();
+    mThreads.clear();
+}
+
+void DataLoader::reset()
+{
+    stop();
+    mStarted = false;
+}
+
+DataLoaderStats DataLoader::stats()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+// decodes image item into its place in slot, called without the lock
+bool DataLoader::decode(int item, Slot& slot)
+{
+    int i = item % mBatchSize;
+    size_t size = size_t(mChannel) * mHeight * mWidth;
+    float* chw = slot.batch.data() + i * size;
+    float* imInfo = slot.imInfo.data() + i * 3;
+    if (mDecoder(mFileNames[item], mWidth, mHeight, mChannel, chw, imInfo))
+	return true;
+    std::cout << "can not decode " << mFileNames[item] << std::endl;
+    std::fill(chw, chw + size, 0.f);
+    imInfo[0] = mHeight;
+    imInfo[1] = mWidth;
+    imInfo[2] = 1;
+    return false;
+}
+
+void DataLoader::worker()
+{
+    int itemNum = batchNum() * mBatchSize, slotNum = int(mSlots.size());
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+	// the buffer of batch b is free once the consumer gave back batch b - slotNum
+	double fullStart = streamNowMs();
+	bool full = false;
+	while (!mStop && mNextItem < itemNum && mNextItem / mBatchSize >= mNextBatch - int(mHolding) + slotNum)
+	{
+	    full = true;
+	    mFree.wait(lock);
+	}
+	if (full)
+	    mStats.fullMs += streamNowMs() - fullStart;
+	if (mStop || mNextItem >= itemNum)
+	    return;
+	int item = mNextItem++, b = item / mBatchSize;
+	Slot& slot = mSlots[b % slotNum];
+	if (item % mBatchSize == 0)
+	{
+	    slot.batchId = b;
+	    slot.pending = mBatchSize;
+	}
+	lock.unlock();
+	double start = streamNowMs();
+	bool ok = decode(item, slot);
+	double ms = streamNowMs() - start;
+	lock.lock();
+	mStats.decodeMs += ms;
+	++mStats.images;
+	mStats.failed += !ok;
+	if (--slot.pending == 0)
+	    mReady.notify_all();
+    }
+}
+
+bool DataLoader::next()
+{
+    if (!mStarted)
+	start();
+    double now = streamNowMs();
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mHolding)
+    {
+	mStats.consumeMs += now - mReturnedMs;
+	mHolding = false;
+	mFree.notify_all();
+    }
+    if (mNextBatch >= batchNum())
+	return false;
+    Slot& slot = mSlots[mNextBatch % mSlots.size()];
+    if (mThreadNum == 0)
+    {
+	int failed = 0;
+	lock.unlock();
+	double start = streamNowMs();
+	for (int i = 0; i < mBatchSize; ++i)
+	    failed += !decode(mNextBatch * mBatchSize + i, slot);
+	double ms = streamNowMs() - start;
+	lock.lock();
+	mStats.decodeMs += ms;
+	mStats.images += mBatchSize;
+	mStats.failed += failed;
+	slot.batchId = mNextBatch;
+	slot.pending = 0;
+    }
+    while (slot.batchId != mNextBatch || slot.pending > 0)
+	mReady.wait(lock);
+    mStats.waitMs += streamNowMs() - now;
+    mBatch = slot.batch.data();
+    mImInfo = slot.imInfo.data();
+    ++mNextBatch;
+    ++mStats.batches;
+    mHolding = true;
+    mReturnedMs = streamNowMs();
+    return true;
+}
@@ -1,91 +1,86 @@
-#ifndef __DATA_LOADER__
-#define DATA_LOADER
+#ifndef _DATA_LOADER_H_
+#define _DATA_LOADER_H_
 
-#include <fstream>
-#include <iostream>
 #include <string>
 #include <vector>
-#include <opencv2/opencv.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
+// decodes one image file into channel planes of height x width floats and its im_info (height, width, scale)
+typedef std::function<bool(const std::string& fileName, int width, int height, int channel, float* chw, float* imInfo)> ImageDecoder;
 
+// imread, resize and mean subtraction, in data_loader_cv.cpp as it needs OpenCV
+bool decodeImageCv(const std::string& fileName, int width, int height, int channel, float* chw, float* imInfo);
+
+// where the time of the loader went, the *Ms are totals since construction
+struct DataLoaderStats
+{
+    int batches{ 0 };
+    int images{ 0 };
+    int failed{ 0 };
+    double decodeMs{ 0 };  // in the decoder, summed over the workers
+    double fullMs{ 0 };    // workers waiting for a free batch buffer: the consumer is the bottleneck
+    double waitMs{ 0 };    // next() waiting for its batch: the decoding is the bottleneck
+    double consumeMs{ 0 }; // from a next() returning to the following next(): the consumer's own work
+};
+
+/*
+ * BCHW batches of the images listed in file_list, one file name per line, decoded ahead of the consumer:
+ * threadNum workers take the images in list order and decode them straight into a ring of prefetch preallocated batch buffers,
+ * batch b always goes to buffer b % prefetch and next() hands the batches out in order, so they are the same whatever the thread count
+ * a worker only starts on a batch once its buffer was given back by the consumer, which happens at the following next()
+ * the pointers of getBatch() / getIminfo() stay valid until the following next() or reset()
+ * the workers start with the first next() and stop at reset(), which makes the following next() start over from the first batch
+ * threadNum 0 decodes on the calling thread inside next()
+ * a trailing incomplete batch is dropped, an image the decoder fails on is left as zeros
+ */
 class DataLoader
 {
 public:
-    // BCHW
-    DataLoader(int batchSize, std::string file_list, int width, int height, int channel) {
-        _cur_id = 0;
-        _file_list = file_list;
-        _bsize = batchSize;
-        _width = width;
-        _height = height;
-        _channel = channel;
-        _batch = new float[ _bsize*_width*_height*_channel];
-        _im_info = new float[_bsize * 3];
-
-        std::ifstream infile(file_list);
-
-        std::string tmp;
-        while(infile >> tmp) {
-            _fnames.push_back(tmp);
-        }
-    }
-    void reset(){
-        _cur_id = 0;
-    }
-    float *getBatch() { return  _batch; }
-    float *getIminfo() { return _im_info;}
-
-    bool next(){
-        std::cout<< "calling next(). Cur_id: "<< _cur_id<<std::endl;
-        if(_cur_id + _bsize >= _fnames.size()){
-            return false;
-        }
-
-        for (int i = 0; i < _bsize; ++i) {
-            std::string fname = _fnames[i];
-            cv::Mat img = cv::imread(fname, -1);
-            cv::resize(img, img, cv::Size(_width,_height), cv::INTER_LINEAR);
-
-            _im_info[i*3 + 0] = 375;
-            _im_info[i*3 + 1] = 500;
-            _im_info[i*3 + 2] = 1;
-
-            int ww = img.cols;
-            int hh = img.rows;
-            int cc = img.channels();
-            float pixelMean[3]{ 102.9801f, 115.9465f, 122.7717f };
-
-            for(int c=0; c<cc; c++){
-                for(int h=0; h<hh; h++){
-                    for(int w=0; w<ww; w++){
-                        int pix_id = h*w*c + w*c + c;
-                        int row_id = i*h*w*c + c*h*w + h*w + w;
-                        _batch[row_id] = float(img.ptr()[pix_id] - pixelMean[c]);
-                    }
-                }
-            }
-        }
-        // read file and concat
-        _cur_id += _bsize;
-        return true;
-    }
-
-    ~DataLoader(){
-        delete[] _batch;
-        delete[] _im_info;
-    }
-
+    DataLoader(int batchSize, std::string file_list, int width, int height, int channel, ImageDecoder decoder, int threadNum = 2, int prefetch = 3);
+    ~DataLoader();
+    // stops the workers, the following next() starts again from the first batch
+    void reset();
+    bool next();
+    float* getBatch() { return mBatch; }
+    float* getIminfo() { return mImInfo; }
+    int batchNum() const { return int(mFileNames.size()) / mBatchSize; }
+    DataLoaderStats stats();
 private:
-    int _cur_id;
-    std::string _file_list;
-    std::vector<std::string> _fnames;
-    float* _batch;
-    float* _im_info;
-    int _bsize;
-    int _width;
-    int _height;
-    int _channel;
-
-}; // class: DataLoader
+    struct Slot
+    {
+	std::vector<float> batch;
+	std::vector<float> imInfo;
+	int batchId{ -1 };
+	int pending{ 0 };
+    };
+    void start();
+    void stop();
+    void worker();
+    bool decode(int item, Slot& slot);
+    std::vector<std::string> mFileNames;
+    int mBatchSize;
+    int mWidth;
+    int mHeight;
+    int mChannel;
+    ImageDecoder mDecoder;
+    int mThreadNum;
+    std::vector<Slot> mSlots;
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mFree;
+    std::condition_variable mReady;
+    int mNextItem{ 0 };  // next image a worker takes
+    int mNextBatch{ 0 }; // next batch next() hands out
+    bool mHolding{ false };
+    bool mStop{ false };
+    bool mStarted{ false }; // the workers run, set by the first next()
+    double mReturnedMs{ 0 };
+    DataLoaderStats mStats;
+    float* mBatch{ nullptr };
+    float* mImInfo{ nullptr };
+};
 
 #endif
@@ -0,0 +1,138 @@
+#include "data_loader.h"
+#include "stream.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+/*
+ * CPU only test of the DataLoader pipeline with a dummy decoder and a dummy consumer, no OpenCV or GPU needed
+ * image k of the list decodes to planes full of the value k after -d usec of cpu work and -o usec of sleeping (the file read),
+ * every 97th image fails to decode and must come out as zeros, the consumer spins -c usec per batch
+ * checks that nothing is decoded before the first next(), that every thread count gives the batches in list order, also after reset(),
+ * and prints where the time went
+ * build: g++ -O2 -std=c++11 -pthread data_loader_bench.cpp data_loader.cpp -o data_loader_bench
+ * usage: ./data_loader_bench [-n images] [-b batchSize] [-t maxThreads] [-p prefetch] [-d decodeUsec] [-o ioUsec] [-c consumeUsec]
+ */
+
+static const int WIDTH = 500, HEIGHT = 375, CHANNEL = 3;
+
+static void spin(int usec)
+{
+    double end = streamNowMs() + usec / 1000.0;
+    while (streamNowMs() < end)
+	;
+}
+
+static bool failing(int k)
+{
+    return k % 97 == 96;
+}
+
+// batch b must hold images b * batchSize ... in order
+static bool checkBatch(DataLoader& loader, int b, int batchSize)
+{
+    size_t size = size_t(CHANNEL) * HEIGHT * WIDTH;
+    for (int i = 0; i < batchSize; ++i)
+    {
+	int k = b * batchSize + i;
+	float expect = failing(k) ? 0.f : float(k);
+	const float* chw = loader.getBatch() + i * size;
+	const float* imInfo = loader.getIminfo() + i * 3;
+	if (chw[0] != expect || chw[size / 2] != expect || chw[size - 1] != expect || imInfo[0] != HEIGHT || imInfo[1] != WIDTH)
+	{
+	    std::cout << "batch " << b << " image " << i << " holds " << chw[0] << ", expected image " << k << std::endl;
+	    return false;
+	}
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int images = 200, batchSize = 2, maxThreads = 4, prefetch = 3, decodeUs = 2000, ioUs = 3000, consumeUs = 5000;
+    for (int i = 1; i < argc; ++i)
+    {
+	if (!strcmp(argv[i], "-n") && i + 1 < argc)
+	    images = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+	    batchSize = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+	    maxThreads = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+	    prefetch = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+	    decodeUs = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+	    ioUs = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+	    consumeUs = atoi(argv[++i]);
+	else
+	{
+	    std::cout << "usage: " << argv[0] << " [-n images] [-b batchSize] [-t maxThreads] [-p prefetch] [-d decodeUsec] [-o ioUsec] [-c consumeUsec]" << std::endl;
+	    return 1;
+	}
+    }
+    std::string listFile = "/tmp/data_loader_bench.txt";
+    {
+	std::ofstream list(listFile);
+	for (int k = 0; k < images; ++k)
+	    list << "image_" << k << ".jpg" << std::endl;
+    }
+    ImageDecoder decoder = [decodeUs, ioUs](const std::string& fileName, int width, int height, int channel, float* chw, float* imInfo) {
+	int k = atoi(fileName.c_str() + strlen("image_"));
+	std::this_thread::sleep_for(std::chrono::microseconds(ioUs));
+	spin(decodeUs);
+	if (failing(k))
+	    return false;
+	std::fill(chw, chw + size_t(channel) * height * width, float(k));
+	imInfo[0] = height;
+	imInfo[1] = width;
+	imInfo[2] = 1;
+	return true;
+    };
+
+    std::cout << images << " images of " << WIDTH << "x" << HEIGHT << ", batch " << batchSize << ", decode " << decodeUs << "+" << ioUs << " usec, consume " << consumeUs << " usec" << std::endl;
+    printf("%8s %8s %10s %10s %10s %10s %10s %10s\n", "threads", "batches", "ms/batch", "decode ms", "wait ms", "full ms", "consume ms", "failed");
+    for (int threads = 0; threads <= maxThreads; threads = threads ? threads * 2 : 1)
+    {
+	DataLoader loader(batchSize, listFile, WIDTH, HEIGHT, CHANNEL, decoder, threads, prefetch);
+	// a calibrator with a cache never calls next(), the images must not be decoded for it, long enough for a worker to finish one
+	std::this_thread::sleep_for(std::chrono::microseconds(2 * (decodeUs + ioUs) + 1000));
+	if (loader.stats().images)
+	{
+	    std::cout << "images decoded before the first next() with " << threads << " threads" << std::endl;
+	    return 1;
+	}
+	double start = streamNowMs();
+	int b = 0;
+	for (; loader.next(); ++b)
+	{
+	    if (!checkBatch(loader, b, batchSize))
+		return 1;
+	    spin(consumeUs);
+	}
+	double ms = streamNowMs() - start;
+	if (b != images / batchSize)
+	{
+	    std::cout << b << " batches with " << threads << " threads, expected " << images / batchSize << std::endl;
+	    return 1;
+	}
+	DataLoaderStats s = loader.stats();
+	printf("%8d %8d %10.3f %10.1f %10.1f %10.1f %10.1f %10d\n", threads, s.batches, ms / b, s.decodeMs, s.waitMs, s.fullMs, s.consumeMs, s.failed);
+	loader.reset();
+	for (b = 0; b < 2 && loader.next(); ++b)
+	{
+	    if (!checkBatch(loader, b, batchSize))
+	    {
+		std::cout << "wrong batch after reset()" << std::endl;
+		return 1;
+	    }
+	}
+    }
+    remove(listFile.c_str());
+    return 0;
+}
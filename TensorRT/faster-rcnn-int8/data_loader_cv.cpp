@@ -0,0 +1,22 @@
+#include "data_loader.h"
+#include "preprocess.h"
+#include <opencv2/opencv.hpp>
+
+bool decodeImageCv(const std::string& fileName, int width, int height, int channel, float* chw, float* imInfo)
+{
+    // always BGR, whatever the file holds
+    cv::Mat img = cv::imread(fileName, cv::IMREAD_COLOR);
+    if (img.empty() || channel != 3)
+	return false;
+    cv::resize(img, img, cv::Size(width, height), cv::INTER_LINEAR);
+
+    imInfo[0] = height;
+    imInfo[1] = width;
+    imInfo[2] = 1;
+
+    // pixel mean used by the Faster R-CNN's author, in BGR order as the image
+    float pixelMean[3]{ 102.9801f, 115.9465f, 122.7717f };
+    float scale[3]{ 1.f, 1.f, 1.f };
+    hwcToChw(img.ptr(), img.step, width, height, 3, false, pixelMean, scale, chw);
+    return true;
+}
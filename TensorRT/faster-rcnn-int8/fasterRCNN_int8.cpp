@@ -21,6 +21,10 @@
 #include <ctime>
 
 #include "data_loader.h"
+#include "postprocess.h"
+#include "preprocess.h"
+#include "buffer_pool.h"
+#include "stream.h"
 
 static Logger gLogger;
 using namespace nvinfer1;
@@ -149,7 +153,7 @@ void caffeToTRTModel(const std::string& deployFile, const std::string& modelFile
     builder->setMaxBatchSize(maxBatchSize);
     builder->setMaxWorkspaceSize(1 << 30);
     builder->setInt8Mode(true);
-    DataLoader* dataLoader = new DataLoader(maxBatchSize, "/home/cd/TensorRT-4.0.1.6/data/faster-rcnn/list.txt", 500, 375, 3);
+    DataLoader* dataLoader = new DataLoader(maxBatchSize, "/home/cd/TensorRT-4.0.1.6/data/faster-rcnn/list.txt", 500, 375, 3, decodeImageCv, std::thread::hardware_concurrency());
     Int8EntropyCalibrator* calibrator = new Int8EntropyCalibrator(dataLoader, maxBatchSize, 375, 500, 3);
     builder->setInt8Calibrator(calibrator);
     std::cout << "Begin to build engine..." << std::endl;
@@ -161,54 +165,62 @@ void caffeToTRTModel(const std::string& deployFile, const std::string& modelFile
     (*modelStream) = engine->serialize();
     engine->destroy();
     builder->destroy();
+    // the loader's decode threads are only needed for calibration, its destructor joins them
+    delete calibrator;
+    delete dataLoader;
     shutdownProtobufLibrary();
 }
 
-float doInference(IExecutionContext& context, float* inputData, float* inputImInfo, float* outputBboxPred, float* outputClsProb, float *outputRois, int batchSize)
+// the engine behind the detection: device buffers of maxBatch images allocated once, copies and inference on one stream
+class TrtInference : public Inference
 {
-    std::cout << "Begin to do infer..." << std::endl;
-    const ICudaEngine& engine = context.getEngine();
-    assert(engine.getNbBindings() == 5);
-    void* buffers[5];
-    float ms = 0.0f;
-    int inputIndex0 = engine.getBindingIndex(INPUT_BLOB_NAME0),
-	inputIndex1 = engine.getBindingIndex(INPUT_BLOB_NAME1),
-	outputIndex0 = engine.getBindingIndex(OUTPUT_BLOB_NAME0),
-	outputIndex1 = engine.getBindingIndex(OUTPUT_BLOB_NAME1),
-	outputIndex2 = engine.getBindingIndex(OUTPUT_BLOB_NAME2);
-    CHECK(cudaMalloc(&buffers[inputIndex0], batchSize * INPUT_C * INPUT_H * INPUT_W * sizeof(float)));   // data
-    CHECK(cudaMalloc(&buffers[inputIndex1], batchSize * IM_INFO_SIZE * sizeof(float)));                  // im_info
-    CHECK(cudaMalloc(&buffers[outputIndex0], batchSize * nmsMaxOut * OUTPUT_BBOX_SIZE * sizeof(float))); // bbox_pred
-    CHECK(cudaMalloc(&buffers[outputIndex1], batchSize * nmsMaxOut * OUTPUT_CLS_SIZE * sizeof(float)));  // cls_prob
-    CHECK(cudaMalloc(&buffers[outputIndex2], batchSize * nmsMaxOut * 4 * sizeof(float)));                // rois
-    cudaStream_t stream;
-    CHECK(cudaStreamCreate(&stream));
-    // DMA the input to the GPU,  execute the batch asynchronously, and DMA it back:
-    CHECK(cudaMemcpyAsync(buffers[inputIndex0], inputData, batchSize * INPUT_C * INPUT_H * INPUT_W * sizeof(float), cudaMemcpyHostToDevice, stream));
-    CHECK(cudaMemcpyAsync(buffers[inputIndex1], inputImInfo, batchSize * IM_INFO_SIZE * sizeof(float), cudaMemcpyHostToDevice, stream));
-    cudaStreamSynchronize(stream);
-    double start = std::clock();
-    int iter = 1;
-    for(int i=0; i<iter; ++i)
+public:
+    TrtInference(ICudaEngine& engine, int maxBatch) : mMaxBatch(maxBatch), mContext(engine.createExecutionContext())
     {
-        context.enqueue(batchSize, buffers, stream, nullptr);
-        cudaStreamSynchronize(stream);
+	assert(engine.getNbBindings() == 5);
+	mDataIndex = engine.getBindingIndex(INPUT_BLOB_NAME0);
+	mImInfoIndex = engine.getBindingIndex(INPUT_BLOB_NAME1);
+	mBboxPredIndex = engine.getBindingIndex(OUTPUT_BLOB_NAME0);
+	mClsProbIndex = engine.getBindingIndex(OUTPUT_BLOB_NAME1);
+	mRoisIndex = engine.getBindingIndex(OUTPUT_BLOB_NAME2);
+	CHECK(cudaMalloc(&mBuffers[mDataIndex], maxBatch * INPUT_C * INPUT_H * INPUT_W * sizeof(float)));   // data
+	CHECK(cudaMalloc(&mBuffers[mImInfoIndex], maxBatch * IM_INFO_SIZE * sizeof(float)));                 // im_info
+	CHECK(cudaMalloc(&mBuffers[mBboxPredIndex], maxBatch * nmsMaxOut * OUTPUT_BBOX_SIZE * sizeof(float))); // bbox_pred
+	CHECK(cudaMalloc(&mBuffers[mClsProbIndex], maxBatch * nmsMaxOut * OUTPUT_CLS_SIZE * sizeof(float)));  // cls_prob
+	CHECK(cudaMalloc(&mBuffers[mRoisIndex], maxBatch * nmsMaxOut * 4 * sizeof(float)));                  // rois
+	CHECK(cudaStreamCreate(&mStream));
     }
-    ms = (std::clock()-start) / (double) CLOCKS_PER_SEC /iter * 1000;
-    std::cout<< "infer total time elapse:  "<< ms << " ms" <<std::endl;
-    CHECK(cudaMemcpyAsync(outputBboxPred, buffers[outputIndex0], batchSize * nmsMaxOut * OUTPUT_BBOX_SIZE * sizeof(float), cudaMemcpyDeviceToHost, stream));
-    CHECK(cudaMemcpyAsync(outputClsProb, buffers[outputIndex1], batchSize * nmsMaxOut * OUTPUT_CLS_SIZE * sizeof(float), cudaMemcpyDeviceToHost, stream));
-    CHECK(cudaMemcpyAsync(outputRois, buffers[outputIndex2], batchSize * nmsMaxOut * 4 * sizeof(float), cudaMemcpyDeviceToHost, stream));
-    cudaStreamSynchronize(stream);
-    CHECK(cudaFree(buffers[inputIndex0]));
-    CHECK(cudaFree(buffers[inputIndex1]));
-    CHECK(cudaFree(buffers[outputIndex0]));
-    CHECK(cudaFree(buffers[outputIndex1]));
-    CHECK(cudaFree(buffers[outputIndex2]));
-    cudaStreamDestroy(stream);
-    std::cout << "End to do infer..." << std::endl;
-    return ms;
-}
+    ~TrtInference()
+    {
+	for (void* buffer : mBuffers)
+	    CHECK(cudaFree(buffer));
+	cudaStreamDestroy(mStream);
+	mContext->destroy();
+    }
+    int maxBatch() const override { return mMaxBatch; }
+    void infer(const float* data, const float* imInfo, int n, float* rois, float* bboxPreds, float* clsProbs) override
+    {
+	assert(n <= mMaxBatch);
+	// DMA the input to the GPU,  execute the batch asynchronously, and DMA it back:
+	CHECK(cudaMemcpyAsync(mBuffers[mDataIndex], data, n * INPUT_C * INPUT_H * INPUT_W * sizeof(float), cudaMemcpyHostToDevice, mStream));
+	CHECK(cudaMemcpyAsync(mBuffers[mImInfoIndex], imInfo, n * IM_INFO_SIZE * sizeof(float), cudaMemcpyHostToDevice, mStream));
+	mContext->enqueue(n, mBuffers, mStream, nullptr);
+	CHECK(cudaMemcpyAsync(bboxPreds, mBuffers[mBboxPredIndex], n * nmsMaxOut * OUTPUT_BBOX_SIZE * sizeof(float), cudaMemcpyDeviceToHost, mStream));
+	CHECK(cudaMemcpyAsync(clsProbs, mBuffers[mClsProbIndex], n * nmsMaxOut * OUTPUT_CLS_SIZE * sizeof(float), cudaMemcpyDeviceToHost, mStream));
+	CHECK(cudaMemcpyAsync(rois, mBuffers[mRoisIndex], n * nmsMaxOut * 4 * sizeof(float), cudaMemcpyDeviceToHost, mStream));
+	cudaStreamSynchronize(mStream);
+    }
+private:
+    int mMaxBatch;
+    IExecutionContext* mContext;
+    cudaStream_t mStream;
+    void* mBuffers[5]{};
+    int mDataIndex;
+    int mImInfoIndex;
+    int mBboxPredIndex;
+    int mClsProbIndex;
+    int mRoisIndex;
+};
 
 template<int OutC>
 class Reshape : public IPlugin
@@ -335,97 +347,26 @@ public:
     std::unique_ptr<INvPlugin, decltype(nvPluginDeleter)> mPluginRPROI{ nullptr, nvPluginDeleter };
 };
 
-void bboxTransformInvAndClip(float* rois, float* deltas, float* predBBoxes, float* imInfo, const int N, const int nmsMaxOut, const int numCls)
-{
-    float width, height, ctr_x, ctr_y;
-    float dx, dy, dw, dh, pred_ctr_x, pred_ctr_y, pred_w, pred_h;
-    float *deltas_offset, *predBBoxes_offset, *imInfo_offset;
-    for (int i = 0; i < N * nmsMaxOut; ++i)
-    {
-	width = rois[i * 4 + 2] - rois[i * 4] + 1;
-	height = rois[i * 4 + 3] - rois[i * 4 + 1] + 1;
-	ctr_x = rois[i * 4] + 0.5f * width;
-	ctr_y = rois[i * 4 + 1] + 0.5f * height;
-	deltas_offset = deltas + i * numCls * 4;
-	predBBoxes_offset = predBBoxes + i * numCls * 4;
-	imInfo_offset = imInfo + i / nmsMaxOut * 3;
-	for (int j = 0; j < numCls; ++j)
-	{
-	    dx = deltas_offset[j * 4];
-	    dy = deltas_offset[j * 4 + 1];
-	    dw = deltas_offset[j * 4 + 2];
-	    dh = deltas_offset[j * 4 + 3];
-	    pred_ctr_x = dx * width + ctr_x;
-	    pred_ctr_y = dy * height + ctr_y;
-	    pred_w = exp(dw) * width;
-	    pred_h = exp(dh) * height;
-	    predBBoxes_offset[j * 4] = std::max(std::min(pred_ctr_x - 0.5f * pred_w, imInfo_offset[1] - 1.f), 0.f);
-	    predBBoxes_offset[j * 4 + 1] = std::max(std::min(pred_ctr_y - 0.5f * pred_h, imInfo_offset[0] - 1.f), 0.f);
-	    predBBoxes_offset[j * 4 + 2] = std::max(std::min(pred_ctr_x + 0.5f * pred_w, imInfo_offset[1] - 1.f), 0.f);
-	    predBBoxes_offset[j * 4 + 3] = std::max(std::min(pred_ctr_y + 0.5f * pred_h, imInfo_offset[0] - 1.f), 0.f);
-	}
-    }
-}
+const float nms_threshold = 0.3f;
+const float score_threshold = 0.8f;
 
-std::vector<int> nms(std::vector<std::pair<float, int> >& score_index, float* bbox, const int classNum, const int numClasses, const float nms_threshold)
+// the five test images in one batch
+void detectImages(Inference& inference, BufferPool& pool, const std::string& recordFile)
 {
-    auto overlap1D = [](float x1min, float x1max, float x2min, float x2max) -> float 
-    {
-	if (x1min > x2min)
-	{
-	    std::swap(x1min, x2min);
-	    std::swap(x1max, x2max);
-	}
-	return x1max < x2min ? 0 : std::min(x1max, x2max) - x2min;
-    };
-    auto computeIoU = [&overlap1D](float* bbox1, float* bbox2) -> float 
-    {
-	float overlapX = overlap1D(bbox1[0], bbox1[2], bbox2[0], bbox2[2]);
-	float overlapY = overlap1D(bbox1[1], bbox1[3], bbox2[1], bbox2[3]);
-	float area1 = (bbox1[2] - bbox1[0]) * (bbox1[3] - bbox1[1]);
-	float area2 = (bbox2[2] - bbox2[0]) * (bbox2[3] - bbox2[1]);
-	float overlap2D = overlapX * overlapY;
-	float u = area1 + area2 - overlap2D;
-	return u == 0 ? 0 : overlap2D / u;
-    };
-    std::vector<int> indices;
-    for (auto i : score_index)
-    {
-	const int idx = i.second;
-	bool keep = true;
-	for (unsigned k = 0; k < indices.size(); ++k)
-	{
-	    if (keep)
-	    {
-		const int kept_idx = indices[k];
-		float overlap = computeIoU(&bbox[(idx*numClasses + classNum) * 4], &bbox[(kept_idx*numClasses + classNum) * 4]);
-		keep = overlap <= nms_threshold;
-	    }
-	    else
-		break;
-	}
-	if (keep) indices.push_back(idx);
-    }
-    return indices;
-}
-
-int main(int argc, char* argv[])
-{
-    PluginFactory pluginFactory;
-    IHostMemory *modelStream{ nullptr };
     const int N = 5;
-    caffeToTRTModel("/home/cd/TensorRT-4.0.1.6/data/faster-rcnn/faster_rcnn_test_iplugin.prototxt", 
-		    "/home/cd/TensorRT-4.0.1.6/data/faster-rcnn/VGG16_faster_rcnn_final.caffemodel",
-		    std::vector < std::string > { OUTPUT_BLOB_NAME0, OUTPUT_BLOB_NAME1, OUTPUT_BLOB_NAME2 },
-		    N, &pluginFactory, &modelStream, DataType::kINT8);
-    pluginFactory.destroyPlugin();
     std::vector<std::string> imageList = { "/home/cd/TensorRT-4.0.1.6/data/faster-rcnn/1.ppm",
 					  "/home/cd/TensorRT-4.0.1.6/data/faster-rcnn/2.ppm",
 					  "/home/cd/TensorRT-4.0.1.6/data/faster-rcnn/3.ppm",
 					  "/home/cd/TensorRT-4.0.1.6/data/faster-rcnn/4.ppm",
 					  "/home/cd/TensorRT-4.0.1.6/data/faster-rcnn/5.ppm" };
+    BufferPool::Buffer imInfoBuffer = pool.acquire(BufferShape(N, 3));
+    BufferPool::Buffer dataBuffer = pool.acquire(BufferShape(N, INPUT_C, INPUT_H, INPUT_W));
+    BufferPool::Buffer roisBuffer = pool.acquire(BufferShape(N, nmsMaxOut, 4));
+    BufferPool::Buffer bboxPredsBuffer = pool.acquire(BufferShape(N, nmsMaxOut, OUTPUT_BBOX_SIZE));
+    BufferPool::Buffer clsProbsBuffer = pool.acquire(BufferShape(N, nmsMaxOut, OUTPUT_CLS_SIZE));
+    assert(imInfoBuffer.data() && dataBuffer.data() && roisBuffer.data() && bboxPredsBuffer.data() && clsProbsBuffer.data());
     std::vector<PPM> ppms(N);
-    float imInfo[N * 3];
+    float* imInfo = imInfoBuffer.data();
     assert(ppms.size() <= imageList.size());
     for (int i = 0; i < N; ++i)
     {
@@ -434,68 +375,113 @@ int main(int argc, char* argv[])
 	imInfo[i * 3 + 1] = float(ppms[i].w); // number of columns
 	imInfo[i * 3 + 2] = 1;         // image scale
     }
-    float* data = new float[N*INPUT_C*INPUT_H*INPUT_W];
+    float* data = dataBuffer.data();
     // pixel mean used by the Faster R-CNN's author
     float pixelMean[3]{ 102.9801f, 115.9465f, 122.7717f }; // also in BGR order
+    float pixelScale[3]{ 1.f, 1.f, 1.f };
+    // the color image to input should be in BGR order, ppm is RGB
     for (int i = 0, volImg = INPUT_C*INPUT_H*INPUT_W; i < N; ++i)
-    {
-	for (int c = 0; c < INPUT_C; ++c)
-	{
-	    // the color image to input should be in BGR order
-	    for (unsigned j = 0, volChl = INPUT_H*INPUT_W; j < volChl; ++j)
-		data[i*volImg + c*volChl + j] = float(ppms[i].buffer[j*INPUT_C + 2 - c]) - pixelMean[c];
-	}
-    }
-    IRuntime* runtime = createInferRuntime(gLogger);
-    ICudaEngine* engine = runtime->deserializeCudaEngine(modelStream->data(), modelStream->size(), &pluginFactory);
-    IExecutionContext *context = engine->createExecutionContext();
-    float* rois = new float[N * nmsMaxOut * 4];
-    float* bboxPreds = new float[N * nmsMaxOut * OUTPUT_BBOX_SIZE];
-    float* clsProbs = new float[N * nmsMaxOut * OUTPUT_CLS_SIZE];
-    float* predBBoxes = new float[N * nmsMaxOut * OUTPUT_BBOX_SIZE];
-    float totalTime = 0.0f;
-    totalTime = doInference(*context, data, imInfo, bboxPreds, clsProbs, rois, N);
+	hwcToChw(ppms[i].buffer, INPUT_W*INPUT_C, INPUT_W, INPUT_H, INPUT_C, true, pixelMean, pixelScale, data + i*volImg);
+    float* rois = roisBuffer.data();
+    float* bboxPreds = bboxPredsBuffer.data();
+    float* clsProbs = clsProbsBuffer.data();
+    std::cout << "Begin to do infer..." << std::endl;
+    double start = streamNowMs();
+    inference.infer(data, imInfo, N, rois, bboxPreds, clsProbs);
+    double totalTime = streamNowMs() - start;
+    std::cout << "infer total time elapse:  " << totalTime << " ms" << std::endl;
     std::cout << "average infer time of each image is: " << totalTime / N << " ms" << std::endl;
-    context->destroy();
-    engine->destroy();
-    runtime->destroy();
-    pluginFactory.destroyPlugin();
     for (int i = 0; i < N; ++i)
     {
 	float * rois_offset = rois + i * nmsMaxOut * 4;
 	for (int j = 0; j < nmsMaxOut * 4 && imInfo[i * 3 + 2] != 1; ++j)
 	    rois_offset[j] /= imInfo[i * 3 + 2];
     }
-    bboxTransformInvAndClip(rois, bboxPreds, predBBoxes, imInfo, N, nmsMaxOut, OUTPUT_CLS_SIZE);
-    const float nms_threshold = 0.3f;
-    const float score_threshold = 0.8f;
-    for (int i = 0; i < N; ++i)
+    if (!recordFile.empty() && !saveTensors(recordFile, N, nmsMaxOut, OUTPUT_CLS_SIZE, imInfo, rois, bboxPreds, clsProbs))
+	std::cout << "can not record tensors to " << recordFile << std::endl;
+    PostProcessor postProcessor(std::thread::hardware_concurrency(), OUTPUT_CLS_SIZE, nmsMaxOut, score_threshold, nms_threshold);
+    std::vector<Detection> dets;
+    postProcessor.run(rois, bboxPreds, clsProbs, imInfo, N, dets);
+    for (const Detection& d : dets)
+	std::cout << "Detected " << CLASSES[d.cls] << " in " << ppms[d.image].fileName << " with confidence " << d.score * 100.0f << "% " << std::endl;
+}
+
+// the frames of a directory or a video in batches of up to maxBatch(), a camera drops the frames the detection can not keep up with
+void detectStream(FrameSource& source, bool camera, Inference& inference, BufferPool& pool, double maxLatencyMs)
+{
+    StreamConfig config;
+    config.width = INPUT_W;
+    config.height = INPUT_H;
+    config.maxBatch = inference.maxBatch();
+    config.maxLatencyMs = maxLatencyMs;
+    config.dropFrames = camera;
+    config.numCls = OUTPUT_CLS_SIZE;
+    config.nmsMaxOut = nmsMaxOut;
+    config.scoreThreshold = score_threshold;
+    config.nmsThreshold = nms_threshold;
+    config.postThreads = std::thread::hardware_concurrency();
+    StreamDetector detector(config, inference, pool);
+    StreamStats s = detector.run(source, [](const std::vector<Frame>& frames, const std::vector<Detection>& dets)
+    {
+	for (const Detection& d : dets)
+	    std::cout << "Detected " << CLASSES[d.cls] << " in " << frames[d.image].name << " with confidence " << d.score * 100.0f << "% " << std::endl;
+    });
+    std::cout << s.frames << " frames (" << s.dropped << " dropped) in " << s.batches << " batches (" << s.deadlineBatches << " closed by the deadline), "
+	      << s.frames * 1000.0 / s.wallMs << " fps, latency " << s.latencySumMs / std::max(s.frames, 1L) << " ms average, " << s.latencyMaxMs << " ms max" << std::endl;
+    if (s.batches)
+	std::cout << "per batch: preprocess " << s.preprocessMs / s.batches << " ms, infer " << s.inferMs / s.batches << " ms, postprocess " << s.postMs / s.batches << " ms" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    PluginFactory pluginFactory;
+    IHostMemory *modelStream{ nullptr };
+    const int N = 5;
+    // -r file records rois / bbox_pred / cls_prob for postprocess_bench
+    // -d dir or -v video (a number is a camera) detects over the frames of a stream instead of the test images, -l ms is the longest a batch waits to fill
+    std::string recordFile, frameDir, videoUri;
+    double maxLatencyMs = 100;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+	if (!strcmp(argv[i], "-r"))
+	    recordFile = argv[i + 1];
+	else if (!strcmp(argv[i], "-d"))
+	    frameDir = argv[i + 1];
+	else if (!strcmp(argv[i], "-v"))
+	    videoUri = argv[i + 1];
+	else if (!strcmp(argv[i], "-l"))
+	    maxLatencyMs = atof(argv[i + 1]);
+    }
+    caffeToTRTModel("/home/cd/TensorRT-4.0.1.6/data/faster-rcnn/faster_rcnn_test_iplugin.prototxt", 
+		    "/home/cd/TensorRT-4.0.1.6/data/faster-rcnn/VGG16_faster_rcnn_final.caffemodel",
+		    std::vector < std::string > { OUTPUT_BLOB_NAME0, OUTPUT_BLOB_NAME1, OUTPUT_BLOB_NAME2 },
+		    N, &pluginFactory, &modelStream, DataType::kINT8);
+    pluginFactory.destroyPlugin();
+    // host tensors come from a pool of pinned memory, so the copies to and from the device are DMA and later batches reuse them
+    PinnedAllocator pinned;
+    BufferPool pool(&pinned);
+    IRuntime* runtime = createInferRuntime(gLogger);
+    ICudaEngine* engine = runtime->deserializeCudaEngine(modelStream->data(), modelStream->size(), &pluginFactory);
     {
-	float *bbox = predBBoxes + i * nmsMaxOut * OUTPUT_BBOX_SIZE;
-	float *scores = clsProbs + i * nmsMaxOut * OUTPUT_CLS_SIZE;
-	for (int c = 1; c < OUTPUT_CLS_SIZE; ++c) // skip the background
+	TrtInference inference(*engine, N);
+	if (!frameDir.empty())
 	{
-	    std::vector<std::pair<float, int> > score_index;
-	    for (int r = 0; r < nmsMaxOut; ++r)
-	    {
-		if (scores[r*OUTPUT_CLS_SIZE + c] > score_threshold)
-		{
-		    score_index.push_back(std::make_pair(scores[r*OUTPUT_CLS_SIZE + c], r));
-		    std::stable_sort(score_index.begin(), score_index.end(), [](const std::pair<float, int>& pair1, const std::pair<float, int>& pair2) {return pair1.first > pair2.first;});
-		}
-	    }
-	    std::vector<int> indices = nms(score_index, bbox, c, OUTPUT_CLS_SIZE, nms_threshold);
-	    for (unsigned k = 0; k < indices.size(); ++k)
-	    {
-		int idx = indices[k];
-		std::cout << "Detected " << CLASSES[c] << " in " << ppms[i].fileName << " with confidence " << scores[idx*OUTPUT_CLS_SIZE + c] * 100.0f << "% " << std::endl;
-	    }
+	    DirectoryFrameSource source(frameDir, INPUT_W, INPUT_H, decodeFrameCv);
+	    detectStream(source, false, inference, pool, maxLatencyMs);
+	}
+	else if (!videoUri.empty())
+	{
+	    VideoFrameSource source(videoUri, INPUT_W, INPUT_H);
+	    if (source.isOpened())
+		detectStream(source, videoUri.find_first_not_of("0123456789") == std::string::npos, inference, pool, maxLatencyMs);
+	    else
+		std::cout << "can not open " << videoUri << std::endl;
 	}
+	else
+	    detectImages(inference, pool, recordFile);
     }
-    delete[] data;
-    delete[] rois;
-    delete[] bboxPreds;
-    delete[] clsProbs;
-    delete[] predBBoxes;
+    engine->destroy();
+    runtime->destroy();
+    pluginFactory.destroyPlugin();
     return 0;
 }
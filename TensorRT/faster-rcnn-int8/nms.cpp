@@ -0,0 +1,229 @@
+#include "nms.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const int TILE = 64;
+
+static bool higherScore(const std::pair<float, int>& a, const std::pair<float, int>& b)
+{
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+// IoU of box a (the candidate) with box b as computeIoU() in postprocess.cpp does it
+static inline float iou(float ax1, float ay1, float ax2, float ay2, float aArea, float bx1, float by1, float bx2, float by2, float bArea)
+{
+    float w = std::max(std::min(ax2, bx2) - std::max(ax1, bx1), 0.f);
+    float h = std::max(std::min(ay2, by2) - std::max(ay1, by1), 0.f);
+    float inter = w * h;
+    float u = aArea + bArea - inter;
+    return u == 0 ? 0.f : inter / u;
+}
+
+void BitmaskNms::collect(const float* scores, int scoreStride, int n, float scoreThreshold)
+{
+    mOrder.clear();
+    for (int k = 0; k < n; ++k)
+    {
+	float s = scores[size_t(k) * scoreStride];
+	if (s > scoreThreshold)
+	    mOrder.push_back(std::make_pair(s, k));
+    }
+}
+
+void BitmaskNms::load(const float* boxes, int boxStride)
+{
+    int m = int(mOrder.size()), padded = (m + TILE - 1) / TILE * TILE;
+    mX1.assign(padded, 0.f);
+    mY1.assign(padded, 0.f);
+    mX2.assign(padded, 0.f);
+    mY2.assign(padded, 0.f);
+    mArea.assign(padded, 0.f);
+    mRemoved.assign(padded / TILE, 0);
+    for (int i = 0; i < m; ++i)
+    {
+	const float* b = boxes + size_t(mOrder[i].second) * boxStride;
+	mX1[i] = b[0];
+	mY1[i] = b[1];
+	mX2[i] = b[2];
+	mY2[i] = b[3];
+	mArea[i] = (b[2] - b[0]) * (b[3] - b[1]);
+    }
+}
+
+// 64 bytes of 0/1 into 64 bits: every byte lands in its own bit of the top byte of the product
+static inline uint64_t packHits(const unsigned char* hit)
+{
+    uint64_t mask = 0;
+    for (int l = 0; l < TILE; l += 8)
+    {
+	uint64_t bytes;
+	memcpy(&bytes, hit + l, 8);
+	mask |= (bytes * 0x0102040810204080ull) >> 56 << l;
+    }
+    return mask;
+}
+
+// marks the boxes in (i, end) that box i suppresses, whole tiles at a time, bits of boxes at or before i do not matter any more
+void BitmaskNms::suppress(int i, int end, float iouThreshold)
+{
+    const float x1 = mX1[i], y1 = mY1[i], x2 = mX2[i], y2 = mY2[i], area = mArea[i];
+    for (int t = (i + 1) / TILE; t * TILE < end; ++t)
+    {
+	if (mRemoved[t] == ~uint64_t(0))
+	    continue;
+	const float *tx1 = &mX1[t * TILE], *ty1 = &mY1[t * TILE], *tx2 = &mX2[t * TILE], *ty2 = &mY2[t * TILE], *tArea = &mArea[t * TILE];
+	unsigned char hit[TILE];
+	for (int l = 0; l < TILE; ++l)
+	{
+	    float w = std::max(std::min(tx2[l], x2) - std::max(tx1[l], x1), 0.f);
+	    float h = std::max(std::min(ty2[l], y2) - std::max(ty1[l], y1), 0.f);
+	    float inter = w * h;
+	    // iou() without its branch, which keeps gcc from vectorizing the loop: a zero union gives 0 / 0 = NaN, and NaN > threshold is false as 0 is
+	    hit[l] = inter / (tArea[l] + area - inter) > iouThreshold;
+	}
+	uint64_t mask = packHits(hit);
+	// boxes of the tile past end belong to another group
+	if ((t + 1) * TILE > end)
+	    mask &= ~uint64_t(0) >> ((t + 1) * TILE - end);
+	mRemoved[t] |= mask;
+    }
+}
+
+// IoU of every box of tile t with box i into o, the bits of the boxes with an IoU above 0, the same floats as iou()
+uint64_t BitmaskNms::overlaps(int i, int t, float* o)
+{
+    const float x1 = mX1[i], y1 = mY1[i], x2 = mX2[i], y2 = mY2[i], area = mArea[i];
+    const float *tx1 = &mX1[t * TILE], *ty1 = &mY1[t * TILE], *tx2 = &mX2[t * TILE], *ty2 = &mY2[t * TILE], *tArea = &mArea[t * TILE];
+    // a local array, as a store through o could alias the boxes and keep gcc from vectorizing
+    float v[TILE];
+    unsigned char hit[TILE];
+    for (int l = 0; l < TILE; ++l)
+    {
+	float w = std::max(std::min(tx2[l], x2) - std::max(tx1[l], x1), 0.f);
+	float h = std::max(std::min(ty2[l], y2) - std::max(ty1[l], y1), 0.f);
+	float inter = w * h;
+	// a zero union gives NaN here, its bit stays 0 and the lane is not read
+	v[l] = inter / (tArea[l] + area - inter);
+	hit[l] = v[l] > 0;
+    }
+    memcpy(o, v, sizeof(v));
+    return packHits(hit);
+}
+
+void BitmaskNms::run(const float* boxes, int boxStride, const float* scores, int scoreStride, int n, float scoreThreshold, float iouThreshold, std::vector<int>& keep, int topK, int maxKeep)
+{
+    keep.clear();
+    collect(scores, scoreStride, n, scoreThreshold);
+    if (topK > 0 && topK < int(mOrder.size()))
+    {
+	std::partial_sort(mOrder.begin(), mOrder.begin() + topK, mOrder.end(), higherScore);
+	mOrder.resize(topK);
+    }
+    else
+	std::sort(mOrder.begin(), mOrder.end(), higherScore);
+    load(boxes, boxStride);
+    int m = int(mOrder.size());
+    for (int i = 0; i < m; ++i)
+    {
+	if (mRemoved[i / TILE] >> (i % TILE) & 1)
+	    continue;
+	keep.push_back(mOrder[i].second);
+	if (maxKeep > 0 && int(keep.size()) == maxKeep)
+	    break;
+	suppress(i, m, iouThreshold);
+    }
+}
+
+void BitmaskNms::batched(const float* boxes, int boxStride, const float* scores, int scoreStride, const int* groups, int n, float scoreThreshold, float iouThreshold, std::vector<int>& keep, int maxKeep)
+{
+    keep.clear();
+    collect(scores, scoreStride, n, scoreThreshold);
+    // a group is a contiguous range after sorting, so a kept box only has to look until the end of its group
+    std::sort(mOrder.begin(), mOrder.end(), [groups](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+	return groups[a.second] < groups[b.second] || (groups[a.second] == groups[b.second] && higherScore(a, b));
+    });
+    load(boxes, boxStride);
+    int m = int(mOrder.size());
+    for (int begin = 0, end; begin < m; begin = end)
+    {
+	int group = groups[mOrder[begin].second], kept = 0;
+	for (end = begin + 1; end < m && groups[mOrder[end].second] == group; ++end)
+	    ;
+	for (int i = begin; i < end; ++i)
+	{
+	    if (mRemoved[i / TILE] >> (i % TILE) & 1)
+		continue;
+	    keep.push_back(mOrder[i].second);
+	    if (maxKeep > 0 && ++kept == maxKeep)
+		break;
+	    suppress(i, end, iouThreshold);
+	}
+    }
+}
+
+void BitmaskNms::soft(const float* boxes, int boxStride, const float* scores, int scoreStride, int n, SoftMethod method, float iouThreshold, float sigma, float scoreThreshold, std::vector<std::pair<float, int> >& keep)
+{
+    keep.clear();
+    // in index order, so the position of a box breaks ties as its index does
+    collect(scores, scoreStride, n, scoreThreshold);
+    load(boxes, boxStride);
+    const int m = int(mOrder.size()), tiles = int(mRemoved.size());
+    // picked and dropped boxes, and the padding, score -inf, so the best of a tile is a plain max
+    mScore.assign(mX1.size(), -INFINITY);
+    mTileMax.assign(tiles, -INFINITY);
+    for (int i = 0; i < m; ++i)
+    {
+	mScore[i] = mOrder[i].first;
+	mTileMax[i / TILE] = std::max(mTileMax[i / TILE], mScore[i]);
+    }
+    if (m % TILE)
+	mRemoved[tiles - 1] = ~uint64_t(0) << (m % TILE);
+    float o[TILE];
+    for (;;)
+    {
+	// the first tile with the highest score, then its first box with it: the lowest position, so the lowest index, wins a tie
+	int bt = -1;
+	for (int t = 0; t < tiles; ++t)
+	{
+	    if (mTileMax[t] != -INFINITY && (bt < 0 || mTileMax[t] > mTileMax[bt]))
+		bt = t;
+	}
+	if (bt < 0)
+	    break;
+	int best = bt * TILE;
+	while (mScore[best] != mTileMax[bt])
+	    ++best;
+	keep.push_back(std::make_pair(mScore[best], mOrder[best].second));
+	mScore[best] = -INFINITY;
+	mRemoved[bt] |= uint64_t(1) << (best % TILE);
+	for (int t = 0; t < tiles; ++t)
+	{
+	    if (mRemoved[t] == ~uint64_t(0))
+		continue;
+	    // a box with IoU 0 keeps its score under both methods
+	    uint64_t mask = overlaps(best, t, o) & ~mRemoved[t];
+	    if (!mask && t != bt)
+		continue;
+	    for (; mask; mask &= mask - 1)
+	    {
+		const int l = __builtin_ctzll(mask), i = t * TILE + l;
+		if (method == SOFT_LINEAR)
+		    mScore[i] *= o[l] > iouThreshold ? 1 - o[l] : 1.f;
+		else
+		    mScore[i] *= std::exp(-(o[l] * o[l]) / sigma);
+		if (mScore[i] <= scoreThreshold)
+		{
+		    mScore[i] = -INFINITY;
+		    mRemoved[t] |= uint64_t(1) << l;
+		}
+	    }
+	    float mx = -INFINITY;
+	    for (int l = 0; l < TILE; ++l)
+		mx = std::max(mx, mScore[t * TILE + l]);
+	    mTileMax[t] = mx;
+	}
+	if (mRemoved[bt] == ~uint64_t(0))
+	    mTileMax[bt] = -INFINITY;
+    }
+}
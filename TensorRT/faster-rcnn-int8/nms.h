@@ -0,0 +1,51 @@
+#ifndef _NMS_H_
+#define _NMS_H_
+
+#include <vector>
+#include <cstdint>
+
+/*
+ * greedy nms without the quadratic sort of the original main():
+ *   candidates above the score threshold are collected once and sorted once (partially if only the top K are wanted),
+ *   their boxes are copied into struct of arrays, padded to tiles of 64,
+ *   every kept box computes the IoU against the following boxes a tile at a time (a loop the compiler vectorizes)
+ *   and ORs the result into a bitmask of removed boxes, tiles that are already all removed are skipped
+ * same IoU and same "IoU > threshold suppresses" rule as nms() in postprocess.cpp, so the kept boxes are exactly the same
+ * boxes are x1 y1 x2 y2 at boxes + k * boxStride, scores at scores + k * scoreStride,
+ * so the per class columns of the bbox_pred / cls_prob layout can be passed without copying
+ * an object keeps its scratch vectors between calls, use one per thread
+ */
+class BitmaskNms
+{
+public:
+    enum SoftMethod
+    {
+	SOFT_LINEAR = 0,
+	SOFT_GAUSSIAN
+    };
+
+    // indices of the kept boxes, highest score first (ties by index), topK > 0 only considers the topK best candidates, maxKeep > 0 stops after maxKeep boxes
+    void run(const float* boxes, int boxStride, const float* scores, int scoreStride, int n, float scoreThreshold, float iouThreshold, std::vector<int>& keep, int topK = 0, int maxKeep = 0);
+
+    // one pass over boxes of many groups (classes, or image * numCls + class) where a box only suppresses boxes of its own group,
+    // kept indices come out by group, then by score, maxKeep > 0 is per group; for class agnostic nms use run()
+    void batched(const float* boxes, int boxStride, const float* scores, int scoreStride, const int* groups, int n, float scoreThreshold, float iouThreshold, std::vector<int>& keep, int maxKeep = 0);
+
+    // soft-nms (Bodla et al. 2017): the best box is kept and the score of every other box is decayed by its IoU with it,
+    // linear: s *= 1 - IoU if IoU > iouThreshold, gaussian: s *= exp(-IoU^2 / sigma), boxes whose score is no longer above scoreThreshold are dropped
+    // keep gets (decayed score, index) in the order the boxes were picked
+    // the IoU with the picked box is computed a tile at a time as in run(), only the boxes it overlaps are decayed,
+    // and the next box is picked from the best score of every tile instead of a scan over all live boxes
+    void soft(const float* boxes, int boxStride, const float* scores, int scoreStride, int n, SoftMethod method, float iouThreshold, float sigma, float scoreThreshold, std::vector<std::pair<float, int> >& keep);
+
+private:
+    void collect(const float* scores, int scoreStride, int n, float scoreThreshold);
+    void load(const float* boxes, int boxStride);
+    void suppress(int i, int end, float iouThreshold);
+    uint64_t overlaps(int i, int t, float* o);
+    std::vector<std::pair<float, int> > mOrder;
+    std::vector<float> mX1, mY1, mX2, mY2, mArea, mScore, mTileMax;
+    std::vector<uint64_t> mRemoved;
+};
+
+#endif
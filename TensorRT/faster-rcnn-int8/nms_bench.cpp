@@ -0,0 +1,241 @@
+#include "nms.h"
+#include "postprocess.h"
+#include "stream.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+/*
+ * BitmaskNms against nms() of postprocess.cpp on detection sets of 300 to 30000 boxes, no GPU needed
+ * the boxes are the decoded detections of a tensor file recorded by sample_faster_rcnn_int8 (-r) or of synthetic tensors,
+ * every (image, class) with a score above -s is a candidate, a set of n boxes is the first n candidates
+ *   agnostic: one nms over the whole set, reference is nms() after one stable_sort (and after a stable_sort per push as main() did, up to 3000 boxes)
+ *   top1000:  the same over the 1000 best candidates only, which BitmaskNms finds with a partial sort
+ *   batched:  nms per (image, class) group, reference is nms() per group
+ *   soft:     gaussian soft-nms, reference is the textbook loop
+ *   softlin:  linear soft-nms with the iou threshold, reference is the textbook loop
+ * every path must keep exactly the boxes of its reference
+ * build: g++ -O2 -std=c++11 -pthread nms_bench.cpp nms.cpp postprocess.cpp bbox_decode.cpp cpu_isa.cpp -o nms_bench
+ * usage: ./nms_bench [-f tensorFile] [-n images] [-s scoreThreshold] [-t iouThreshold]
+ */
+
+struct Candidates
+{
+    std::vector<float> boxes;
+    std::vector<float> scores;
+    std::vector<int> groups;
+};
+
+// ms per call of fn, repeated for at least 200ms
+template <typename F>
+static double timeMs(F fn)
+{
+    int calls = 0;
+    double start = streamNowMs(), ms;
+    do
+    {
+	fn();
+	++calls;
+	ms = streamNowMs() - start;
+    } while (ms < 200);
+    return ms / calls;
+}
+
+static bool higherScore(const std::pair<float, int>& a, const std::pair<float, int>& b)
+{
+    return a.first > b.first;
+}
+
+static std::vector<int> referenceNms(const Candidates& c, int begin, int end, float scoreThreshold, float iouThreshold, bool sortPerPush, int topK = 0)
+{
+    std::vector<std::pair<float, int> > scoreIndex;
+    for (int k = begin; k < end; ++k)
+    {
+	if (c.scores[k] > scoreThreshold)
+	{
+	    scoreIndex.push_back(std::make_pair(c.scores[k], k));
+	    if (sortPerPush)
+		std::stable_sort(scoreIndex.begin(), scoreIndex.end(), higherScore);
+	}
+    }
+    if (!sortPerPush)
+	std::stable_sort(scoreIndex.begin(), scoreIndex.end(), higherScore);
+    if (topK > 0 && topK < int(scoreIndex.size()))
+	scoreIndex.resize(topK);
+    return nms(scoreIndex, const_cast<float*>(c.boxes.data()), 0, 1, iouThreshold);
+}
+
+static std::vector<int> referenceBatched(const Candidates& c, int n, float scoreThreshold, float iouThreshold)
+{
+    std::vector<int> keep;
+    for (int begin = 0, end; begin < n; begin = end)
+    {
+	for (end = begin + 1; end < n && c.groups[end] == c.groups[begin]; ++end)
+	    ;
+	std::vector<int> k = referenceNms(c, begin, end, scoreThreshold, iouThreshold, false);
+	keep.insert(keep.end(), k.begin(), k.end());
+    }
+    return keep;
+}
+
+static float iou(const float* a, const float* b)
+{
+    float w = std::max(std::min(a[2], b[2]) - std::max(a[0], b[0]), 0.f);
+    float h = std::max(std::min(a[3], b[3]) - std::max(a[1], b[1]), 0.f);
+    float inter = w * h;
+    float u = (a[2] - a[0]) * (a[3] - a[1]) + (b[2] - b[0]) * (b[3] - b[1]) - inter;
+    return u == 0 ? 0.f : inter / u;
+}
+
+static std::vector<std::pair<float, int> > referenceSoft(const Candidates& c, int n, BitmaskNms::SoftMethod method, float iouThreshold, float sigma, float scoreThreshold)
+{
+    std::vector<std::pair<float, int> > live, keep;
+    for (int k = 0; k < n; ++k)
+    {
+	if (c.scores[k] > scoreThreshold)
+	    live.push_back(std::make_pair(c.scores[k], k));
+    }
+    while (!live.empty())
+    {
+	size_t best = 0;
+	for (size_t i = 1; i < live.size(); ++i)
+	{
+	    if (live[i].first > live[best].first || (live[i].first == live[best].first && live[i].second < live[best].second))
+		best = i;
+	}
+	std::pair<float, int> b = live[best];
+	keep.push_back(b);
+	live.erase(live.begin() + best);
+	std::vector<std::pair<float, int> > next;
+	for (auto& l : live)
+	{
+	    float o = iou(&c.boxes[l.second * 4], &c.boxes[b.second * 4]);
+	    if (method == BitmaskNms::SOFT_LINEAR)
+		l.first *= o > iouThreshold ? 1 - o : 1.f;
+	    else
+		l.first *= std::exp(-(o * o) / sigma);
+	    if (l.first > scoreThreshold)
+		next.push_back(l);
+	}
+	live.swap(next);
+    }
+    return keep;
+}
+
+int main(int argc, char* argv[])
+{
+    DetectionTensors t;
+    std::string file;
+    int images = 160, topK = 1000;
+    float scoreThreshold = 0.05f, iouThreshold = 0.3f, softSigma = 0.5f, softThreshold = 0.001f;
+    for (int i = 1; i < argc; ++i)
+    {
+	if (!strcmp(argv[i], "-f") && i + 1 < argc)
+	    file = argv[++i];
+	else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+	    images = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+	    scoreThreshold = atof(argv[++i]);
+	else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+	    iouThreshold = atof(argv[++i]);
+	else
+	{
+	    std::cout << "usage: " << argv[0] << " [-f tensorFile] [-n images] [-s scoreThreshold] [-t iouThreshold]" << std::endl;
+	    return 1;
+	}
+    }
+    if (!file.empty())
+    {
+	if (!t.load(file))
+	{
+	    std::cout << "can not load tensors from " << file << std::endl;
+	    return 1;
+	}
+    }
+    else
+	t.synthesize(images, 300, 21, 1);
+
+    std::vector<float> predBBoxes(t.bboxPreds.size());
+    bboxTransformInvAndClip(t.rois.data(), t.bboxPreds.data(), predBBoxes.data(), t.imInfo.data(), t.N, t.nmsMaxOut, t.numCls);
+    Candidates all;
+    for (int i = 0; i < t.N; ++i)
+    {
+	for (int c = 1; c < t.numCls; ++c)
+	{
+	    for (int r = 0; r < t.nmsMaxOut; ++r)
+	    {
+		size_t b = size_t(i) * t.nmsMaxOut + r;
+		if (t.clsProbs[b * t.numCls + c] > scoreThreshold)
+		{
+		    all.boxes.insert(all.boxes.end(), &predBBoxes[(b * t.numCls + c) * 4], &predBBoxes[(b * t.numCls + c) * 4] + 4);
+		    all.scores.push_back(t.clsProbs[b * t.numCls + c]);
+		    all.groups.push_back(i * t.numCls + c);
+		}
+	    }
+	}
+    }
+    std::cout << all.scores.size() << " candidates above " << scoreThreshold << " from " << t.N << " images, iou threshold " << iouThreshold << std::endl;
+
+    BitmaskNms nms;
+    std::vector<int> keep, ref;
+    std::vector<std::pair<float, int> > softKeep, softRef;
+    printf("%8s %-10s %12s %12s %10s %8s\n", "boxes", "path", "ref ms", "bitmask ms", "speedup", "kept");
+    const int sizes[]{ 300, 1000, 3000, 10000, 30000 };
+    for (int n : sizes)
+    {
+	if (n > int(all.scores.size()))
+	    break;
+	double refMs, ms;
+
+	if (n <= 3000)
+	{
+	    refMs = timeMs([&] { ref = referenceNms(all, 0, n, scoreThreshold, iouThreshold, true); });
+	    printf("%8d %-10s %12.3f %12s %10s %8zu\n", n, "push-sort", refMs, "-", "-", ref.size());
+	}
+	refMs = timeMs([&] { ref = referenceNms(all, 0, n, scoreThreshold, iouThreshold, false); });
+	ms = timeMs([&] { nms.run(all.boxes.data(), 4, all.scores.data(), 1, n, scoreThreshold, iouThreshold, keep); });
+	printf("%8d %-10s %12.3f %12.3f %10.2f %8zu\n", n, "agnostic", refMs, ms, refMs / ms, keep.size());
+	if (keep != ref)
+	{
+	    std::cout << "agnostic nms of " << n << " boxes differs from nms()" << std::endl;
+	    return 1;
+	}
+
+	if (n > topK)
+	{
+	    refMs = timeMs([&] { ref = referenceNms(all, 0, n, scoreThreshold, iouThreshold, false, topK); });
+	    ms = timeMs([&] { nms.run(all.boxes.data(), 4, all.scores.data(), 1, n, scoreThreshold, iouThreshold, keep, topK); });
+	    printf("%8d %-10s %12.3f %12.3f %10.2f %8zu\n", n, "top1000", refMs, ms, refMs / ms, keep.size());
+	    if (keep != ref)
+	    {
+		std::cout << "nms of the " << topK << " best of " << n << " boxes differs from nms()" << std::endl;
+		return 1;
+	    }
+	}
+
+	refMs = timeMs([&] { ref = referenceBatched(all, n, scoreThreshold, iouThreshold); });
+	ms = timeMs([&] { nms.batched(all.boxes.data(), 4, all.scores.data(), 1, all.groups.data(), n, scoreThreshold, iouThreshold, keep); });
+	printf("%8d %-10s %12.3f %12.3f %10.2f %8zu\n", n, "batched", refMs, ms, refMs / ms, keep.size());
+	if (keep != ref)
+	{
+	    std::cout << "batched nms of " << n << " boxes differs from nms() per group" << std::endl;
+	    return 1;
+	}
+
+	for (BitmaskNms::SoftMethod method : { BitmaskNms::SOFT_GAUSSIAN, BitmaskNms::SOFT_LINEAR })
+	{
+	    refMs = timeMs([&] { softRef = referenceSoft(all, n, method, iouThreshold, softSigma, softThreshold); });
+	    ms = timeMs([&] { nms.soft(all.boxes.data(), 4, all.scores.data(), 1, n, method, iouThreshold, softSigma, softThreshold, softKeep); });
+	    printf("%8d %-10s %12.3f %12.3f %10.2f %8zu\n", n, method == BitmaskNms::SOFT_LINEAR ? "softlin" : "soft", refMs, ms, refMs / ms, softKeep.size());
+	    if (softKeep != softRef)
+	    {
+		std::cout << (method == BitmaskNms::SOFT_LINEAR ? "linear" : "gaussian") << " soft-nms of " << n << " boxes differs from the reference" << std::endl;
+		return 1;
+	    }
+	}
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+#include "postprocess.h"
+#include "bbox_decode.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+static const int TENSORS_MAGIC = 0x54435246; // "FRCT"
+// rois decoded by one task, a multiple of the 16 wide AVX-512 block so only the last chunk of an image has a scalar tail
+static const int DECODE_CHUNK = 64;
+
+bool saveTensors(const std::string& fileName, int N, int nmsMaxOut, int numCls, const float* imInfo, const float* rois, const float* bboxPreds, const float* clsProbs)
+{
+    std::ofstream out(fileName, std::ios::binary);
+    int header[4]{ TENSORS_MAGIC, N, nmsMaxOut, numCls };
+    size_t boxes = size_t(N) * nmsMaxOut;
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(imInfo), N * 3 * sizeof(float));
+    out.write(reinterpret_cast<const char*>(rois), boxes * 4 * sizeof(float));
+    out.write(reinterpret_cast<const char*>(bboxPreds), boxes * numCls * 4 * sizeof(float));
+    out.write(reinterpret_cast<const char*>(clsProbs), boxes * numCls * sizeof(float));
+    return out.good();
+}
+
+bool DetectionTensors::load(const std::string& fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    int header[4];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != TENSORS_MAGIC || header[1] <= 0 || header[2] <= 0 || header[3] <= 1)
+	return false;
+    N = header[1];
+    nmsMaxOut = header[2];
+    numCls = header[3];
+    size_t boxes = size_t(N) * nmsMaxOut;
+    imInfo.resize(N * 3);
+    rois.resize(boxes * 4);
+    bboxPreds.resize(boxes * numCls * 4);
+    clsProbs.resize(boxes * numCls);
+    in.read(reinterpret_cast<char*>(imInfo.data()), imInfo.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(rois.data()), rois.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(bboxPreds.data()), bboxPreds.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(clsProbs.data()), clsProbs.size() * sizeof(float));
+    return bool(in);
+}
+
+void DetectionTensors::synthesize(int n, int maxOut, int cls, unsigned seed)
+{
+    const int objNum = 8;
+    const float imH = 375, imW = 500;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uni(0.f, 1.f);
+    std::normal_distribution<float> jitter(0.f, 1.f);
+    N = n;
+    nmsMaxOut = maxOut;
+    numCls = cls;
+    size_t boxes = size_t(N) * nmsMaxOut;
+    imInfo.resize(N * 3);
+    rois.resize(boxes * 4);
+    bboxPreds.resize(boxes * numCls * 4);
+    clsProbs.resize(boxes * numCls);
+    for (int i = 0; i < N; ++i)
+    {
+	float obj[objNum][4];
+	int objCls[objNum];
+	imInfo[i * 3] = imH;
+	imInfo[i * 3 + 1] = imW;
+	imInfo[i * 3 + 2] = 1;
+	for (int k = 0; k < objNum; ++k)
+	{
+	    obj[k][0] = uni(rng) * (imW - 60);
+	    obj[k][1] = uni(rng) * (imH - 60);
+	    obj[k][2] = std::min(obj[k][0] + 40 + uni(rng) * 160, imW - 1);
+	    obj[k][3] = std::min(obj[k][1] + 40 + uni(rng) * 160, imH - 1);
+	    objCls[k] = 1 + int(uni(rng) * (numCls - 1)) % (numCls - 1);
+	}
+	for (int r = 0; r < nmsMaxOut; ++r)
+	{
+	    size_t b = size_t(i) * nmsMaxOut + r;
+	    float* roi = &rois[b * 4];
+	    float* prob = &clsProbs[b * numCls];
+	    float sum = 0;
+	    // 7 of 10 rois cluster around an object, the rest is background
+	    int k = r % 10 < 7 ? int(uni(rng) * objNum) % objNum : -1;
+	    for (int j = 0; j < 4; ++j)
+	    {
+		float base = k >= 0 ? obj[k][j] : uni(rng) * (j % 2 ? imH : imW);
+		roi[j] = std::max(0.f, std::min(base + jitter(rng) * 8, (j % 2 ? imH : imW) - 1));
+	    }
+	    if (roi[2] < roi[0])
+		std::swap(roi[0], roi[2]);
+	    if (roi[3] < roi[1])
+		std::swap(roi[1], roi[3]);
+	    for (int c = 0; c < numCls; ++c)
+	    {
+		prob[c] = uni(rng);
+		sum += prob[c];
+	    }
+	    float top = 0.5f + uni(rng) * 0.49f;
+	    for (int c = 0; c < numCls; ++c)
+		prob[c] *= (1 - top) / sum;
+	    prob[k >= 0 ? objCls[k] : 0] += top;
+	    for (int j = 0; j < numCls * 4; ++j)
+		bboxPreds[b * numCls * 4 + j] = jitter(rng) * (j % 4 < 2 ? 0.1f : 0.2f);
+	}
+    }
+}
+
+void bboxTransformInvAndClip(const float* rois, const float* deltas, float* predBBoxes, const float* imInfo, const int N, const int nmsMaxOut, const int numCls)
+{
+    float width, height, ctr_x, ctr_y;
+    float dx, dy, dw, dh, pred_ctr_x, pred_ctr_y, pred_w, pred_h;
+    const float *deltas_offset, *imInfo_offset;
+    float *predBBoxes_offset;
+    for (int i = 0; i < N * nmsMaxOut; ++i)
+    {
+	width = rois[i * 4 + 2] - rois[i * 4] + 1;
+	height = rois[i * 4 + 3] - rois[i * 4 + 1] + 1;
+	ctr_x = rois[i * 4] + 0.5f * width;
+	ctr_y = rois[i * 4 + 1] + 0.5f * height;
+	deltas_offset = deltas + i * numCls * 4;
+	predBBoxes_offset = predBBoxes + i * numCls * 4;
+	imInfo_offset = imInfo + i / nmsMaxOut * 3;
+	for (int j = 0; j < numCls; ++j)
+	{
+	    dx = deltas_offset[j * 4];
+	    dy = deltas_offset[j * 4 + 1];
+	    dw = deltas_offset[j * 4 + 2];
+	    dh = deltas_offset[j * 4 + 3];
+	    pred_ctr_x = dx * width + ctr_x;
+	    pred_ctr_y = dy * height + ctr_y;
+	    pred_w = exp(dw) * width;
+	    pred_h = exp(dh) * height;
+	    predBBoxes_offset[j * 4] = std::max(std::min(pred_ctr_x - 0.5f * pred_w, imInfo_offset[1] - 1.f), 0.f);
+	    predBBoxes_offset[j * 4 + 1] = std::max(std::min(pred_ctr_y - 0.5f * pred_h, imInfo_offset[0] - 1.f), 0.f);
+	    predBBoxes_offset[j * 4 + 2] = std::max(std::min(pred_ctr_x + 0.5f * pred_w, imInfo_offset[1] - 1.f), 0.f);
+	    predBBoxes_offset[j * 4 + 3] = std::max(std::min(pred_ctr_y + 0.5f * pred_h, imInfo_offset[0] - 1.f), 0.f);
+	}
+    }
+}
+
+std::vector<int> nms(std::vector<std::pair<float, int> >& score_index, float* bbox, const int classNum, const int numClasses, const float nms_threshold)
+{
+    auto overlap1D = [](float x1min, float x1max, float x2min, float x2max) -> float
+    {
+	if (x1min > x2min)
+	{
+	    std::swap(x1min, x2min);
+	    std::swap(x1max, x2max);
+	}
+	return x1max < x2min ? 0 : std::min(x1max, x2max) - x2min;
+    };
+    auto computeIoU = [&overlap1D](float* bbox1, float* bbox2) -> float
+    {
+	float overlapX = overlap1D(bbox1[0], bbox1[2], bbox2[0], bbox2[2]);
+	float overlapY = overlap1D(bbox1[1], bbox1[3], bbox2[1], bbox2[3]);
+	float area1 = (bbox1[2] - bbox1[0]) * (bbox1[3] - bbox1[1]);
+	float area2 = (bbox2[2] - bbox2[0]) * (bbox2[3] - bbox2[1]);
+	float overlap2D = overlapX * overlapY;
+	float u = area1 + area2 - overlap2D;
+	return u == 0 ? 0 : overlap2D / u;
+    };
+    std::vector<int> indices;
+    for (auto i : score_index)
+    {
+	const int idx = i.second;
+	bool keep = true;
+	for (unsigned k = 0; k < indices.size(); ++k)
+	{
+	    if (keep)
+	    {
+		const int kept_idx = indices[k];
+		float overlap = computeIoU(&bbox[(idx*numClasses + classNum) * 4], &bbox[(kept_idx*numClasses + classNum) * 4]);
+		keep = overlap <= nms_threshold;
+	    }
+	    else
+		break;
+	}
+	if (keep) indices.push_back(idx);
+    }
+    return indices;
+}
+
+ThreadPool::ThreadPool(int threadNum)
+{
+    // the calling thread is the first worker
+    for (int i = 1; i < threadNum; ++i)
+	mThreads.emplace_back(&ThreadPool::worker, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mStop = true;
+    }
+    mStart.notify_all();
+    for (auto& t : mThreads)
+	t.join();
+}
+
+void ThreadPool::drain(int id)
+{
+    for (int task = mNext++; task < mTaskNum; task = mNext++)
+	(*mFn)(task, id);
+}
+
+void ThreadPool::worker(int id)
+{
+    unsigned long seen = 0;
+    for (;;)
+    {
+	{
+	    std::unique_lock<std::mutex> lock(mMutex);
+	    mStart.wait(lock, [&] { return mStop || mGeneration != seen; });
+	    if (mStop)
+		return;
+	    seen = mGeneration;
+	}
+	drain(id);
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (--mBusy == 0)
+	    mDone.notify_one();
+    }
+}
+
+void ThreadPool::parallelFor(int n, const std::function<void(int, int)>& fn)
+{
+    if (mThreads.empty() || n <= 1)
+    {
+	for (int i = 0; i < n; ++i)
+	    fn(i, 0);
+	return;
+    }
+    {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mFn = &fn;
+	mTaskNum = n;
+	mNext = 0;
+	mBusy = int(mThreads.size());
+	++mGeneration;
+    }
+    mStart.notify_all();
+    drain(0);
+    // every worker has to check in before the next call may reset the task counter
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [&] { return mBusy == 0; });
+}
+
+PostProcessor::PostProcessor(int threadNum, int numCls, int nmsMaxOut, float scoreThreshold, float nmsThreshold)
+    : mPool(std::max(threadNum, 1)), mNumCls(numCls), mNmsMaxOut(nmsMaxOut), mScoreThreshold(scoreThreshold), mNmsThreshold(nmsThreshold)
+{
+    mScratch.resize(mPool.size());
+}
+
+void PostProcessor::nmsPair(int task, int thread, const float* clsProbs)
+{
+    // class 0 is the background
+    int i = task / (mNumCls - 1), c = task % (mNumCls - 1) + 1;
+    const float* scores = clsProbs + size_t(i) * mNmsMaxOut * mNumCls;
+    float* bbox = mPredBBoxes.data() + size_t(i) * mNmsMaxOut * mNumCls * 4;
+    Scratch& scratch = mScratch[thread];
+    std::vector<Detection>& out = mPairDets[task];
+    out.clear();
+    scratch.nms.run(bbox + c * 4, mNumCls * 4, scores + c, mNumCls, mNmsMaxOut, mScoreThreshold, mNmsThreshold, scratch.keep);
+    for (int idx : scratch.keep)
+    {
+	Detection d{ i, c, idx, scores[idx * mNumCls + c], {} };
+	std::copy(bbox + (idx * mNumCls + c) * 4, bbox + (idx * mNumCls + c) * 4 + 4, d.box);
+	out.push_back(d);
+    }
+}
+
+void PostProcessor::run(const float* rois, const float* bboxPreds, const float* clsProbs, const float* imInfo, int N, std::vector<Detection>& dets)
+{
+    int chunks = (mNmsMaxOut + DECODE_CHUNK - 1) / DECODE_CHUNK, pairs = N * (mNumCls - 1);
+    mPredBBoxes.resize(size_t(N) * mNmsMaxOut * mNumCls * 4);
+    if (int(mPairDets.size()) < pairs)
+	mPairDets.resize(pairs);
+    float* pred = mPredBBoxes.data();
+    mPool.parallelFor(N * chunks, [&](int task, int) {
+	int i = task / chunks, begin = task % chunks * DECODE_CHUNK, num = std::min(DECODE_CHUNK, mNmsMaxOut - begin);
+	size_t roi = size_t(i) * mNmsMaxOut + begin;
+	bboxDecode(rois + roi * 4, bboxPreds + roi * mNumCls * 4, pred + roi * mNumCls * 4, imInfo + i * 3, 1, num, mNumCls);
+    });
+    mPool.parallelFor(pairs, [&](int task, int thread) { nmsPair(task, thread, clsProbs); });
+    dets.clear();
+    for (int p = 0; p < pairs; ++p)
+	dets.insert(dets.end(), mPairDets[p].begin(), mPairDets[p].end());
+}
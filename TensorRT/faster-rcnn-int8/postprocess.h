@@ -0,0 +1,96 @@
+#ifndef _POSTPROCESS_H_
+#define _POSTPROCESS_H_
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include "nms.h"
+
+// one kept box of one class in one image
+struct Detection
+{
+    int image;
+    int cls;
+    int roi;
+    float score;
+    float box[4];
+};
+
+// rois / bbox_pred / cls_prob of one batch as they come back from the engine, recorded to a file for CPU only runs
+struct DetectionTensors
+{
+    int N{ 0 };
+    int nmsMaxOut{ 0 };
+    int numCls{ 0 };
+    std::vector<float> imInfo;    // N * 3
+    std::vector<float> rois;      // N * nmsMaxOut * 4
+    std::vector<float> bboxPreds; // N * nmsMaxOut * numCls * 4
+    std::vector<float> clsProbs;  // N * nmsMaxOut * numCls
+
+    bool load(const std::string& fileName);
+    // random objects with clusters of rois around them, for a benchmark without a recorded file
+    void synthesize(int n, int maxOut, int cls, unsigned seed);
+};
+
+bool saveTensors(const std::string& fileName, int N, int nmsMaxOut, int numCls, const float* imInfo, const float* rois, const float* bboxPreds, const float* clsProbs);
+
+void bboxTransformInvAndClip(const float* rois, const float* deltas, float* predBBoxes, const float* imInfo, const int N, const int nmsMaxOut, const int numCls);
+std::vector<int> nms(std::vector<std::pair<float, int> >& score_index, float* bbox, const int classNum, const int numClasses, const float nms_threshold);
+
+// runs fn(task, thread) for task in [0, n) on the pool threads and the calling thread
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threadNum);
+    ~ThreadPool();
+    int size() const { return int(mThreads.size()) + 1; }
+    void parallelFor(int n, const std::function<void(int, int)>& fn);
+private:
+    void worker(int id);
+    void drain(int id);
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mStart;
+    std::condition_variable mDone;
+    const std::function<void(int, int)>* mFn{ nullptr };
+    int mTaskNum{ 0 };
+    std::atomic<int> mNext{ 0 };
+    int mBusy{ 0 };
+    unsigned long mGeneration{ 0 };
+    bool mStop{ false };
+};
+
+/*
+ * bbox decoding and per class nms of a batch, spread over a thread pool:
+ * decoding is split in chunks of rois, nms in (image, class) pairs,
+ * every thread keeps its own scratch vectors and every pair its own result vector, so a batch allocates nothing once warm
+ * the detections come out in (image, class, score) order whatever the thread count
+ */
+class PostProcessor
+{
+public:
+    PostProcessor(int threadNum, int numCls, int nmsMaxOut, float scoreThreshold, float nmsThreshold);
+    void run(const float* rois, const float* bboxPreds, const float* clsProbs, const float* imInfo, int N, std::vector<Detection>& dets);
+    const float* predBBoxes() const { return mPredBBoxes.data(); }
+private:
+    struct Scratch
+    {
+	BitmaskNms nms;
+	std::vector<int> keep;
+    };
+    void nmsPair(int task, int thread, const float* clsProbs);
+    ThreadPool mPool;
+    int mNumCls;
+    int mNmsMaxOut;
+    float mScoreThreshold;
+    float mNmsThreshold;
+    std::vector<float> mPredBBoxes;
+    std::vector<Scratch> mScratch;
+    std::vector<std::vector<Detection> > mPairDets;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include "postprocess.h"
+#include "stream.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+/*
+ * CPU only benchmark of the post processing after inference, no GPU or TensorRT needed
+ * input is a tensor file recorded by sample_faster_rcnn_int8 (-r), or synthetic tensors of -n images
+ * the serial path of the original main() is the reference, PostProcessor must give the same detections,
+ * boxes may differ by the rounding of the SIMD decoding (bbox_decode.cpp)
+ * build: g++ -O2 -std=c++11 -pthread postprocess_bench.cpp postprocess.cpp bbox_decode.cpp cpu_isa.cpp nms.cpp -o postprocess_bench
+ * usage: ./postprocess_bench [-f tensorFile] [-n images] [-t maxThreads] [-i iterations] [-s scoreThreshold]
+ */
+
+// post processing as main() did it before PostProcessor
+static void serialPostProcess(const DetectionTensors& t, float scoreThreshold, float nmsThreshold, std::vector<float>& predBBoxes, std::vector<Detection>& dets)
+{
+    predBBoxes.resize(t.bboxPreds.size());
+    bboxTransformInvAndClip(t.rois.data(), t.bboxPreds.data(), predBBoxes.data(), t.imInfo.data(), t.N, t.nmsMaxOut, t.numCls);
+    dets.clear();
+    for (int i = 0; i < t.N; ++i)
+    {
+	float *bbox = predBBoxes.data() + size_t(i) * t.nmsMaxOut * t.numCls * 4;
+	const float *scores = t.clsProbs.data() + size_t(i) * t.nmsMaxOut * t.numCls;
+	for (int c = 1; c < t.numCls; ++c)
+	{
+	    std::vector<std::pair<float, int> > score_index;
+	    for (int r = 0; r < t.nmsMaxOut; ++r)
+	    {
+		if (scores[r*t.numCls + c] > scoreThreshold)
+		{
+		    score_index.push_back(std::make_pair(scores[r*t.numCls + c], r));
+		    std::stable_sort(score_index.begin(), score_index.end(), [](const std::pair<float, int>& pair1, const std::pair<float, int>& pair2) {return pair1.first > pair2.first;});
+		}
+	    }
+	    for (int idx : nms(score_index, bbox, c, t.numCls, nmsThreshold))
+	    {
+		Detection d{ i, c, idx, scores[idx*t.numCls + c], {} };
+		std::copy(bbox + (idx*t.numCls + c) * 4, bbox + (idx*t.numCls + c) * 4 + 4, d.box);
+		dets.push_back(d);
+	    }
+	}
+    }
+}
+
+static bool sameDetections(const std::vector<Detection>& a, const std::vector<Detection>& b)
+{
+    if (a.size() != b.size())
+	return false;
+    for (size_t k = 0; k < a.size(); ++k)
+    {
+	if (a[k].image != b[k].image || a[k].cls != b[k].cls || a[k].roi != b[k].roi || a[k].score != b[k].score)
+	    return false;
+	for (int j = 0; j < 4; ++j)
+	{
+	    if (std::fabs(a[k].box[j] - b[k].box[j]) > 1e-3f * std::max(1.f, std::fabs(b[k].box[j])))
+		return false;
+	}
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    DetectionTensors t;
+    std::string file;
+    int images = 64, maxThreads = 8, iterations = 20;
+    float scoreThreshold = 0.8f, nmsThreshold = 0.3f;
+    for (int i = 1; i < argc; ++i)
+    {
+	if (!strcmp(argv[i], "-f") && i + 1 < argc)
+	    file = argv[++i];
+	else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+	    images = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+	    maxThreads = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-i") && i + 1 < argc)
+	    iterations = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+	    scoreThreshold = atof(argv[++i]);
+	else
+	{
+	    std::cout << "usage: " << argv[0] << " [-f tensorFile] [-n images] [-t maxThreads] [-i iterations] [-s scoreThreshold]" << std::endl;
+	    return 1;
+	}
+    }
+    if (!file.empty())
+    {
+	if (!t.load(file))
+	{
+	    std::cout << "can not load tensors from " << file << std::endl;
+	    return 1;
+	}
+    }
+    else
+	t.synthesize(images, 300, 21, 1);
+    std::cout << t.N << " images x " << t.numCls - 1 << " classes x " << t.nmsMaxOut << " rois, " << iterations << " iterations" << std::endl;
+
+    std::vector<float> predBBoxes;
+    std::vector<Detection> ref, dets;
+    double start = streamNowMs();
+    for (int it = 0; it < iterations; ++it)
+	serialPostProcess(t, scoreThreshold, nmsThreshold, predBBoxes, ref);
+    double serialMs = (streamNowMs() - start) / iterations;
+    printf("%-10s %8s %10s %10s %8s\n", "path", "threads", "ms/batch", "speedup", "dets");
+    printf("%-10s %8d %10.3f %10.2f %8zu\n", "serial", 1, serialMs, 1.0, ref.size());
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+	PostProcessor pp(threads, t.numCls, t.nmsMaxOut, scoreThreshold, nmsThreshold);
+	pp.run(t.rois.data(), t.bboxPreds.data(), t.clsProbs.data(), t.imInfo.data(), t.N, dets);
+	if (!sameDetections(ref, dets))
+	{
+	    std::cout << "PostProcessor with " << threads << " threads differs from the serial path" << std::endl;
+	    return 1;
+	}
+	start = streamNowMs();
+	for (int it = 0; it < iterations; ++it)
+	    pp.run(t.rois.data(), t.bboxPreds.data(), t.clsProbs.data(), t.imInfo.data(), t.N, dets);
+	double ms = (streamNowMs() - start) / iterations;
+	printf("%-10s %8d %10.3f %10.2f %8zu\n", "pool", threads, ms, serialMs / ms, dets.size());
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include "preprocess.h"
+
+// pixels [x0, x1) of row y, inCh[c] is the source channel of output channel c
+static inline void rowScalar(const unsigned char* src, size_t srcStride, int width, int height, int channel, const int* inCh, const float* mean, const float* scale, float* dst, int y, int x0, int x1)
+{
+    const unsigned char* s = src + y * srcStride;
+    size_t plane = size_t(width) * height;
+    for (int c = 0; c < channel; ++c)
+    {
+	float* d = dst + c * plane + size_t(y) * width;
+	for (int x = x0; x < x1; ++x)
+	    d[x] = (float(s[x * channel + inCh[c]]) - mean[c]) * scale[c];
+    }
+}
+
+/*
+ * 16 pixels of 3 channels are 48 bytes in three registers, byte i of mask[r][ch] picks byte 3 * i + ch of the 48 when it is in register r,
+ * or is 0x80 which gives 0, so OR-ing the three shuffles of a channel gives its 16 bytes in pixel order
+ */
+static void splitMasks(unsigned char mask[3][3][16])
+{
+    for (int r = 0; r < 3; ++r)
+    {
+	for (int ch = 0; ch < 3; ++ch)
+	{
+	    for (int i = 0; i < 16; ++i)
+	    {
+		int k = 3 * i + ch - 16 * r;
+		mask[r][ch][i] = k >= 0 && k < 16 ? k : 0x80;
+	    }
+	}
+    }
+}
+
+__attribute__((target("avx2,fma"))) static void hwcToChw3Avx2(const unsigned char* src, size_t srcStride, int width, int height, const int* inCh, const float* mean, const float* scale, float* dst)
+{
+    unsigned char maskBytes[3][3][16];
+    splitMasks(maskBytes);
+    __m128i mask[3][3];
+    __m256 m[3], sc[3];
+    int outCh[3];
+    for (int c = 0; c < 3; ++c)
+    {
+	for (int r = 0; r < 3; ++r)
+	    mask[r][c] = _mm_loadu_si128((const __m128i*)maskBytes[r][c]);
+	m[c] = _mm256_set1_ps(mean[c]);
+	sc[c] = _mm256_set1_ps(scale[c]);
+	outCh[inCh[c]] = c;
+    }
+    size_t plane = size_t(width) * height;
+    for (int y = 0; y < height; ++y)
+    {
+	const unsigned char* s = src + y * srcStride;
+	float* d = dst + size_t(y) * width;
+	int x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+	    __m128i a = _mm_loadu_si128((const __m128i*)(s + x * 3));
+	    __m128i b = _mm_loadu_si128((const __m128i*)(s + x * 3 + 16));
+	    __m128i e = _mm_loadu_si128((const __m128i*)(s + x * 3 + 32));
+	    for (int ch = 0; ch < 3; ++ch)
+	    {
+		__m128i v = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, mask[0][ch]), _mm_shuffle_epi8(b, mask[1][ch])), _mm_shuffle_epi8(e, mask[2][ch]));
+		int c = outCh[ch];
+		__m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+		__m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+		_mm256_storeu_ps(d + c * plane + x, _mm256_mul_ps(_mm256_sub_ps(lo, m[c]), sc[c]));
+		_mm256_storeu_ps(d + c * plane + x + 8, _mm256_mul_ps(_mm256_sub_ps(hi, m[c]), sc[c]));
+	    }
+	}
+	rowScalar(src, srcStride, width, height, 3, inCh, mean, scale, dst, y, x, width);
+    }
+}
+
+__attribute__((target("avx512f,ssse3"))) static void hwcToChw3Avx512(const unsigned char* src, size_t srcStride, int width, int height, const int* inCh, const float* mean, const float* scale, float* dst)
+{
+    unsigned char maskBytes[3][3][16];
+    splitMasks(maskBytes);
+    __m128i mask[3][3];
+    __m512 m[3], sc[3];
+    int outCh[3];
+    for (int c = 0; c < 3; ++c)
+    {
+	for (int r = 0; r < 3; ++r)
+	    mask[r][c] = _mm_loadu_si128((const __m128i*)maskBytes[r][c]);
+	m[c] = _mm512_set1_ps(mean[c]);
+	sc[c] = _mm512_set1_ps(scale[c]);
+	outCh[inCh[c]] = c;
+    }
+    size_t plane = size_t(width) * height;
+    for (int y = 0; y < height; ++y)
+    {
+	const unsigned char* s = src + y * srcStride;
+	float* d = dst + size_t(y) * width;
+	int x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+	    __m128i a = _mm_loadu_si128((const __m128i*)(s + x * 3));
+	    __m128i b = _mm_loadu_si128((const __m128i*)(s + x * 3 + 16));
+	    __m128i e = _mm_loadu_si128((const __m128i*)(s + x * 3 + 32));
+	    for (int ch = 0; ch < 3; ++ch)
+	    {
+		__m128i v = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, mask[0][ch]), _mm_shuffle_epi8(b, mask[1][ch])), _mm_shuffle_epi8(e, mask[2][ch]));
+		int c = outCh[ch];
+		__m512 f = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(v));
+		_mm512_storeu_ps(d + c * plane + x, _mm512_mul_ps(_mm512_sub_ps(f, m[c]), sc[c]));
+	    }
+	}
+	rowScalar(src, srcStride, width, height, 3, inCh, mean, scale, dst, y, x, width);
+    }
+}
+
+void hwcToChw(int isa, const unsigned char* src, size_t srcStride, int width, int height, int channel, bool swapRB, const float* mean, const float* scale, float* dst)
+{
+    int inCh[4];
+    if (channel > 4)
+    {
+	hwcToChwReference(src, srcStride, width, height, channel, swapRB, mean, scale, dst);
+	return;
+    }
+    for (int c = 0; c < channel; ++c)
+	inCh[c] = swapRB ? channel - 1 - c : c;
+    if (channel == 3 && isa == ISA_AVX512)
+	hwcToChw3Avx512(src, srcStride, width, height, inCh, mean, scale, dst);
+    else if (channel == 3 && isa == ISA_AVX2)
+	hwcToChw3Avx2(src, srcStride, width, height, inCh, mean, scale, dst);
+    else
+    {
+	for (int y = 0; y < height; ++y)
+	    rowScalar(src, srcStride, width, height, channel, inCh, mean, scale, dst, y, 0, width);
+    }
+}
+
+void hwcToChw(const unsigned char* src, size_t srcStride, int width, int height, int channel, bool swapRB, const float* mean, const float* scale, float* dst)
+{
+    hwcToChw(bestIsa(), src, srcStride, width, height, channel, swapRB, mean, scale, dst);
+}
+
+void hwcToChwReference(const unsigned char* src, size_t srcStride, int width, int height, int channel, bool swapRB, const float* mean, const float* scale, float* dst)
+{
+    for (int c = 0; c < channel; ++c)
+    {
+	int ch = swapRB ? channel - 1 - c : c;
+	for (int y = 0; y < height; ++y)
+	{
+	    for (int x = 0; x < width; ++x)
+		dst[(size_t(c) * height + y) * width + x] = (float(src[y * srcStride + x * channel + ch]) - mean[c]) * scale[c];
+	}
+    }
+}
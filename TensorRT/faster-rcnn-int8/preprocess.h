@@ -0,0 +1,21 @@
+#ifndef _PREPROCESS_H_
+#define _PREPROCESS_H_
+
+#include <cstddef>
+#include "cpu_isa.h"
+
+/*
+ * interleaved uint8 pixels (the output of the resize) to the planar float input of the network in one pass:
+ * dst[c][y][x] = (src[y][x][swapRB ? channel - 1 - c : c] - mean[c]) * scale[c]
+ * mean and scale are indexed by the output channel, srcStride is the number of bytes of a source row
+ * the AVX2 / AVX-512 kernels take 16 pixels of 3 channels at a time: three byte shuffles split them into the channels,
+ * which are widened to floats, normalized and stored to the three planes; other channel counts and the end of a row are scalar
+ * every kernel gives exactly the floats of the reference
+ */
+void hwcToChw(int isa, const unsigned char* src, size_t srcStride, int width, int height, int channel, bool swapRB, const float* mean, const float* scale, float* dst);
+void hwcToChw(const unsigned char* src, size_t srcStride, int width, int height, int channel, bool swapRB, const float* mean, const float* scale, float* dst);
+
+// the plain loops, for the tests
+void hwcToChwReference(const unsigned char* src, size_t srcStride, int width, int height, int channel, bool swapRB, const float* mean, const float* scale, float* dst);
+
+#endif
@@ -0,0 +1,100 @@
+#include "preprocess.h"
+#include "stream.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/*
+ * hwcToChw of every kernel the cpu runs against hwcToChwReference, which must give exactly the same floats,
+ * on odd sizes and padded rows, then the speed at 375x500 (the PASCAL VOC input) and 1080p
+ * build: g++ -O2 -std=c++11 preprocess_bench.cpp preprocess.cpp cpu_isa.cpp -o preprocess_bench
+ * usage: ./preprocess_bench [-i iterations]
+ */
+
+struct Image
+{
+    int width;
+    int height;
+    int channel;
+    size_t stride;
+    std::vector<unsigned char> pixels;
+
+    Image(int w, int h, int c, int pad, unsigned seed) : width(w), height(h), channel(c), stride(size_t(w) * c + pad), pixels(stride * h)
+    {
+	std::mt19937 rng(seed);
+	for (unsigned char& p : pixels)
+	    p = rng() & 0xff;
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    int iterations = 20;
+    for (int i = 1; i < argc; ++i)
+    {
+	if (!strcmp(argv[i], "-i") && i + 1 < argc)
+	    iterations = atoi(argv[++i]);
+	else
+	{
+	    std::cout << "usage: " << argv[0] << " [-i iterations]" << std::endl;
+	    return 1;
+	}
+    }
+    // pixel mean used by the Faster R-CNN's author, and a scale as other networks want it
+    const float pixelMean[4]{ 102.9801f, 115.9465f, 122.7717f, 127.5f };
+    const float unit[4]{ 1.f, 1.f, 1.f, 1.f }, stdScale[4]{ 1 / 57.375f, 1 / 57.12f, 1 / 58.395f, 1 / 64.f };
+    std::cout << "best isa " << isaName(bestIsa()) << std::endl;
+
+    const int shapes[][4]{ { 1, 1, 3, 0 }, { 15, 2, 3, 0 }, { 16, 3, 3, 0 }, { 53, 37, 3, 5 }, { 500, 375, 3, 0 }, { 33, 7, 1, 3 }, { 21, 9, 4, 0 } };
+    for (const int* shape : shapes)
+    {
+	Image img(shape[0], shape[1], shape[2], shape[3], shape[0] * shape[1]);
+	size_t size = size_t(img.width) * img.height * img.channel;
+	std::vector<float> ref(size), out(size);
+	for (int swap = 0; swap < 2; ++swap)
+	{
+	    for (const float* scale : { unit, stdScale })
+	    {
+		hwcToChwReference(img.pixels.data(), img.stride, img.width, img.height, img.channel, swap, pixelMean, scale, ref.data());
+		for (int isa = ISA_SCALAR; isa <= bestIsa(); ++isa)
+		{
+		    std::fill(out.begin(), out.end(), -1.f);
+		    hwcToChw(isa, img.pixels.data(), img.stride, img.width, img.height, img.channel, swap, pixelMean, scale, out.data());
+		    if (memcmp(out.data(), ref.data(), size * sizeof(float)) != 0)
+		    {
+			std::cout << isaName(isa) << " differs from the reference at " << img.width << "x" << img.height << "x" << img.channel << " stride " << img.stride << " swap " << swap << std::endl;
+			return 1;
+		    }
+		}
+	    }
+	}
+    }
+    std::cout << "all kernels match the reference" << std::endl;
+
+    printf("%-10s %-8s %10s %10s %10s\n", "size", "isa", "ms/image", "Mpixel/s", "speedup");
+    const int sizes[][2]{ { 500, 375 }, { 1920, 1080 } };
+    for (const int* wh : sizes)
+    {
+	Image img(wh[0], wh[1], 3, 0, 1);
+	std::vector<float> out(size_t(img.width) * img.height * 3);
+	char name[32];
+	snprintf(name, sizeof(name), "%dx%d", img.width, img.height);
+	double start = streamNowMs();
+	for (int it = 0; it < iterations; ++it)
+	    hwcToChwReference(img.pixels.data(), img.stride, img.width, img.height, 3, true, pixelMean, unit, out.data());
+	double refMs = (streamNowMs() - start) / iterations;
+	printf("%-10s %-8s %10.3f %10.1f %10.2f\n", name, "ref", refMs, img.width * img.height / refMs / 1000, 1.0);
+	for (int isa = ISA_SCALAR; isa <= bestIsa(); ++isa)
+	{
+	    start = streamNowMs();
+	    for (int it = 0; it < iterations; ++it)
+		hwcToChw(isa, img.pixels.data(), img.stride, img.width, img.height, 3, true, pixelMean, unit, out.data());
+	    double ms = (streamNowMs() - start) / iterations;
+	    printf("%-10s %-8s %10.3f %10.1f %10.2f\n", name, isaName(isa), ms, img.width * img.height / ms / 1000, refMs / ms);
+	}
+    }
+    return 0;
+}
@@ -0,0 +1,255 @@
+#include "stream.h"
+#include "preprocess.h"
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+
+bool decodePpmFrame(const std::string& fileName, int width, int height, Frame& frame)
+{
+    std::ifstream infile(fileName, std::ifstream::binary);
+    std::string magic;
+    int w, h, max;
+    if (!(infile >> magic >> w >> h >> max) || magic != "P6" || w != width || h != height || max != 255)
+	return false;
+    infile.seekg(1, infile.cur);
+    frame.pixels.resize(size_t(w) * h * 3);
+    if (!infile.read(reinterpret_cast<char*>(frame.pixels.data()), frame.pixels.size()))
+	return false;
+    // ppm is RGB
+    for (size_t i = 0; i < frame.pixels.size(); i += 3)
+	std::swap(frame.pixels[i], frame.pixels[i + 2]);
+    frame.width = w;
+    frame.height = h;
+    return true;
+}
+
+DirectoryFrameSource::DirectoryFrameSource(const std::string& dir, int width, int height, FrameDecoder decoder)
+    : mWidth(width), mHeight(height), mDecoder(decoder)
+{
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+    {
+	std::cout << "can not open " << dir << std::endl;
+	return;
+    }
+    while (dirent* entry = readdir(d))
+	if (entry->d_name[0] != '.')
+	    mFiles.push_back(dir + "/" + entry->d_name);
+    closedir(d);
+    std::sort(mFiles.begin(), mFiles.end());
+}
+
+bool DirectoryFrameSource::read(Frame& frame)
+{
+    while (mNext < mFiles.size())
+    {
+	const std::string& fileName = mFiles[mNext++];
+	if (mDecoder(fileName, mWidth, mHeight, frame))
+	{
+	    frame.id = mId++;
+	    frame.captureMs = streamNowMs();
+	    frame.name = fileName;
+	    return true;
+	}
+	std::cout << "can not decode " << fileName << ", skipped" << std::endl;
+    }
+    return false;
+}
+
+StreamDetector::StreamDetector(const StreamConfig& config, Inference& inference, BufferPool& pool)
+    : mConfig(config), mInference(inference), mPool(pool),
+      mPostProcessor(config.postThreads, config.numCls, config.nmsMaxOut, config.scoreThreshold, config.nmsThreshold)
+{
+    mConfig.maxBatch = std::max(1, std::min(mConfig.maxBatch, inference.maxBatch()));
+    mConfig.queueFrames = std::max(mConfig.queueFrames, 1);
+    const int n = mConfig.maxBatch;
+    mBatches.resize(mConfig.overlap ? 2 : 1);
+    for (Batch& batch : mBatches)
+    {
+	batch.data = mPool.acquire(BufferShape(n, 3, mConfig.height, mConfig.width));
+	batch.imInfo = mPool.acquire(BufferShape(n, 3));
+	batch.frames.reserve(n);
+    }
+    // only the batch in inference needs outputs
+    mRois = mPool.acquire(BufferShape(n, mConfig.nmsMaxOut, 4));
+    mBboxPreds = mPool.acquire(BufferShape(n, mConfig.nmsMaxOut, mConfig.numCls * 4));
+    mClsProbs = mPool.acquire(BufferShape(n, mConfig.nmsMaxOut, mConfig.numCls));
+}
+
+StreamStats StreamDetector::run(FrameSource& source, const BatchCallback& onBatch)
+{
+    mStats = StreamStats();
+    mFrames.clear();
+    mReady.clear();
+    mFree.clear();
+    for (Batch& batch : mBatches)
+	mFree.push_back(&batch);
+    mCaptureEnd = false;
+    mBatchEnd = false;
+    // every frame in flight comes back here, so once the stream runs the capture reads into recycled pixel buffers
+    mSpare.reserve(mConfig.queueFrames + mBatches.size() * mConfig.maxBatch + 2);
+    const double start = streamNowMs();
+    std::thread captureThread(&StreamDetector::capture, this, std::ref(source));
+    std::thread batchThread(&StreamDetector::batching, this);
+    for (;;)
+    {
+	Batch* batch;
+	{
+	    std::unique_lock<std::mutex> lock(mMutex);
+	    mBatchReady.wait(lock, [this] { return !mReady.empty() || mBatchEnd; });
+	    if (mReady.empty())
+		break;
+	    batch = mReady.front();
+	    mReady.pop_front();
+	}
+	const int n = int(batch->frames.size());
+	const double t0 = streamNowMs();
+	mInference.infer(batch->data.data(), batch->imInfo.data(), n, mRois.data(), mBboxPreds.data(), mClsProbs.data());
+	const double t1 = streamNowMs();
+	mPostProcessor.run(mRois.data(), mBboxPreds.data(), mClsProbs.data(), batch->imInfo.data(), n, mDets);
+	const double t2 = streamNowMs();
+	onBatch(batch->frames, mDets);
+	{
+	    std::lock_guard<std::mutex> lock(mMutex);
+	    mStats.inferMs += t1 - t0;
+	    mStats.postMs += t2 - t1;
+	    mStats.frames += n;
+	    for (const Frame& frame : batch->frames)
+	    {
+		mStats.latencySumMs += t2 - frame.captureMs;
+		mStats.latencyMaxMs = std::max(mStats.latencyMaxMs, t2 - frame.captureMs);
+	    }
+	    recycle(batch->frames);
+	    mFree.push_back(batch);
+	}
+	mBatchFree.notify_one();
+    }
+    captureThread.join();
+    batchThread.join();
+    mStats.wallMs = streamNowMs() - start;
+    return mStats;
+}
+
+void StreamDetector::capture(FrameSource& source)
+{
+    const size_t bytes = size_t(mConfig.width) * mConfig.height * 3;
+    Frame frame;
+    for (;;)
+    {
+	{
+	    std::lock_guard<std::mutex> lock(mMutex);
+	    if (!mSpare.empty())
+	    {
+		frame = std::move(mSpare.back());
+		mSpare.pop_back();
+	    }
+	}
+	if (!source.read(frame))
+	    break;
+	std::unique_lock<std::mutex> lock(mMutex);
+	if (frame.width != mConfig.width || frame.height != mConfig.height || frame.pixels.size() < bytes)
+	{
+	    ++mStats.dropped;
+	    continue;
+	}
+	if (int(mFrames.size()) >= mConfig.queueFrames)
+	{
+	    if (mConfig.dropFrames)
+	    {
+		++mStats.dropped;
+		mSpare.push_back(std::move(mFrames.front()));
+		mFrames.pop_front();
+	    }
+	    else
+		mFrameTaken.wait(lock, [this] { return int(mFrames.size()) < mConfig.queueFrames; });
+	}
+	mFrames.push_back(std::move(frame));
+	lock.unlock();
+	mFrameReady.notify_one();
+    }
+    {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mCaptureEnd = true;
+    }
+    mFrameReady.notify_all();
+}
+
+// the next captured frame, false at the end of the stream or, with deadlineMs >= 0, at the deadline
+bool StreamDetector::nextFrame(Frame& frame, double deadlineMs)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto ready = [this] { return !mFrames.empty() || mCaptureEnd; };
+    if (deadlineMs < 0)
+	mFrameReady.wait(lock, ready);
+    else
+    {
+	std::chrono::duration<double, std::milli> deadline(deadlineMs);
+	mFrameReady.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(deadline)), ready);
+    }
+    if (mFrames.empty())
+	return false;
+    frame = std::move(mFrames.front());
+    mFrames.pop_front();
+    lock.unlock();
+    mFrameTaken.notify_one();
+    return true;
+}
+
+void StreamDetector::batching()
+{
+    const size_t volImg = size_t(3) * mConfig.height * mConfig.width;
+    Frame frame;
+    for (;;)
+    {
+	Batch* batch;
+	{
+	    std::unique_lock<std::mutex> lock(mMutex);
+	    mBatchFree.wait(lock, [this] { return !mFree.empty(); });
+	    batch = mFree.front();
+	    mFree.pop_front();
+	}
+	// the first frame opens the batch, the batch closes when full or maxLatencyMs after that frame was captured
+	if (!nextFrame(frame, -1))
+	    break;
+	const double deadlineMs = frame.captureMs + mConfig.maxLatencyMs;
+	batch->frames.push_back(std::move(frame));
+	while (int(batch->frames.size()) < mConfig.maxBatch && nextFrame(frame, deadlineMs))
+	    batch->frames.push_back(std::move(frame));
+
+	const double t0 = streamNowMs();
+	float* imInfo = batch->imInfo.data();
+	for (size_t i = 0; i < batch->frames.size(); ++i)
+	{
+	    const Frame& f = batch->frames[i];
+	    hwcToChw(f.pixels.data(), size_t(f.width) * 3, f.width, f.height, 3, false, mConfig.mean, mConfig.scale, batch->data.data() + i * volImg);
+	    imInfo[i * 3] = float(f.height);
+	    imInfo[i * 3 + 1] = float(f.width);
+	    imInfo[i * 3 + 2] = 1;
+	}
+	const double t1 = streamNowMs();
+	{
+	    std::lock_guard<std::mutex> lock(mMutex);
+	    mStats.preprocessMs += t1 - t0;
+	    ++mStats.batches;
+	    if (int(batch->frames.size()) < mConfig.maxBatch && !(mCaptureEnd && mFrames.empty()))
+		++mStats.deadlineBatches;
+	    mReady.push_back(batch);
+	}
+	mBatchReady.notify_one();
+    }
+    {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mBatchEnd = true;
+    }
+    mBatchReady.notify_all();
+}
+
+// under mMutex
+void StreamDetector::recycle(std::vector<Frame>& frames)
+{
+    for (Frame& frame : frames)
+	mSpare.push_back(std::move(frame));
+    frames.clear();
+}
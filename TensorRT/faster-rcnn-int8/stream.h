@@ -0,0 +1,175 @@
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "buffer_pool.h"
+#include "postprocess.h"
+
+// one frame of a stream, interleaved BGR of the network input size
+struct Frame
+{
+    long id{ 0 };
+    double captureMs{ 0 }; // steady clock, when the source delivered it
+    std::string name;      // file name or position in the video
+    int width{ 0 };
+    int height{ 0 };
+    std::vector<unsigned char> pixels;
+};
+
+// steady clock in ms, the time base of the frames, also used by the DataLoader and the benches
+inline double streamNowMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+    // blocks until the next frame, false at the end of the stream
+    virtual bool read(Frame& frame) = 0;
+};
+
+// decodes an image file into a frame of width x height
+typedef std::function<bool(const std::string& fileName, int width, int height, Frame& frame)> FrameDecoder;
+
+// binary ppm (P6) of exactly width x height, no OpenCV needed
+bool decodePpmFrame(const std::string& fileName, int width, int height, Frame& frame);
+// any format imread knows, resized, in stream_cv.cpp
+bool decodeFrameCv(const std::string& fileName, int width, int height, Frame& frame);
+
+// the files of a directory in name order, the ones the decoder fails on are skipped
+class DirectoryFrameSource : public FrameSource
+{
+public:
+    DirectoryFrameSource(const std::string& dir, int width, int height, FrameDecoder decoder = decodePpmFrame);
+    int size() const { return int(mFiles.size()); }
+    bool read(Frame& frame) override;
+private:
+    std::vector<std::string> mFiles;
+    size_t mNext{ 0 };
+    int mWidth;
+    int mHeight;
+    FrameDecoder mDecoder;
+    long mId{ 0 };
+};
+
+// a video file or a camera (a device number or a stream url) through cv::VideoCapture, resized, in stream_cv.cpp
+class VideoFrameSource : public FrameSource
+{
+public:
+    VideoFrameSource(const std::string& uri, int width, int height);
+    ~VideoFrameSource();
+    bool isOpened() const;
+    bool read(Frame& frame) override;
+private:
+    struct Capture;
+    std::unique_ptr<Capture> mCapture;
+    int mWidth;
+    int mHeight;
+    long mId{ 0 };
+};
+
+// the network: n <= maxBatch() preprocessed images in, rois (n x nmsMaxOut x 4), bbox_pred and cls_prob out
+class Inference
+{
+public:
+    virtual ~Inference() {}
+    virtual int maxBatch() const = 0;
+    virtual void infer(const float* data, const float* imInfo, int n, float* rois, float* bboxPreds, float* clsProbs) = 0;
+};
+
+struct StreamConfig
+{
+    int width{ 500 };
+    int height{ 375 };
+    int maxBatch{ 1 };
+    double maxLatencyMs{ 100 }; // a batch is closed this long after the capture of its first frame, full or not
+    int queueFrames{ 8 };       // frames between capture and batching
+    bool dropFrames{ false };   // a full queue drops its oldest frame (a camera does not wait) instead of blocking the source (a file)
+    bool overlap{ true };       // false: a single batch buffer, preprocessing waits for inference, for comparison
+    int numCls{ 21 };
+    int nmsMaxOut{ 300 };
+    float scoreThreshold{ 0.8f };
+    float nmsThreshold{ 0.3f };
+    int postThreads{ 1 };
+    float mean[3]{ 102.9801f, 115.9465f, 122.7717f };
+    float scale[3]{ 1.f, 1.f, 1.f };
+};
+
+struct StreamStats
+{
+    long frames{ 0 };
+    long dropped{ 0 };
+    long batches{ 0 };
+    long deadlineBatches{ 0 }; // closed by the latency deadline before they were full
+    double preprocessMs{ 0 };
+    double inferMs{ 0 };
+    double postMs{ 0 };
+    double latencySumMs{ 0 };  // capture to detections, over all frames
+    double latencyMaxMs{ 0 };
+    double wallMs{ 0 };
+};
+
+/*
+ * detection over a stream of frames in three threads:
+ *   capture: reads the source into a bounded frame queue
+ *   batching: takes up to maxBatch frames, waiting no longer than the latency deadline of the first one,
+ *             and preprocesses them (hwcToChw) into a free batch buffer
+ *   run()'s caller: inference and post processing of the ready batches in order, then the callback
+ * with two batch buffers batch k + 1 is assembled and preprocessed while batch k is in inference and post processing
+ * the buffers come from the pool, so a pinned pool gives pinned inputs and outputs
+ */
+class StreamDetector
+{
+public:
+    // frames of the batch and their detections, Detection::image indexes frames
+    typedef std::function<void(const std::vector<Frame>& frames, const std::vector<Detection>& dets)> BatchCallback;
+
+    // the batch buffers are taken from the pool here, it must outlive the detector
+    StreamDetector(const StreamConfig& config, Inference& inference, BufferPool& pool);
+    // until the source ends
+    StreamStats run(FrameSource& source, const BatchCallback& onBatch);
+private:
+    struct Batch
+    {
+	std::vector<Frame> frames;
+	BufferPool::Buffer data;
+	BufferPool::Buffer imInfo;
+    };
+    void capture(FrameSource& source);
+    void batching();
+    bool nextFrame(Frame& frame, double deadlineMs);
+    void recycle(std::vector<Frame>& frames);
+    StreamConfig mConfig;
+    Inference& mInference;
+    BufferPool& mPool;
+    PostProcessor mPostProcessor;
+    std::mutex mMutex;
+    std::condition_variable mFrameReady;
+    std::condition_variable mFrameTaken;
+    std::condition_variable mBatchReady;
+    std::condition_variable mBatchFree;
+    std::deque<Frame> mFrames;
+    std::vector<Frame> mSpare;  // frames given back, their pixel vectors are reused
+    bool mCaptureEnd{ false };
+    std::vector<Batch> mBatches;
+    BufferPool::Buffer mRois;
+    BufferPool::Buffer mBboxPreds;
+    BufferPool::Buffer mClsProbs;
+    std::vector<Detection> mDets;
+    std::deque<Batch*> mFree;
+    std::deque<Batch*> mReady;
+    bool mBatchEnd{ false };
+    StreamStats mStats;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "stream.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+/*
+ * CPU only test of StreamDetector with a synthetic camera and a stub network, no OpenCV or GPU needed
+ * frame k is filled with one byte value of k, the stub checks every image of a batch holds the value of its frame
+ * before and after it sleeps -g + -p * n ms (the GPU is busy, the CPU is free) and hands out synthetic rois / bbox_pred / cls_prob,
+ * so a batch buffer overwritten while it is in inference is caught
+ * checks that every frame comes out once and in order, serial (one batch buffer) against overlapped (two),
+ * that a slow camera gets batches closed by the latency deadline and that an overloaded camera drops frames and nothing else
+ * build: g++ -O2 -std=c++11 -pthread stream_bench.cpp stream.cpp preprocess.cpp cpu_isa.cpp buffer_pool.cpp postprocess.cpp bbox_decode.cpp nms.cpp -o stream_bench
+ * usage: ./stream_bench [-n frames] [-b maxBatch] [-f cameraFps] [-l maxLatencyMs] [-g gpuMs] [-p gpuMsPerImage]
+ */
+
+static const int WIDTH = 500, HEIGHT = 375, NMS_MAX_OUT = 300, CLS_NUM = 21;
+
+static unsigned char pattern(long id)
+{
+    return (unsigned char)(id * 7 + 3);
+}
+
+// frames of a known content, fps 0 is as fast as they can be filled
+class SyntheticCamera : public FrameSource
+{
+public:
+    SyntheticCamera(int frames, double fps) : mFrames(frames), mFps(fps) {}
+    bool read(Frame& frame) override
+    {
+	if (mId == mFrames)
+	    return false;
+	if (mId == 0)
+	    mStart = streamNowMs();
+	if (mFps > 0)
+	{
+	    double wait = mStart + mId * 1000.0 / mFps - streamNowMs();
+	    if (wait > 0)
+		std::this_thread::sleep_for(std::chrono::microseconds(long(wait * 1000)));
+	}
+	frame.width = WIDTH;
+	frame.height = HEIGHT;
+	frame.pixels.resize(size_t(WIDTH) * HEIGHT * 3);
+	memset(frame.pixels.data(), pattern(mId), frame.pixels.size());
+	frame.id = mId++;
+	frame.captureMs = streamNowMs();
+	frame.name = "synthetic";
+	return true;
+    }
+private:
+    long mFrames;
+    double mFps;
+    long mId{ 0 };
+    double mStart{ 0 };
+};
+
+class StubInference : public Inference
+{
+public:
+    StubInference(int maxBatch, double gpuMs, double gpuMsPerImage, const float* mean) : mMaxBatch(maxBatch), mGpuMs(gpuMs), mGpuMsPerImage(gpuMsPerImage), mMean(mean)
+    {
+	mTensors.synthesize(maxBatch, NMS_MAX_OUT, CLS_NUM, 1);
+    }
+    int maxBatch() const override { return mMaxBatch; }
+    void infer(const float* data, const float* imInfo, int n, float* rois, float* bboxPreds, float* clsProbs) override
+    {
+	std::vector<int> values(n);
+	const size_t volImg = size_t(3) * HEIGHT * WIDTH, plane = size_t(HEIGHT) * WIDTH;
+	for (int i = 0; i < n; ++i)
+	    values[i] = int(std::lround(data[i * volImg] + mMean[0]));
+	std::this_thread::sleep_for(std::chrono::microseconds(long((mGpuMs + mGpuMsPerImage * n) * 1000)));
+	for (int i = 0; i < n; ++i)
+	    for (int c = 0; c < 3; ++c)
+		for (size_t at : { size_t(0), plane - 1 })
+		    if (std::lround(data[i * volImg + c * plane + at] + mMean[c]) != values[i] || imInfo[i * 3] != HEIGHT || imInfo[i * 3 + 1] != WIDTH)
+			++mCorrupt;
+	mValues.insert(mValues.end(), values.begin(), values.end());
+	memcpy(rois, mTensors.rois.data(), size_t(n) * NMS_MAX_OUT * 4 * sizeof(float));
+	memcpy(bboxPreds, mTensors.bboxPreds.data(), size_t(n) * NMS_MAX_OUT * CLS_NUM * 4 * sizeof(float));
+	memcpy(clsProbs, mTensors.clsProbs.data(), size_t(n) * NMS_MAX_OUT * CLS_NUM * sizeof(float));
+    }
+    std::vector<int> mValues; // the pixel value seen for every image, in order
+    long mCorrupt{ 0 };
+private:
+    int mMaxBatch;
+    double mGpuMs;
+    double mGpuMsPerImage;
+    const float* mMean;
+    DetectionTensors mTensors;
+};
+
+struct Run
+{
+    StreamStats stats;
+    bool ok{ true };
+};
+
+static Run runStream(const char* label, StreamConfig config, int frames, double fps, double gpuMs, double gpuMsPerImage, BufferPool& pool)
+{
+    Run r;
+    SyntheticCamera camera(frames, fps);
+    StubInference stub(config.maxBatch, gpuMs, gpuMsPerImage, config.mean);
+    StreamDetector detector(config, stub, pool);
+    long lastId = -1, batchFrames = 0;
+    r.stats = detector.run(camera, [&](const std::vector<Frame>& batch, const std::vector<Detection>& dets)
+    {
+	for (const Frame& frame : batch)
+	{
+	    if (frame.id <= lastId)
+		r.ok = false;
+	    lastId = frame.id;
+	}
+	for (const Detection& d : dets)
+	    if (d.image < 0 || d.image >= int(batch.size()))
+		r.ok = false;
+	batchFrames += batch.size();
+    });
+    const StreamStats& s = r.stats;
+    if (stub.mCorrupt || long(stub.mValues.size()) != s.frames || batchFrames != s.frames || s.frames + s.dropped != frames)
+	r.ok = false;
+    // without drops the stub saw exactly the frames 0, 1, 2 ...
+    for (size_t i = 0; i < stub.mValues.size() && !s.dropped; ++i)
+	if (stub.mValues[i] != pattern(long(i)))
+	    r.ok = false;
+    printf("%-12s %6ld %6ld %6ld %7ld %8.1f %8.2f %8.2f %8.2f %9.1f %9.1f%s\n", label, s.frames, s.dropped, s.batches, s.deadlineBatches, s.frames * 1000.0 / s.wallMs,
+	   s.preprocessMs / s.batches, s.inferMs / s.batches, s.postMs / s.batches, s.latencySumMs / std::max(s.frames, 1L), s.latencyMaxMs, r.ok ? "" : "  FAILED");
+    return r;
+}
+
+int main(int argc, char* argv[])
+{
+    int frames = 240, maxBatch = 4;
+    double fps = 30, maxLatencyMs = 50, gpuMs = 8, gpuMsPerImage = 3;
+    for (int i = 1; i < argc; ++i)
+    {
+	if (!strcmp(argv[i], "-n") && i + 1 < argc)
+	    frames = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+	    maxBatch = atoi(argv[++i]);
+	else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+	    fps = atof(argv[++i]);
+	else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+	    maxLatencyMs = atof(argv[++i]);
+	else if (!strcmp(argv[i], "-g") && i + 1 < argc)
+	    gpuMs = atof(argv[++i]);
+	else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+	    gpuMsPerImage = atof(argv[++i]);
+	else
+	{
+	    std::cout << "usage: " << argv[0] << " [-n frames] [-b maxBatch] [-f cameraFps] [-l maxLatencyMs] [-g gpuMs] [-p gpuMsPerImage]" << std::endl;
+	    return 1;
+	}
+    }
+    BufferPool pool;
+    StreamConfig config;
+    config.width = WIDTH;
+    config.height = HEIGHT;
+    config.maxBatch = maxBatch;
+    config.numCls = CLS_NUM;
+    config.nmsMaxOut = NMS_MAX_OUT;
+    config.postThreads = std::thread::hardware_concurrency();
+    bool ok = true;
+    printf("%-12s %6s %6s %6s %7s %8s %8s %8s %8s %9s %9s\n", "run", "frames", "drop", "batch", "by time", "fps", "pre ms", "infer ms", "post ms", "lat avg", "lat max");
+
+    // a file: the source waits for the pipeline, batches are full, throughput is what counts
+    config.maxLatencyMs = 1000;
+    config.overlap = false;
+    Run serial = runStream("file serial", config, frames, 0, gpuMs, gpuMsPerImage, pool);
+    config.overlap = true;
+    Run overlapped = runStream("file overlap", config, frames, 0, gpuMs, gpuMsPerImage, pool);
+    ok = ok && serial.ok && overlapped.ok && !serial.stats.dropped && !overlapped.stats.dropped;
+    printf("overlap: %.2fx the frames per second of serial\n", serial.stats.wallMs / overlapped.stats.wallMs);
+
+    // a camera slower than the batch fills: the deadline closes the batches, a frame waits at most for its deadline,
+    // the batch in inference and its own inference
+    config.maxLatencyMs = maxLatencyMs;
+    config.dropFrames = true;
+    Run camera = runStream("camera", config, frames / 2, fps, gpuMs, gpuMsPerImage, pool);
+    const StreamStats& s = camera.stats;
+    double bound = maxLatencyMs + 2 * (gpuMs + gpuMsPerImage * maxBatch + s.postMs / std::max(s.batches, 1L)) + 20;
+    if (fps * maxLatencyMs / 1000 < maxBatch - 1 && !s.deadlineBatches)
+    {
+	std::cout << "no batch was closed by the deadline" << std::endl;
+	ok = false;
+    }
+    if (s.latencyMaxMs > bound)
+    {
+	printf("latency %.1f ms over the bound of %.1f ms\n", s.latencyMaxMs, bound);
+	ok = false;
+    }
+    ok = ok && camera.ok;
+
+    // a camera twice as fast as the pipeline: a short queue drops the oldest frames, what is left still comes out in order
+    config.queueFrames = 2;
+    double pipelineFps = maxBatch * 1000.0 / (gpuMs + gpuMsPerImage * maxBatch);
+    Run overload = runStream("overload", config, frames, 2 * pipelineFps, gpuMs, gpuMsPerImage, pool);
+    ok = ok && overload.ok && overload.stats.dropped;
+    if (!ok)
+    {
+	std::cout << "stream check failed" << std::endl;
+	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "stream.h"
+#include <opencv2/opencv.hpp>
+#include <cstdlib>
+
+// resize straight into the pixels of the frame
+static void resizeToFrame(const cv::Mat& img, int width, int height, Frame& frame)
+{
+    frame.pixels.resize(size_t(width) * height * 3);
+    cv::Mat dst(height, width, CV_8UC3, frame.pixels.data());
+    cv::resize(img, dst, cv::Size(width, height), 0, 0, cv::INTER_LINEAR);
+    frame.width = width;
+    frame.height = height;
+}
+
+bool decodeFrameCv(const std::string& fileName, int width, int height, Frame& frame)
+{
+    // always BGR, whatever the file holds
+    cv::Mat img = cv::imread(fileName, cv::IMREAD_COLOR);
+    if (img.empty())
+	return false;
+    resizeToFrame(img, width, height, frame);
+    return true;
+}
+
+struct VideoFrameSource::Capture
+{
+    cv::VideoCapture capture;
+    cv::Mat img;
+    std::string uri;
+};
+
+VideoFrameSource::VideoFrameSource(const std::string& uri, int width, int height)
+    : mCapture(new Capture), mWidth(width), mHeight(height)
+{
+    mCapture->uri = uri;
+    // a plain number is a camera
+    if (!uri.empty() && uri.find_first_not_of("0123456789") == std::string::npos)
+	mCapture->capture.open(atoi(uri.c_str()));
+    else
+	mCapture->capture.open(uri);
+}
+
+VideoFrameSource::~VideoFrameSource()
+{
+}
+
+bool VideoFrameSource::isOpened() const
+{
+    return mCapture->capture.isOpened();
+}
+
+bool VideoFrameSource::read(Frame& frame)
+{
+    if (!mCapture->capture.read(mCapture->img) || mCapture->img.empty())
+	return false;
+    resizeToFrame(mCapture->img, mWidth, mHeight, frame);
+    frame.id = mId++;
+    frame.captureMs = streamNowMs();
+    frame.name = mCapture->uri + "#" + std::to_string(frame.id);
+    return true;
+}